@@ -1,7 +1,6 @@
 #include "git-compat-util.h"
 #include "bloom.h"
 #include "diff.h"
-#include "diffcore.h"
 #include "revision.h"
 #include "hashmap.h"
 #include "commit-graph.h"
@@ -143,6 +142,41 @@ void clear_bloom_key(struct bloom_key *key)
 	FREE_AND_NULL(key->hashes);
 }
 
+struct bloom_keyvec *bloom_keyvec_new(const char *path, size_t len,
+				      const struct bloom_filter_settings *settings)
+{
+	struct bloom_keyvec *vec;
+	size_t count = 1, i;
+	const char *p;
+
+	for (i = 0; i < len; i++)
+		if (path[i] == '/')
+			count++;
+
+	vec = xcalloc(1, st_add(sizeof(*vec),
+				st_mult(sizeof(vec->key[0]), count)));
+	vec->count = count;
+
+	fill_bloom_key(path, len, &vec->key[0], settings);
+	count = 1;
+	for (p = path + len - 1; p > path; p--)
+		if (*p == '/')
+			fill_bloom_key(path, p - path, &vec->key[count++], settings);
+
+	return vec;
+}
+
+void bloom_keyvec_free(struct bloom_keyvec *vec)
+{
+	size_t i;
+
+	if (!vec)
+		return;
+	for (i = 0; i < vec->count; i++)
+		clear_bloom_key(&vec->key[i]);
+	free(vec);
+}
+
 void add_key_to_filter(const struct bloom_key *key,
 		       struct bloom_filter *filter,
 		       const struct bloom_filter_settings *settings)
@@ -183,95 +217,122 @@ static void init_truncated_large_filter(struct bloom_filter *filter)
 	filter->len = 1;
 }
 
-struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
-						 struct commit *c,
-						 int compute_if_not_present,
-						 const struct bloom_filter_settings *settings,
-						 enum bloom_filter_computed *computed)
+/*
+ * The paths changed by a commit, collected by the tree diff callbacks
+ * below rather than through the global diff queue, so that filters of
+ * several commits can be computed at once.
+ */
+struct changed_paths {
+	struct hashmap pathmap;
+	uint32_t nr;
+	uint32_t max_changes;
+};
+
+static void add_changed_path(struct diff_options *opt, const char *path)
 {
-	struct bloom_filter *filter;
-	int i;
-	struct diff_options diffopt;
+	struct changed_paths *cp = opt->change_fn_data;
+	size_t len = strlen(path);
+
+	if (++cp->nr > cp->max_changes) {
+		/* The filter will be truncated anyway; stop the diff. */
+		opt->flags.quick = 1;
+		opt->flags.has_changes = 1;
+		return;
+	}
 
-	if (computed)
-		*computed = BLOOM_NOT_COMPUTED;
+	/*
+	 * Add each leading directory of the changed file, i.e. for
+	 * 'dir/subdir/file' add 'dir' and 'dir/subdir' as well, so
+	 * the Bloom filter could be used to speed up commands like
+	 * 'git log dir/subdir', too.
+	 *
+	 * Note that directories are added without the trailing '/'.
+	 */
+	while (len) {
+		struct pathmap_hash_entry *e;
 
-	if (!bloom_filters.slab_size)
-		return NULL;
+		FLEX_ALLOC_MEM(e, path, path, len);
+		hashmap_entry_init(&e->entry, strhash(e->path));
 
-	filter = bloom_filter_slab_at(&bloom_filters, c);
+		if (!hashmap_get(&cp->pathmap, &e->entry, NULL))
+			hashmap_add(&cp->pathmap, &e->entry);
+		else
+			free(e);
 
-	if (!filter->data) {
-		uint32_t graph_pos;
-		if (repo_find_commit_pos_in_graph(r, c, &graph_pos))
-			load_bloom_filter_from_graph(r->objects->commit_graph,
-						     filter, graph_pos);
+		while (len && path[len - 1] != '/')
+			len--;
+		if (len)
+			len--;
 	}
+}
 
-	if (filter->data && filter->len)
-		return filter;
-	if (!compute_if_not_present)
-		return NULL;
+static void bloom_add_remove(struct diff_options *opt,
+			     int addremove UNUSED,
+			     unsigned mode UNUSED,
+			     const struct object_id *oid UNUSED,
+			     int oid_valid UNUSED,
+			     const char *fullpath,
+			     unsigned dirty_submodule UNUSED)
+{
+	add_changed_path(opt, fullpath);
+}
+
+static void bloom_change(struct diff_options *opt,
+			 unsigned old_mode UNUSED,
+			 unsigned new_mode UNUSED,
+			 const struct object_id *old_oid UNUSED,
+			 const struct object_id *new_oid UNUSED,
+			 int old_oid_valid UNUSED,
+			 int new_oid_valid UNUSED,
+			 const char *fullpath,
+			 unsigned old_dirty_submodule UNUSED,
+			 unsigned new_dirty_submodule UNUSED)
+{
+	add_changed_path(opt, fullpath);
+}
+
+struct bloom_filter *compute_bloom_filter(struct repository *r,
+					  struct commit *c,
+					  const struct bloom_filter_settings *settings,
+					  enum bloom_filter_computed *computed)
+{
+	struct bloom_filter *filter;
+	struct diff_options diffopt;
+	struct changed_paths cp = {
+		.pathmap = HASHMAP_INIT(pathmap_cmp, NULL),
+		.max_changes = settings->max_changed_paths,
+	};
+
+	filter = bloom_filter_slab_peek(&bloom_filters, c);
+	if (!filter)
+		BUG("compute_bloom_filter() called before looking up the filter");
+
+	if (computed)
+		*computed = BLOOM_COMPUTED;
 
 	repo_diff_setup(r, &diffopt);
 	diffopt.flags.recursive = 1;
 	diffopt.detect_rename = 0;
-	diffopt.max_changes = settings->max_changed_paths;
+	diffopt.add_remove = bloom_add_remove;
+	diffopt.change = bloom_change;
+	diffopt.change_fn_data = &cp;
 	diff_setup_done(&diffopt);
 
-	/* ensure commit is parsed so we have parent information */
-	repo_parse_commit(r, c);
-
 	if (c->parents)
 		diff_tree_oid(&c->parents->item->object.oid, &c->object.oid, "", &diffopt);
 	else
 		diff_tree_oid(NULL, &c->object.oid, "", &diffopt);
-	diffcore_std(&diffopt);
 
-	if (diff_queued_diff.nr <= settings->max_changed_paths) {
-		struct hashmap pathmap = HASHMAP_INIT(pathmap_cmp, NULL);
+	if (cp.nr > settings->max_changed_paths ||
+	    hashmap_get_size(&cp.pathmap) > settings->max_changed_paths) {
+		init_truncated_large_filter(filter);
+		if (computed)
+			*computed |= BLOOM_TRUNC_LARGE;
+	} else {
 		struct pathmap_hash_entry *e;
 		struct hashmap_iter iter;
 
-		for (i = 0; i < diff_queued_diff.nr; i++) {
-			const char *path = diff_queued_diff.queue[i]->two->path;
-
-			/*
-			 * Add each leading directory of the changed file, i.e. for
-			 * 'dir/subdir/file' add 'dir' and 'dir/subdir' as well, so
-			 * the Bloom filter could be used to speed up commands like
-			 * 'git log dir/subdir', too.
-			 *
-			 * Note that directories are added without the trailing '/'.
-			 */
-			do {
-				char *last_slash = strrchr(path, '/');
-
-				FLEX_ALLOC_STR(e, path, path);
-				hashmap_entry_init(&e->entry, strhash(path));
-
-				if (!hashmap_get(&pathmap, &e->entry, NULL))
-					hashmap_add(&pathmap, &e->entry);
-				else
-					free(e);
-
-				if (!last_slash)
-					last_slash = (char*)path;
-				*last_slash = '\0';
-
-			} while (*path);
-
-			diff_free_filepair(diff_queued_diff.queue[i]);
-		}
-
-		if (hashmap_get_size(&pathmap) > settings->max_changed_paths) {
-			init_truncated_large_filter(filter);
-			if (computed)
-				*computed |= BLOOM_TRUNC_LARGE;
-			goto cleanup;
-		}
-
-		filter->len = (hashmap_get_size(&pathmap) * settings->bits_per_entry + BITS_PER_WORD - 1) / BITS_PER_WORD;
+		filter->len = (hashmap_get_size(&cp.pathmap) * settings->bits_per_entry + BITS_PER_WORD - 1) / BITS_PER_WORD;
 		if (!filter->len) {
 			if (computed)
 				*computed |= BLOOM_TRUNC_EMPTY;
@@ -279,31 +340,52 @@ struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
 		}
 		CALLOC_ARRAY(filter->data, filter->len);
 
-		hashmap_for_each_entry(&pathmap, &iter, e, entry) {
+		hashmap_for_each_entry(&cp.pathmap, &iter, e, entry) {
 			struct bloom_key key;
 			fill_bloom_key(e->path, strlen(e->path), &key, settings);
 			add_key_to_filter(&key, filter, settings);
 			clear_bloom_key(&key);
 		}
+	}
 
-	cleanup:
-		hashmap_clear_and_free(&pathmap, struct pathmap_hash_entry, entry);
-	} else {
-		for (i = 0; i < diff_queued_diff.nr; i++)
-			diff_free_filepair(diff_queued_diff.queue[i]);
-		init_truncated_large_filter(filter);
+	hashmap_clear_and_free(&cp.pathmap, struct pathmap_hash_entry, entry);
+	diff_free(&diffopt);
 
-		if (computed)
-			*computed |= BLOOM_TRUNC_LARGE;
-	}
+	return filter;
+}
+
+struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
+						 struct commit *c,
+						 int compute_if_not_present,
+						 const struct bloom_filter_settings *settings,
+						 enum bloom_filter_computed *computed)
+{
+	struct bloom_filter *filter;
 
 	if (computed)
-		*computed |= BLOOM_COMPUTED;
+		*computed = BLOOM_NOT_COMPUTED;
 
-	free(diff_queued_diff.queue);
-	DIFF_QUEUE_CLEAR(&diff_queued_diff);
+	if (!bloom_filters.slab_size)
+		return NULL;
 
-	return filter;
+	filter = bloom_filter_slab_at(&bloom_filters, c);
+
+	if (!filter->data) {
+		uint32_t graph_pos;
+		if (repo_find_commit_pos_in_graph(r, c, &graph_pos))
+			load_bloom_filter_from_graph(r->objects->commit_graph,
+						     filter, graph_pos);
+	}
+
+	if (filter->data && filter->len)
+		return filter;
+	if (!compute_if_not_present)
+		return NULL;
+
+	/* ensure commit is parsed so we have parent information */
+	repo_parse_commit(r, c);
+
+	return compute_bloom_filter(r, c, settings, computed);
 }
 
 int bloom_filter_contains(const struct bloom_filter *filter,
@@ -325,3 +407,16 @@ int bloom_filter_contains(const struct bloom_filter *filter,
 
 	return 1;
 }
+
+int bloom_filter_contains_vec(const struct bloom_filter *filter,
+			      const struct bloom_keyvec *vec,
+			      const struct bloom_filter_settings *settings)
+{
+	int result = 1;
+	size_t i;
+
+	for (i = 0; result && i < vec->count; i++)
+		result = bloom_filter_contains(filter, &vec->key[i], settings);
+
+	return result;
+}
@@ -83,6 +83,25 @@ void fill_bloom_key(const char *data,
 		    const struct bloom_filter_settings *settings);
 void clear_bloom_key(struct bloom_key *key);
 
+/*
+ * A bloom_keyvec holds the keys for a path and for each of its leading
+ * directories, longest first. A commit that changes the path also has
+ * all of those directories in its filter, so checking every key makes
+ * false positives less likely than checking the path alone.
+ */
+struct bloom_keyvec {
+	size_t count;
+	struct bloom_key key[FLEX_ARRAY];
+};
+
+/*
+ * Build the keys for the first "len" bytes of "path", which must use
+ * '/' as its separator and must not end with one.
+ */
+struct bloom_keyvec *bloom_keyvec_new(const char *path, size_t len,
+				      const struct bloom_filter_settings *settings);
+void bloom_keyvec_free(struct bloom_keyvec *vec);
+
 void add_key_to_filter(const struct bloom_key *key,
 		       struct bloom_filter *filter,
 		       const struct bloom_filter_settings *settings);
@@ -102,6 +121,19 @@ struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
 						 const struct bloom_filter_settings *settings,
 						 enum bloom_filter_computed *computed);
 
+/*
+ * Compute the changed-path Bloom filter of commit 'c' into the slab
+ * slot that a prior get_or_compute_bloom_filter() call (with or without
+ * 'compute_if_not_present') allocated for it; 'c' must already be
+ * parsed. As it neither grows the slab nor touches the global diff
+ * queue, several threads may compute filters of distinct commits at
+ * the same time, provided the object read lock is enabled.
+ */
+struct bloom_filter *compute_bloom_filter(struct repository *r,
+					  struct commit *c,
+					  const struct bloom_filter_settings *settings,
+					  enum bloom_filter_computed *computed);
+
 #define get_bloom_filter(r, c) get_or_compute_bloom_filter( \
 	(r), (c), 0, NULL, NULL)
 
@@ -109,4 +141,13 @@ int bloom_filter_contains(const struct bloom_filter *filter,
 			  const struct bloom_key *key,
 			  const struct bloom_filter_settings *settings);
 
+/*
+ * Like bloom_filter_contains(), but for all keys of "vec": returns 0
+ * if the filter lacks any of them, and non-zero if the path may have
+ * changed.
+ */
+int bloom_filter_contains_vec(const struct bloom_filter *filter,
+			      const struct bloom_keyvec *vec,
+			      const struct bloom_filter_settings *settings);
+
 #endif
@@ -370,15 +370,80 @@ static void batch_write(struct batch_options *opt, const void *data, int len)
 		write_or_die(1, data, len);
 }
 
-static void print_object_or_die(struct batch_options *opt, struct expand_data *data)
+/*
+ * Copy the contents of "st" to the batch output in large chunks, so
+ * that neither the whole object nor a per-object flush of stdout is
+ * needed.
+ */
+static void batch_write_istream(struct batch_options *opt,
+				const struct object_id *oid,
+				struct git_istream *st)
+{
+	static char buf[64 * 1024];
+
+	for (;;) {
+		ssize_t readlen = read_istream(st, buf, sizeof(buf));
+
+		if (readlen < 0)
+			die("unable to stream %s to stdout", oid_to_hex(oid));
+		if (!readlen)
+			break;
+		batch_write(opt, buf, readlen);
+	}
+	close_istream(st);
+}
+
+/*
+ * Write an undeltified packed object by inflating it straight out of
+ * the pack, rather than reading it into a buffer of its own first.
+ * Returns -1 if the object cannot be read this way, and the caller
+ * has to fall back to reading it the usual way.
+ */
+static int batch_write_packed(struct batch_options *opt,
+			      struct expand_data *data,
+			      struct packed_git *pack,
+			      off_t offset)
+{
+	const struct object_id *oid = &data->oid;
+	struct git_istream *st;
+	enum object_type type;
+	unsigned long size;
+
+	if (pack) {
+		/*
+		 * The pack entry was found without looking at replace
+		 * refs, so leave replaced objects to the slow path.
+		 */
+		if (lookup_replace_object(the_repository, oid) != oid)
+			return -1;
+	} else if (data->info.whence == OI_PACKED &&
+		   !data->info.u.packed.is_delta) {
+		pack = data->info.u.packed.pack;
+		offset = data->info.u.packed.offset;
+	} else {
+		return -1;
+	}
+
+	st = open_istream_pack_entry(pack, offset, &type, &size);
+	if (!st)
+		return -1;
+	if (type != data->type)
+		die("object %s changed type!?", oid_to_hex(oid));
+	if (data->info.sizep && size != data->size)
+		die("object %s changed size!?", oid_to_hex(oid));
+
+	batch_write_istream(opt, oid, st);
+	return 0;
+}
+
+static void print_object_or_die(struct batch_options *opt, struct expand_data *data,
+				struct packed_git *pack, off_t offset)
 {
 	const struct object_id *oid = &data->oid;
 
 	assert(data->info.typep);
 
 	if (data->type == OBJ_BLOB) {
-		if (opt->buffer_output)
-			fflush(stdout);
 		if (opt->transform_mode) {
 			char *contents;
 			unsigned long size;
@@ -407,8 +472,15 @@ static void print_object_or_die(struct batch_options *opt, struct expand_data *d
 				BUG("invalid transform_mode: %c", opt->transform_mode);
 			batch_write(opt, contents, size);
 			free(contents);
-		} else {
-			stream_blob(oid);
+		} else if (batch_write_packed(opt, data, pack, offset)) {
+			enum object_type type;
+			unsigned long size;
+			struct git_istream *st;
+
+			st = open_istream(the_repository, oid, &type, &size, NULL);
+			if (!st)
+				die("unable to stream %s to stdout", oid_to_hex(oid));
+			batch_write_istream(opt, oid, st);
 		}
 	}
 	else {
@@ -416,6 +488,9 @@ static void print_object_or_die(struct batch_options *opt, struct expand_data *d
 		unsigned long size;
 		void *contents;
 
+		if (!use_mailmap && !batch_write_packed(opt, data, pack, offset))
+			return;
+
 		contents = repo_read_object_file(the_repository, oid, &type,
 						 &size);
 
@@ -501,7 +576,7 @@ static void batch_object_write(const char *obj_name,
 	batch_write(opt, scratch->buf, scratch->len);
 
 	if (opt->batch_mode == BATCH_MODE_CONTENTS) {
-		print_object_or_die(opt, data);
+		print_object_or_die(opt, data, pack, offset);
 		batch_write(opt, "\n", 1);
 	}
 }
@@ -770,6 +845,16 @@ static int batch_objects(struct batch_options *opt)
 	int save_warning;
 	int retval = 0;
 
+	/*
+	 * Give stdio a buffer big enough to hold many small objects when
+	 * we are asked to buffer, so that we do not issue a write(2) for
+	 * every few trees or commits.
+	 */
+	if (opt->buffer_output) {
+		static char stdout_buf[64 * 1024];
+		setvbuf(stdout, stdout_buf, _IOFBF, sizeof(stdout_buf));
+	}
+
 	/*
 	 * Expand once with our special mark_query flag, which will prime the
 	 * object_info to be handed to oid_object_info_extended for each
@@ -226,6 +226,8 @@ static int graph_write(int argc, const char **argv, const char *prefix)
 			N_("maximum number of commits in a non-base split commit-graph")),
 		OPT_INTEGER(0, "size-multiple", &write_opts.size_multiple,
 			N_("maximum ratio between two levels of a split commit-graph")),
+		OPT_INTEGER(0, "max-layers", &write_opts.max_layers,
+			N_("maximum number of layers in a split commit-graph chain")),
 		OPT_EXPIRY_DATE(0, "expire-time", &write_opts.expire_time,
 			N_("only expire files older than a given date-time")),
 		OPT_CALLBACK_F(0, "max-new-filters", &write_opts.max_new_filters,
@@ -241,6 +243,7 @@ static int graph_write(int argc, const char **argv, const char *prefix)
 	opts.enable_changed_paths = -1;
 	write_opts.size_multiple = 2;
 	write_opts.max_commits = 0;
+	write_opts.max_layers = -1;
 	write_opts.expire_time = 0;
 	write_opts.max_new_filters = -1;
 
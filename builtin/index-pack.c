@@ -25,6 +25,8 @@
 #include "promisor-remote.h"
 #include "setup.h"
 #include "wrapper.h"
+#include "khash.h"
+#include "trace2.h"
 
 static const char index_pack_usage[] =
 "git index-pack [-v] [-o <index-file>] [--keep | --keep=<msg>] [--[no-]rev-index] [--verify] [--strict] (<pack-file> | --stdin [--fix-thin] [<pack-file>])";
@@ -101,6 +103,76 @@ struct thread_local {
 	int pack_fd;
 };
 
+/*
+ * With pack.streamingIndex, deltas are resolved by worker threads while
+ * the rest of the pack is still being received, as soon as their base
+ * has been received (OFS_DELTA) or resolved (REF_DELTA whose base was
+ * seen earlier in the pack). The second pass then only needs to walk
+ * the delta trees that still contain unresolved deltas.
+ */
+enum early_state {
+	EARLY_NONE = 0,
+	EARLY_PENDING,
+	EARLY_RESOLVED,
+};
+
+struct early_info {
+	/* Base object number of a delta, -1 if unknown. */
+	int base;
+	/* Guarded by work_mutex while receiving. */
+	unsigned state : 2;
+	/* Whether the second pass needs this object's data. */
+	unsigned needed : 1;
+};
+
+struct early_job {
+	struct early_job *next;
+	int obj_no;
+	int base;
+	struct object_id base_oid;
+	void *delta_data;
+};
+
+struct early_cache_entry {
+	struct hashmap_entry ent;
+	struct list_head lru;
+	int obj_no;
+	void *data;
+	unsigned long size;
+};
+
+static int streaming_index = -1;
+static struct early_info *early_info;
+static int early_nr;
+static int nr_early_resolved;
+
+/*
+ * Jobs whose objects were parsed since the last flush(); main thread
+ * only.
+ */
+static struct early_job *early_deferred;
+static struct early_job **early_deferred_tail = &early_deferred;
+static off_t flushed_bytes;
+
+/*
+ * The remaining state is guarded by work_mutex: the stack of runnable
+ * jobs, the jobs waiting for their (pending) base to be resolved, the
+ * size of the delta data held by queued jobs, the known object names
+ * and a cache of recently seen object data.
+ */
+static struct early_job *early_ready;
+static struct early_job **early_waiters;
+static int early_running;
+static int early_input_done;
+static size_t early_queued;
+static size_t early_queue_limit;
+static pthread_cond_t early_cond;
+static kh_oid_pos_t *early_oids;
+static struct hashmap early_cache;
+static LIST_HEAD(early_cache_lru);
+static size_t early_cache_used;
+static size_t early_cache_limit;
+
 /* Remember to update object flag allocation in object.h */
 #define FLAG_LINK (1u<<20)
 #define FLAG_CHECKED (1u<<21)
@@ -289,6 +361,7 @@ static void flush(void)
 		the_hash_algo->update_fn(&input_ctx, input_buffer, input_offset);
 		memmove(input_buffer, input_buffer + input_offset, input_len);
 		input_offset = 0;
+		flushed_bytes = consumed_bytes;
 	}
 }
 
@@ -451,6 +524,24 @@ static int is_delta_type(enum object_type type)
 	return (type == OBJ_REF_DELTA || type == OBJ_OFS_DELTA);
 }
 
+static int early_resolved(const struct object_entry *obj)
+{
+	int i = obj - objects;
+	return i < early_nr && early_info[i].state == EARLY_RESOLVED;
+}
+
+/*
+ * Whether the second pass can leave this object alone, because it and
+ * all of its descendants have been resolved while receiving.
+ */
+static int early_skip(const struct object_entry *obj)
+{
+	int i = obj - objects;
+	return i < early_nr && !early_info[i].needed &&
+	       (!is_delta_type(obj->type) ||
+		early_info[i].state == EARLY_RESOLVED);
+}
+
 static void *unpack_entry_data(off_t offset, unsigned long size,
 			       enum object_type type, struct object_id *oid)
 {
@@ -967,8 +1058,9 @@ static struct base_data *resolve_delta(struct object_entry *delta_obj,
 	void *delta_data, *result_data;
 	struct base_data *result;
 	unsigned long result_size;
+	int resolved = early_resolved(delta_obj);
 
-	if (show_stat) {
+	if (show_stat && !resolved) {
 		int i = delta_obj - objects;
 		int j = base->obj - objects;
 		obj_stat[i].delta_depth = obj_stat[j].delta_depth + 1;
@@ -985,20 +1077,421 @@ static struct base_data *resolve_delta(struct object_entry *delta_obj,
 	free(delta_data);
 	if (!result_data)
 		bad_object(delta_obj->idx.offset, _("failed to apply delta"));
-	hash_object_file(the_hash_algo, result_data, result_size,
-			 delta_obj->real_type, &delta_obj->idx.oid);
-	sha1_object(result_data, NULL, result_size, delta_obj->real_type,
-		    &delta_obj->idx.oid);
+	/*
+	 * A delta resolved while receiving only has its data recreated
+	 * for the sake of its unresolved descendants.
+	 */
+	if (!resolved) {
+		hash_object_file(the_hash_algo, result_data, result_size,
+				 delta_obj->real_type, &delta_obj->idx.oid);
+		sha1_object(result_data, NULL, result_size,
+			    delta_obj->real_type, &delta_obj->idx.oid);
+
+		counter_lock();
+		nr_resolved_deltas++;
+		counter_unlock();
+	}
 
 	result = make_base(delta_obj, base);
 	result->data = result_data;
 	result->size = result_size;
 
+	return result;
+}
+
+static int early_cache_cmp(const void *cmp_data UNUSED,
+			   const struct hashmap_entry *eptr,
+			   const struct hashmap_entry *entry_or_key,
+			   const void *keydata UNUSED)
+{
+	const struct early_cache_entry *a, *b;
+
+	a = container_of(eptr, const struct early_cache_entry, ent);
+	b = container_of(entry_or_key, const struct early_cache_entry, ent);
+	return a->obj_no != b->obj_no;
+}
+
+static struct early_cache_entry *early_cache_find(int obj_no)
+{
+	struct early_cache_entry key;
+
+	hashmap_entry_init(&key.ent, obj_no);
+	key.obj_no = obj_no;
+	return hashmap_get_entry(&early_cache, &key, ent, NULL);
+}
+
+/* Takes ownership of "data". Must be called under work_mutex. */
+static void early_cache_add(int obj_no, void *data, unsigned long size)
+{
+	struct early_cache_entry *e;
+
+	if (size > early_cache_limit || early_cache_find(obj_no)) {
+		free(data);
+		return;
+	}
+	while (early_cache_used + size > early_cache_limit) {
+		e = list_entry(early_cache_lru.prev,
+			       struct early_cache_entry, lru);
+		hashmap_remove(&early_cache, &e->ent, NULL);
+		list_del(&e->lru);
+		early_cache_used -= e->size;
+		free(e->data);
+		free(e);
+	}
+
+	CALLOC_ARRAY(e, 1);
+	hashmap_entry_init(&e->ent, obj_no);
+	e->obj_no = obj_no;
+	e->data = data;
+	e->size = size;
+	hashmap_add(&early_cache, &e->ent);
+	list_add(&e->lru, &early_cache_lru);
+	early_cache_used += size;
+}
+
+/* Returns a copy of the cached data, if any. */
+static void *early_cache_get(int obj_no, unsigned long *size)
+{
+	struct early_cache_entry *e;
+	void *data = NULL;
+
+	work_lock();
+	e = early_cache_find(obj_no);
+	if (e) {
+		list_del(&e->lru);
+		list_add(&e->lru, &early_cache_lru);
+		data = xmemdupz(e->data, e->size);
+		*size = e->size;
+	}
+	work_unlock();
+	return data;
+}
+
+static void early_cache_clear(void)
+{
+	struct early_cache_entry *e;
+	struct hashmap_iter iter;
+
+	hashmap_for_each_entry(&early_cache, &iter, e, ent)
+		free(e->data);
+	hashmap_clear_and_free(&early_cache, struct early_cache_entry, ent);
+	INIT_LIST_HEAD(&early_cache_lru);
+	early_cache_used = 0;
+}
+
+/*
+ * Recreate the data of an object that has been received and, if it is
+ * a delta, resolved already.
+ */
+static void *early_base_data(int obj_no, unsigned long *size)
+{
+	int *chain = NULL;
+	int chain_nr = 0, chain_alloc = 0;
+	void *data;
+
+	for (;;) {
+		data = early_cache_get(obj_no, size);
+		if (data)
+			break;
+		if (!is_delta_type(objects[obj_no].type)) {
+			data = get_data_from_pack(&objects[obj_no]);
+			*size = objects[obj_no].size;
+			break;
+		}
+		ALLOC_GROW(chain, chain_nr + 1, chain_alloc);
+		chain[chain_nr++] = obj_no;
+		obj_no = early_info[obj_no].base;
+	}
+
+	while (chain_nr--) {
+		struct object_entry *obj = &objects[chain[chain_nr]];
+		void *raw = get_data_from_pack(obj);
+		void *result = patch_delta(data, *size, raw, obj->size, size);
+
+		free(raw);
+		free(data);
+		if (!result)
+			bad_object(obj->idx.offset, _("failed to apply delta"));
+		data = result;
+	}
+	free(chain);
+	return data;
+}
+
+/* Must be called under work_mutex. */
+static void early_run(struct early_job *job)
+{
+	job->next = early_ready;
+	early_ready = job;
+	pthread_cond_signal(&early_cond);
+}
+
+static void early_resolve(struct early_job *job)
+{
+	struct object_entry *obj = &objects[job->obj_no];
+	struct object_entry *base = &objects[job->base];
+	struct early_job *waiter;
+	unsigned long base_size, result_size;
+	void *base_data, *result;
+	int ret;
+	khiter_t pos;
+
+	base_data = early_base_data(job->base, &base_size);
+	result = patch_delta(base_data, base_size,
+			     job->delta_data, obj->size, &result_size);
+	free(base_data);
+	FREE_AND_NULL(job->delta_data);
+	if (!result)
+		bad_object(obj->idx.offset, _("failed to apply delta"));
+
+	obj->real_type = is_delta_type(base->type) ?
+		base->real_type : base->type;
+	hash_object_file(the_hash_algo, result, result_size,
+			 obj->real_type, &obj->idx.oid);
+	sha1_object(result, NULL, result_size, obj->real_type, &obj->idx.oid);
+
+	if (show_stat) {
+		obj_stat[job->obj_no].delta_depth =
+			obj_stat[job->base].delta_depth + 1;
+		obj_stat[job->obj_no].base_object_no = job->base;
+		deepest_delta_lock();
+		if (deepest_delta < obj_stat[job->obj_no].delta_depth)
+			deepest_delta = obj_stat[job->obj_no].delta_depth;
+		deepest_delta_unlock();
+	}
+
 	counter_lock();
 	nr_resolved_deltas++;
 	counter_unlock();
 
-	return result;
+	work_lock();
+	early_queued -= obj->size;
+	early_info[job->obj_no].state = EARLY_RESOLVED;
+	nr_early_resolved++;
+	pos = kh_put_oid_pos(early_oids, obj->idx.oid, &ret);
+	if (ret)
+		kh_value(early_oids, pos) = job->obj_no;
+	while ((waiter = early_waiters[job->obj_no])) {
+		early_waiters[job->obj_no] = waiter->next;
+		early_run(waiter);
+	}
+	early_cache_add(job->obj_no, result, result_size);
+	work_unlock();
+
+	free(job);
+}
+
+static void *early_resolve_thread(void *data)
+{
+	set_thread_data(data);
+	work_lock();
+	for (;;) {
+		struct early_job *job = early_ready;
+
+		if (!job) {
+			if (early_input_done && !early_running)
+				break;
+			pthread_cond_wait(&early_cond, &work_mutex);
+			continue;
+		}
+		early_ready = job->next;
+		early_running++;
+		work_unlock();
+
+		early_resolve(job);
+
+		work_lock();
+		early_running--;
+	}
+	/* Let the other threads notice that there is nothing left. */
+	pthread_cond_broadcast(&early_cond);
+	work_unlock();
+	return NULL;
+}
+
+/*
+ * Hand the deltas parsed so far to the worker threads. This must only
+ * be called right after flush(), so that their bases can be read back
+ * from the pack.
+ */
+static void early_dispatch(void)
+{
+	work_lock();
+	while (early_deferred) {
+		struct early_job *job = early_deferred;
+		int base = job->base;
+
+		early_deferred = job->next;
+		if (base < 0) {
+			khiter_t pos = kh_get_oid_pos(early_oids, job->base_oid);
+			if (pos < kh_end(early_oids))
+				base = kh_value(early_oids, pos);
+		}
+		if (base < 0 ||
+		    (is_delta_type(objects[base].type) &&
+		     early_info[base].state == EARLY_NONE)) {
+			/* Leave it to the second pass. */
+			early_queued -= objects[job->obj_no].size;
+			free(job->delta_data);
+			free(job);
+			continue;
+		}
+
+		job->base = base;
+		early_info[job->obj_no].base = base;
+		early_info[job->obj_no].state = EARLY_PENDING;
+		if (is_delta_type(objects[base].type) &&
+		    early_info[base].state == EARLY_PENDING) {
+			job->next = early_waiters[base];
+			early_waiters[base] = job;
+		} else {
+			early_run(job);
+		}
+	}
+	early_deferred_tail = &early_deferred;
+	work_unlock();
+}
+
+static void early_queue(int obj_no, int base, const struct object_id *base_oid,
+			void *delta_data)
+{
+	struct early_job *job;
+	unsigned long size = objects[obj_no].size;
+	int full;
+
+	early_info[obj_no].base = base;
+
+	/*
+	 * Bound the delta data waiting for the workers, in case they
+	 * fall behind the input; the second pass resolves the rest.
+	 */
+	work_lock();
+	full = early_queued + size > early_queue_limit;
+	if (!full)
+		early_queued += size;
+	work_unlock();
+	if (full) {
+		free(delta_data);
+		return;
+	}
+
+	CALLOC_ARRAY(job, 1);
+	job->obj_no = obj_no;
+	job->base = base;
+	if (base_oid)
+		oidcpy(&job->base_oid, base_oid);
+	job->delta_data = delta_data;
+	*early_deferred_tail = job;
+	early_deferred_tail = &job->next;
+}
+
+/* Must be called with the parsed non-delta object's data. */
+static void early_add_base(int obj_no, void *data, unsigned long size)
+{
+	khiter_t pos;
+	int ret;
+
+	work_lock();
+	pos = kh_put_oid_pos(early_oids, objects[obj_no].idx.oid, &ret);
+	if (ret)
+		kh_value(early_oids, pos) = obj_no;
+	if (data)
+		early_cache_add(obj_no, data, size);
+	work_unlock();
+}
+
+static int find_object_by_offset(off_t offset, int nr)
+{
+	int first = 0, last = nr;
+
+	while (first < last) {
+		int next = first + (last - first) / 2;
+
+		if (objects[next].idx.offset == offset)
+			return next;
+		if (objects[next].idx.offset < offset)
+			first = next + 1;
+		else
+			last = next;
+	}
+	return -1;
+}
+
+static void start_early_resolution(void)
+{
+	int i;
+
+	CALLOC_ARRAY(early_info, nr_objects);
+	for (i = 0; i < nr_objects; i++)
+		early_info[i].base = -1;
+	early_nr = nr_objects;
+	CALLOC_ARRAY(early_waiters, nr_objects);
+	early_oids = kh_init_oid_pos();
+	hashmap_init(&early_cache, early_cache_cmp, NULL, 0);
+	early_cache_limit = delta_base_cache_limit * nr_threads;
+	early_queue_limit = early_cache_limit;
+
+	init_thread();
+	pthread_cond_init(&early_cond, NULL);
+	set_thread_data(&nothread_data);
+	for (i = 0; i < nr_threads; i++) {
+		int ret = pthread_create(&thread_data[i].thread, NULL,
+					 early_resolve_thread, thread_data + i);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+}
+
+static void mark_early_needed(int obj_no)
+{
+	while (obj_no >= 0 && !early_info[obj_no].needed) {
+		early_info[obj_no].needed = 1;
+		obj_no = is_delta_type(objects[obj_no].type) ?
+			early_info[obj_no].base : -1;
+	}
+}
+
+static void finish_early_resolution(void)
+{
+	int i;
+
+	early_dispatch();
+	work_lock();
+	early_input_done = 1;
+	pthread_cond_broadcast(&early_cond);
+	work_unlock();
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(thread_data[i].thread, NULL);
+	pthread_cond_destroy(&early_cond);
+	cleanup_thread();
+
+	/*
+	 * The second pass has to recreate the data of every object on the
+	 * way to a delta that is still unresolved.
+	 */
+	for (i = 0; i < nr_ofs_deltas; i++) {
+		int obj_no = ofs_deltas[i].obj_no;
+		if (early_info[obj_no].state != EARLY_RESOLVED)
+			mark_early_needed(early_info[obj_no].base);
+	}
+	for (i = 0; i < nr_ref_deltas; i++) {
+		int obj_no = ref_deltas[i].obj_no;
+		khiter_t pos;
+
+		if (early_info[obj_no].state == EARLY_RESOLVED)
+			continue;
+		pos = kh_get_oid_pos(early_oids, ref_deltas[i].oid);
+		if (pos < kh_end(early_oids))
+			mark_early_needed(kh_value(early_oids, pos));
+	}
+
+	trace2_data_intmax("index-pack", the_repository,
+			   "early-resolved-deltas", nr_early_resolved);
+
+	FREE_AND_NULL(early_waiters);
+	kh_destroy_oid_pos(early_oids);
+	early_oids = NULL;
+	early_cache_clear();
 }
 
 static int compare_ofs_delta_entry(const void *a, const void *b)
@@ -1027,6 +1520,7 @@ static void *threaded_second_pass(void *data)
 		struct base_data *parent = NULL;
 		struct object_entry *child_obj;
 		struct base_data *child;
+		int skip = 0;
 
 		counter_lock();
 		display_progress(progress, nr_resolved_deltas);
@@ -1038,7 +1532,8 @@ static void *threaded_second_pass(void *data)
 			 * Take an object from the object array.
 			 */
 			while (nr_dispatched < nr_objects &&
-			       is_delta_type(objects[nr_dispatched].type))
+			       (is_delta_type(objects[nr_dispatched].type) ||
+				early_skip(&objects[nr_dispatched])))
 				nr_dispatched++;
 			if (nr_dispatched >= nr_objects) {
 				work_unlock();
@@ -1056,16 +1551,21 @@ static void *threaded_second_pass(void *data)
 			if (parent->ref_first <= parent->ref_last) {
 				int offset = ref_deltas[parent->ref_first++].obj_no;
 				child_obj = objects + offset;
-				if (child_obj->real_type != OBJ_REF_DELTA)
+				if (early_resolved(child_obj))
+					; /* real_type already known */
+				else if (child_obj->real_type != OBJ_REF_DELTA)
 					die("REF_DELTA at offset %"PRIuMAX" already resolved (duplicate base %s?)",
 					    (uintmax_t) child_obj->idx.offset,
 					    oid_to_hex(&parent->obj->idx.oid));
-				child_obj->real_type = parent->obj->real_type;
+				else
+					child_obj->real_type = parent->obj->real_type;
 			} else {
 				child_obj = objects +
 					ofs_deltas[parent->ofs_first++].obj_no;
-				assert(child_obj->real_type == OBJ_OFS_DELTA);
-				child_obj->real_type = parent->obj->real_type;
+				if (!early_resolved(child_obj)) {
+					assert(child_obj->real_type == OBJ_OFS_DELTA);
+					child_obj->real_type = parent->obj->real_type;
+				}
 			}
 
 			if (parent->ref_first > parent->ref_last &&
@@ -1089,12 +1589,21 @@ static void *threaded_second_pass(void *data)
 			 * limit is exceeded, so in the typical case, this does
 			 * not happen.
 			 */
-			get_base_data(parent);
-			parent->retain_data++;
+			skip = early_skip(child_obj);
+			if (!skip) {
+				get_base_data(parent);
+				parent->retain_data++;
+			}
 		}
 		work_unlock();
 
-		if (parent) {
+		if (parent && skip) {
+			/*
+			 * This child and its descendants have been
+			 * resolved while receiving the pack.
+			 */
+			child = NULL;
+		} else if (parent) {
 			child = resolve_delta(child_obj, parent);
 			if (!child->children_remaining)
 				FREE_AND_NULL(child->data);
@@ -1114,9 +1623,9 @@ static void *threaded_second_pass(void *data)
 		}
 
 		work_lock();
-		if (parent)
+		if (parent && !skip)
 			parent->retain_data--;
-		if (child->data) {
+		if (child && child->data) {
 			/*
 			 * This child has its own children, so add it to
 			 * work_head.
@@ -1166,6 +1675,14 @@ static void parse_pack_objects(unsigned char *hash)
 	struct ofs_delta_entry *ofs_delta = ofs_deltas;
 	struct object_id ref_delta_oid;
 	struct stat st;
+	int early = 0;
+	off_t dispatched_bytes = 0;
+
+	if (streaming_index > 0 && HAVE_THREADS &&
+	    (nr_threads > 1 || getenv("GIT_FORCE_THREADS"))) {
+		early = 1;
+		start_early_resolution();
+	}
 
 	if (verbose)
 		progress = start_progress(
@@ -1179,10 +1696,19 @@ static void parse_pack_objects(unsigned char *hash)
 					      &obj->idx.oid);
 		obj->real_type = obj->type;
 		if (obj->type == OBJ_OFS_DELTA) {
+			if (early) {
+				early_queue(i, find_object_by_offset(ofs_delta->offset, i),
+					    NULL, data);
+				data = NULL;
+			}
 			nr_ofs_deltas++;
 			ofs_delta->obj_no = i;
 			ofs_delta++;
 		} else if (obj->type == OBJ_REF_DELTA) {
+			if (early) {
+				early_queue(i, -1, &ref_delta_oid, data);
+				data = NULL;
+			}
 			ALLOC_GROW(ref_deltas, nr_ref_deltas + 1, ref_deltas_alloc);
 			oidcpy(&ref_deltas[nr_ref_deltas].oid, &ref_delta_oid);
 			ref_deltas[nr_ref_deltas].obj_no = i;
@@ -1191,11 +1717,22 @@ static void parse_pack_objects(unsigned char *hash)
 			/* large blobs, check later */
 			obj->real_type = OBJ_BAD;
 			nr_delays++;
-		} else
+			if (early)
+				early_add_base(i, NULL, 0);
+		} else {
 			sha1_object(data, NULL, obj->size, obj->type,
 				    &obj->idx.oid);
+			if (early) {
+				early_add_base(i, data, obj->size);
+				data = NULL;
+			}
+		}
 		free(data);
 		display_progress(progress, i+1);
+		if (early && dispatched_bytes != flushed_bytes) {
+			early_dispatch();
+			dispatched_bytes = flushed_bytes;
+		}
 	}
 	objects[i].idx.offset = consumed_bytes;
 	stop_progress(&progress);
@@ -1207,6 +1744,9 @@ static void parse_pack_objects(unsigned char *hash)
 		die(_("pack is corrupted (SHA1 mismatch)"));
 	use(the_hash_algo->rawsz);
 
+	if (early)
+		finish_early_resolution();
+
 	/* If input_fd is a file, we should have reached its end now. */
 	if (fstat(input_fd, &st))
 		die_errno(_("cannot fstat packfile"));
@@ -1602,6 +2142,10 @@ static int git_index_pack_config(const char *k, const char *v, void *cb)
 		}
 		return 0;
 	}
+	if (!strcmp(k, "pack.streamingindex")) {
+		streaming_index = git_config_bool(k, v);
+		return 0;
+	}
 	if (!strcmp(k, "pack.writereverseindex")) {
 		if (git_config_bool(k, v))
 			opts->flags |= WRITE_REV;
@@ -1761,6 +2305,9 @@ int cmd_index_pack(int argc, const char **argv, const char *prefix)
 	if (prefix && chdir(prefix))
 		die(_("Cannot come back to cwd"));
 
+	if (streaming_index < 0)
+		streaming_index = git_env_bool("GIT_TEST_INDEX_PACK_STREAMING", 0);
+
 	if (git_env_bool(GIT_TEST_NO_WRITE_REV_INDEX, 0))
 		rev_index = 0;
 	else
@@ -1917,11 +2464,17 @@ int cmd_index_pack(int argc, const char **argv, const char *prefix)
 	if (show_stat)
 		CALLOC_ARRAY(obj_stat, st_add(nr_objects, 1));
 	CALLOC_ARRAY(ofs_deltas, nr_objects);
+	trace2_region_enter("index-pack", "parse-pack-objects", the_repository);
 	parse_pack_objects(pack_hash);
+	trace2_region_leave("index-pack", "parse-pack-objects", the_repository);
 	if (report_end_of_input)
 		write_in_full(2, "\0", 1);
+	trace2_region_enter("index-pack", "resolve-deltas", the_repository);
 	resolve_deltas();
+	trace2_region_leave("index-pack", "resolve-deltas", the_repository);
+	trace2_region_enter("index-pack", "conclude-pack", the_repository);
 	conclude_pack(fix_thin_pack, curr_pack, pack_hash);
+	trace2_region_leave("index-pack", "conclude-pack", the_repository);
 	free(ofs_deltas);
 	free(ref_deltas);
 	if (strict)
@@ -1954,6 +2507,7 @@ int cmd_index_pack(int argc, const char **argv, const char *prefix)
 
 	free(opts.anomaly);
 	free(objects);
+	free(early_info);
 	strbuf_release(&index_name_buf);
 	strbuf_release(&rev_index_name_buf);
 	if (!pack_name)
@@ -67,6 +67,7 @@ static const char *fmt_patch_subject_prefix = "PATCH";
 static int fmt_patch_name_max = FORMAT_PATCH_NAME_MAX_DEFAULT;
 static const char *fmt_pretty;
 static int format_no_prefix;
+static int log_format_threads = 1;
 
 static const char * const builtin_log_usage[] = {
 	N_("git log [<options>] [<revision-range>] [[--] <path>...]"),
@@ -488,11 +489,144 @@ static void finish_early_output(struct rev_info *rev)
 	show_early_header(rev, "done", n);
 }
 
+struct log_walk_state {
+	int saved_nrl;
+	int saved_dcctc;
+};
+
+static void log_show_commit(struct rev_info *rev, struct commit *commit,
+			    struct log_walk_state *state)
+{
+	if (!log_tree_commit(rev, commit) && rev->max_count >= 0)
+		/*
+		 * We decremented max_count in get_revision,
+		 * but we didn't actually show the commit.
+		 */
+		rev->max_count++;
+	if (!rev->reflog_info) {
+		/*
+		 * We may show a given commit multiple times when
+		 * walking the reflogs.
+		 */
+		free_commit_buffer(the_repository->parsed_objects,
+				   commit);
+		free_commit_list(commit->parents);
+		commit->parents = NULL;
+	}
+	if (state->saved_nrl < rev->diffopt.needed_rename_limit)
+		state->saved_nrl = rev->diffopt.needed_rename_limit;
+	if (rev->diffopt.degraded_cc_to_c)
+		state->saved_dcctc = 1;
+}
+
+/* Number of commits taken from the walk before they are formatted. */
+#define LOG_FORMAT_BATCH 1024
+
+struct log_format_worker {
+	pthread_t thread;
+	struct rev_info *rev;
+	struct commit **commits;
+	struct strbuf *msgs;
+	size_t nr;
+};
+
+static void *log_format_thread(void *data)
+{
+	struct log_format_worker *w = data;
+	size_t i;
+
+	for (i = 0; i < w->nr; i++)
+		log_tree_format_message(w->rev, w->commits[i], &w->msgs[i]);
+	return NULL;
+}
+
+/*
+ * Walk like cmd_log_walk_no_free(), but take the commits from the walk
+ * in batches and pretty-print each batch in "nr_threads" threads
+ * before showing its commits in order. The walk itself, which parses
+ * the commits, and everything show_log() prints around the messages
+ * stay on this thread, which waits for the workers, so that they never
+ * run at the same time as code that changes the commits or the object
+ * store.
+ */
+static void log_walk_threaded(struct rev_info *rev, int nr_threads,
+			      struct log_walk_state *state)
+{
+	struct commit **commits;
+	struct strbuf *msgs;
+	struct log_format_worker *workers;
+	size_t i, nr;
+	int t, warm = 0;
+
+	ALLOC_ARRAY(commits, LOG_FORMAT_BATCH);
+	CALLOC_ARRAY(msgs, LOG_FORMAT_BATCH);
+	CALLOC_ARRAY(workers, nr_threads);
+	for (i = 0; i < LOG_FORMAT_BATCH; i++)
+		strbuf_init(&msgs[i], 0);
+
+	enable_obj_read_lock();
+	for (;;) {
+		size_t start = 0, per_thread;
+
+		/*
+		 * Do not ask a walk that has reached --max-count for more;
+		 * commits that turn out not to be shown give it back.
+		 */
+		nr = 0;
+		while (nr < LOG_FORMAT_BATCH && rev->max_count &&
+		       (commits[nr] = get_revision(rev)))
+			nr++;
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr; i++)
+			strbuf_reset(&msgs[i]);
+
+		/*
+		 * Format the very first message here, so that whatever
+		 * pretty.c sets up lazily (the mailmap, color and trailer
+		 * configuration) is in place before the threads start.
+		 */
+		if (!warm) {
+			log_tree_format_message(rev, commits[0], &msgs[0]);
+			start = warm = 1;
+		}
+
+		per_thread = DIV_ROUND_UP(nr - start, nr_threads);
+		for (t = 0; t < nr_threads && start < nr; t++) {
+			struct log_format_worker *w = &workers[t];
+
+			w->rev = rev;
+			w->commits = commits + start;
+			w->msgs = msgs + start;
+			w->nr = per_thread < nr - start ? per_thread : nr - start;
+			start += w->nr;
+			if (pthread_create(&w->thread, NULL, log_format_thread, w))
+				die(_("unable to create thread"));
+		}
+		while (t--)
+			pthread_join(workers[t].thread, NULL);
+
+		for (i = 0; i < nr; i++) {
+			rev->preformatted_msg = &msgs[i];
+			log_show_commit(rev, commits[i], state);
+		}
+		rev->preformatted_msg = NULL;
+	}
+	disable_obj_read_lock();
+
+	for (i = 0; i < LOG_FORMAT_BATCH; i++)
+		strbuf_release(&msgs[i]);
+	free(msgs);
+	free(commits);
+	free(workers);
+}
+
 static int cmd_log_walk_no_free(struct rev_info *rev)
 {
 	struct commit *commit;
-	int saved_nrl = 0;
-	int saved_dcctc = 0;
+	struct log_walk_state state = { 0 };
+	int nr_threads = log_format_threads;
 
 	if (rev->remerge_diff) {
 		rev->remerge_objdir = tmp_objdir_create("remerge-diff");
@@ -515,30 +649,15 @@ static int cmd_log_walk_no_free(struct rev_info *rev)
 	 * and HAS_CHANGES being accumulated in rev->diffopt, so be careful to
 	 * retain that state information if replacing rev->diffopt in this loop
 	 */
-	while ((commit = get_revision(rev)) != NULL) {
-		if (!log_tree_commit(rev, commit) && rev->max_count >= 0)
-			/*
-			 * We decremented max_count in get_revision,
-			 * but we didn't actually show the commit.
-			 */
-			rev->max_count++;
-		if (!rev->reflog_info) {
-			/*
-			 * We may show a given commit multiple times when
-			 * walking the reflogs.
-			 */
-			free_commit_buffer(the_repository->parsed_objects,
-					   commit);
-			free_commit_list(commit->parents);
-			commit->parents = NULL;
-		}
-		if (saved_nrl < rev->diffopt.needed_rename_limit)
-			saved_nrl = rev->diffopt.needed_rename_limit;
-		if (rev->diffopt.degraded_cc_to_c)
-			saved_dcctc = 1;
-	}
-	rev->diffopt.degraded_cc_to_c = saved_dcctc;
-	rev->diffopt.needed_rename_limit = saved_nrl;
+	if (!nr_threads)
+		nr_threads = online_cpus();
+	if (nr_threads > 1 && log_tree_can_preformat(rev))
+		log_walk_threaded(rev, nr_threads, &state);
+	else
+		while ((commit = get_revision(rev)) != NULL)
+			log_show_commit(rev, commit, &state);
+	rev->diffopt.degraded_cc_to_c = state.saved_dcctc;
+	rev->diffopt.needed_rename_limit = state.saved_nrl;
 
 	if (rev->remerge_diff) {
 		tmp_objdir_destroy(rev->remerge_objdir);
@@ -611,6 +730,17 @@ static int git_log_config(const char *var, const char *value, void *cb)
 		default_show_signature = git_config_bool(var, value);
 		return 0;
 	}
+	if (!strcmp(var, "log.formatthreads")) {
+		log_format_threads = git_config_int(var, value);
+		if (log_format_threads < 0)
+			die(_("invalid number of threads specified (%d) for %s"),
+			    log_format_threads, var);
+		if (!HAVE_THREADS && log_format_threads != 1) {
+			warning(_("no threads support, ignoring %s"), var);
+			log_format_threads = 1;
+		}
+		return 0;
+	}
 
 	return git_diff_ui_config(var, value, cb);
 }
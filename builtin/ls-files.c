@@ -11,6 +11,7 @@
 #include "convert.h"
 #include "quote.h"
 #include "dir.h"
+#include "environment.h"
 #include "builtin.h"
 #include "gettext.h"
 #include "object-name.h"
@@ -468,6 +469,80 @@ static void show_files(struct repository *repo, struct dir_struct *dir)
 	strbuf_release(&fullname);
 }
 
+/*
+ * Whether the cached files to show can be read one at a time from the
+ * index file, instead of reading the whole index first.
+ */
+static int can_iterate_index(struct dir_struct *dir)
+{
+	if (show_others || show_killed || show_deleted || show_modified ||
+	    (dir->flags & DIR_SHOW_IGNORED))
+		return 0;
+	/* these need the rest of the index, or its extensions */
+	if (recurse_submodules || with_tree || show_resolve_undo ||
+	    show_sparse_dirs || show_fsmonitor_bit || show_eol ||
+	    (format && strstr(format, "%(eol")) ||
+	    (pathspec.magic & PATHSPEC_ATTR))
+		return 0;
+	/* reading the index may clear SKIP_WORKTREE on present files */
+	if (core_apply_sparse_checkout &&
+	    !sparse_expect_files_outside_of_patterns)
+		return 0;
+	return 1;
+}
+
+/*
+ * The same as show_files() for cached files only, reading the entries
+ * from "iter" instead of the index. Returns -1 if an entry turns out to
+ * be malformed, with "*nr_read" set to the number of entries before it.
+ */
+static int show_files_from_iter(struct repository *repo,
+				struct dir_struct *dir,
+				struct index_entry_iter *iter,
+				const char *max_prefix,
+				unsigned int *nr_read)
+{
+	const struct cache_entry *ce;
+	struct strbuf fullname = STRBUF_INIT;
+	struct strbuf shown = STRBUF_INIT;
+	int have_shown = 0, ret = 0;
+
+	while ((ce = index_entry_iter_next(iter))) {
+		if (max_prefix_len &&
+		    strncmp(ce->name, max_prefix, max_prefix_len)) {
+			/* the entries are sorted, so we are done past it */
+			if (strcmp(ce->name, max_prefix) > 0)
+				break;
+			continue;
+		}
+		if (show_unmerged && !ce_stage(ce))
+			continue;
+		if (skipping_duplicates && have_shown &&
+		    !strcmp(ce->name, shown.buf))
+			continue;
+
+		construct_fullname(&fullname, repo, ce);
+		show_ce(repo, dir, ce, fullname.buf,
+			ce_stage(ce) ? tag_unmerged :
+			(ce_skip_worktree(ce) ? tag_skip_worktree :
+			 tag_cached));
+		if (skipping_duplicates) {
+			strbuf_reset(&shown);
+			strbuf_addstr(&shown, ce->name);
+			have_shown = 1;
+		}
+	}
+
+	if (iter->malformed) {
+		*nr_read = iter->pos;
+		ret = -1;
+	}
+	index_entry_iter_release(iter);
+	strbuf_release(&shown);
+	strbuf_release(&fullname);
+	return ret;
+}
+
 /*
  * Prune the index to only contain stuff starting with "prefix"
  */
@@ -702,6 +777,8 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 {
 	int require_work_tree = 0, show_tag = 0, i;
 	char *max_prefix;
+	struct index_entry_iter iter;
+	int iterate_index = 0;
 	struct dir_struct dir = DIR_INIT;
 	struct pattern_list *pl;
 	struct string_list exclude_list = STRING_LIST_INIT_NODUP;
@@ -786,9 +863,6 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 		prefix_len = strlen(prefix);
 	git_config(git_default_config, NULL);
 
-	if (repo_read_index(the_repository) < 0)
-		die("index file corrupt");
-
 	argc = parse_options(argc, argv, prefix, builtin_ls_files_options,
 			ls_files_usage, 0);
 	pl = add_pattern_list(&dir, EXC_CMDL, "--exclude option");
@@ -855,7 +929,14 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 		max_prefix = common_prefix(&pathspec);
 	max_prefix_len = get_common_prefix_len(max_prefix);
 
-	prune_index(the_repository->index, max_prefix, max_prefix_len);
+	if (!can_iterate_index(&dir) ||
+	    index_entry_iter_init(&iter, the_repository->index_file)) {
+		if (repo_read_index(the_repository) < 0)
+			die("index file corrupt");
+		prune_index(the_repository->index, max_prefix, max_prefix_len);
+	} else {
+		iterate_index = 1;
+	}
 
 	/* Treat unmatching pathspec elements as errors */
 	if (pathspec.nr && error_unmatch)
@@ -882,7 +963,31 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 		overlay_tree_on_index(the_repository->index, with_tree, max_prefix);
 	}
 
-	show_files(the_repository, &dir);
+	if (iterate_index) {
+		unsigned int nr_read;
+
+		if (show_files_from_iter(the_repository, &dir, &iter,
+					 max_prefix, &nr_read) < 0) {
+			struct index_state *istate = the_repository->index;
+
+			/*
+			 * Let reading the index the usual way report what
+			 * is wrong with it, or show what comes after the
+			 * entries already shown if it can be read after all.
+			 */
+			if (repo_read_index(the_repository) < 0)
+				die("index file corrupt");
+			if (nr_read > istate->cache_nr)
+				nr_read = istate->cache_nr;
+			MOVE_ARRAY(istate->cache, istate->cache + nr_read,
+				   istate->cache_nr - nr_read);
+			istate->cache_nr -= nr_read;
+			prune_index(istate, max_prefix, max_prefix_len);
+			show_files(the_repository, &dir);
+		}
+	} else {
+		show_files(the_repository, &dir);
+	}
 
 	if (show_resolve_undo)
 		show_ru_info(the_repository->index);
@@ -217,6 +217,7 @@ static int window = 10;
 static unsigned long pack_size_limit;
 static int depth = 50;
 static int delta_search_threads;
+static int enumeration_threads = 1;
 static int pack_to_stdout;
 static int sparse;
 static int thin;
@@ -1509,15 +1510,23 @@ static int want_object_in_pack(const struct object_id *oid,
 		}
 	}
 
+	/*
+	 * The threads reading trees ahead of the walk reorder the list
+	 * in find_pack_entry(), see traverse_commit_list().
+	 */
+	packed_git_lock();
 	list_for_each(pos, get_packed_git_mru(the_repository)) {
 		struct packed_git *p = list_entry(pos, struct packed_git, mru);
 		want = want_object_in_pack_one(p, oid, exclude, found_pack, found_offset);
 		if (!exclude && want > 0)
 			list_move(&p->mru,
 				  get_packed_git_mru(the_repository));
-		if (want != -1)
+		if (want != -1) {
+			packed_git_unlock();
 			return want;
+		}
 	}
+	packed_git_unlock();
 
 	if (uri_protocols.nr) {
 		struct configured_exclusion *ex =
@@ -3171,6 +3180,13 @@ static int git_pack_config(const char *k, const char *v, void *cb)
 			write_bitmap_options &= ~BITMAP_OPT_LOOKUP_TABLE;
 	}
 
+	if (!strcmp(k, "pack.writebitmaproaring")) {
+		if (git_config_bool(k, v))
+			write_bitmap_options |= BITMAP_OPT_ROARING;
+		else
+			write_bitmap_options &= ~BITMAP_OPT_ROARING;
+	}
+
 	if (!strcmp(k, "pack.usebitmaps")) {
 		use_bitmap_index_default = git_config_bool(k, v);
 		return 0;
@@ -3190,6 +3206,17 @@ static int git_pack_config(const char *k, const char *v, void *cb)
 		}
 		return 0;
 	}
+	if (!strcmp(k, "pack.enumerationthreads")) {
+		enumeration_threads = git_config_int(k, v);
+		if (enumeration_threads < 0)
+			die(_("invalid number of threads specified (%d)"),
+			    enumeration_threads);
+		if (!HAVE_THREADS && enumeration_threads != 1) {
+			warning(_("no threads support, ignoring %s"), k);
+			enumeration_threads = 1;
+		}
+		return 0;
+	}
 	if (!strcmp(k, "pack.indexversion")) {
 		pack_idx_opts.version = git_config_int(k, v);
 		if (pack_idx_opts.version > 2)
@@ -4067,9 +4094,11 @@ static void get_object_list(struct rev_info *revs, int ac, const char **av)
 
 	if (!fn_show_object)
 		fn_show_object = show_object;
+	revs->traverse_threads = enumeration_threads;
 	traverse_commit_list(revs,
 			     show_commit, fn_show_object,
 			     NULL);
+	revs->traverse_threads = 0;
 
 	if (unpack_unreachable_expiration) {
 		revs->ignore_missing_links = 1;
@@ -4368,6 +4397,8 @@ int cmd_pack_objects(int argc, const char **argv, const char *prefix)
 
 	if (!delta_search_threads)	/* --threads=0 means autodetect */
 		delta_search_threads = online_cpus();
+	if (!enumeration_threads)
+		enumeration_threads = online_cpus();
 
 	if (!HAVE_THREADS && delta_search_threads != 1)
 		warning(_("no threads support, ignoring --threads"));
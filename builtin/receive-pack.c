@@ -76,6 +76,7 @@ static int quiet;
 static int prefer_ofs_delta = 1;
 static int auto_update_server_info;
 static int auto_gc = 1;
+static int write_commit_graph;
 static int reject_thin;
 static int stateless_rpc;
 static const char *service_dir;
@@ -220,6 +221,11 @@ static int receive_pack_config(const char *var, const char *value, void *cb)
 		return 0;
 	}
 
+	if (strcmp(var, "receive.writecommitgraph") == 0) {
+		write_commit_graph = git_config_bool(var, value);
+		return 0;
+	}
+
 	if (strcmp(var, "receive.shallowupdate") == 0) {
 		shallow_update = git_config_bool(var, value);
 		return 0;
@@ -2485,6 +2491,50 @@ static int delete_only(struct command *commands)
 	return 1;
 }
 
+/*
+ * Add a layer for the commits that the successful updates brought in
+ * on top of the commit-graph chain. This runs in a child process, so
+ * that failing to take the commit-graph lock while another process
+ * writes it does not fail the push.
+ */
+static void write_commit_graph_for_commands(struct command *commands)
+{
+	struct child_process proc = CHILD_PROCESS_INIT;
+	struct command *cmd;
+	FILE *in;
+
+	for (cmd = commands; cmd; cmd = cmd->next)
+		if (!cmd->error_string && !cmd->skip_update &&
+		    !is_null_oid(&cmd->new_oid))
+			break;
+	if (!cmd)
+		return;
+
+	proc.in = -1;
+	proc.stdout_to_stderr = 1;
+	proc.err = use_sideband ? -1 : 0;
+	proc.git_cmd = 1;
+	strvec_pushl(&proc.args, "commit-graph", "write", "--split",
+		     "--stdin-commits", "--no-progress", NULL);
+	if (start_command(&proc))
+		return;
+
+	/*
+	 * "--stdin-commits" peels tags and skips objects that are not
+	 * commits, so a pushed annotated tag brings in its commit.
+	 */
+	in = xfdopen(proc.in, "w");
+	for (; cmd; cmd = cmd->next)
+		if (!cmd->error_string && !cmd->skip_update &&
+		    !is_null_oid(&cmd->new_oid))
+			fprintf(in, "%s\n", oid_to_hex(&cmd->new_oid));
+	fclose(in);
+
+	if (use_sideband)
+		copy_to_sideband(proc.err, -1, NULL);
+	finish_command(&proc);
+}
+
 int cmd_receive_pack(int argc, const char **argv, const char *prefix)
 {
 	int advertise_refs = 0;
@@ -2589,6 +2639,8 @@ int cmd_receive_pack(int argc, const char **argv, const char *prefix)
 		else if (report_status)
 			report(commands, unpack_status);
 		sigchain_pop(SIGPIPE);
+		if (write_commit_graph)
+			write_commit_graph_for_commands(commands);
 		run_receive_hook(commands, "post-receive", 1,
 				 &push_options);
 		run_update_post_hook(commands);
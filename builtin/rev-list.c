@@ -1,6 +1,7 @@
 #include "cache.h"
 #include "config.h"
 #include "commit.h"
+#include "commit-graph.h"
 #include "diff.h"
 #include "environment.h"
 #include "gettext.h"
@@ -417,6 +418,54 @@ static inline int parse_missing_action_value(const char *value)
 	return 0;
 }
 
+static void show_graph_commit(struct commit_graph *g, uint32_t pos, void *data)
+{
+	struct rev_list_info *info = data;
+	struct rev_info *revs = info->revs;
+	struct object_id oid;
+
+	display_progress(progress, ++progress_counter);
+
+	if (info->flags & REV_LIST_QUIET)
+		return;
+	if (revs->count) {
+		revs->count_right++;
+		return;
+	}
+
+	if (info->show_timestamp)
+		printf("%"PRItime" ", commit_graph_pos_date(g, pos));
+	commit_graph_pos_oid(g, pos, &oid);
+	fputs(oid_to_hex(&oid), stdout);
+	if (revs->print_parents) {
+		static uint32_t *parents;
+		static size_t alloc;
+		size_t i, nr = commit_graph_pos_parents(g, pos, &parents, &alloc);
+
+		for (i = 0; i < nr; i++) {
+			commit_graph_pos_oid(g, parents[i], &oid);
+			printf(" %s", oid_to_hex(&oid));
+		}
+	}
+	putchar('\n');
+	maybe_flush_or_die(stdout, "stdout");
+}
+
+/*
+ * Walk the commit-graph by position when the output only needs what
+ * it stores: the commit ids, their parents and dates, or a count.
+ */
+static int try_graph_walk(struct rev_info *revs, struct rev_list_info *info)
+{
+	if (show_disk_usage || arg_print_omitted || arg_missing_action ||
+	    revs->commit_format != CMIT_FMT_UNSPECIFIED ||
+	    revs->verbose_header || revs->abbrev_commit ||
+	    revs->show_decorations)
+		return -1;
+
+	return walk_revisions_in_graph(revs, show_graph_commit, info);
+}
+
 static int try_bitmap_count(struct rev_info *revs,
 			    int filter_provided_objects)
 {
@@ -716,6 +765,9 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 			goto cleanup;
 	}
 
+	if (!try_graph_walk(&revs, &info))
+		goto walked;
+
 	if (prepare_revision_walk(&revs))
 		die("revision walk setup failed");
 	if (revs.tree_objects)
@@ -775,6 +827,7 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 		oidset_clear(&missing_objects);
 	}
 
+walked:
 	stop_progress(&progress);
 
 	if (revs.count) {
@@ -372,6 +372,39 @@ int read_index_from(struct index_state *, const char *path,
 		    const char *gitdir);
 int is_index_unborn(struct index_state *);
 
+/*
+ * Iterate over the entries of the index file at `path` without reading
+ * it in core: each entry is decoded from the mapped file when it is
+ * returned by index_entry_iter_next(), into a cache_entry that is only
+ * valid until the next call. This is meant for commands that merely
+ * list the entries, and avoids allocating all of them and parsing the
+ * extensions.
+ *
+ * index_entry_iter_init() returns -1 if the index cannot be iterated
+ * over this way: if it does not exist or is invalid, if it is a split
+ * or sparse index, or if it has an extension that must be understood.
+ * Callers should then fall back to read_index_from(), which reports
+ * errors.
+ *
+ * index_entry_iter_next() returns NULL after the last entry, or when
+ * the next entry is malformed; "malformed" is then set, and "pos" is
+ * the number of entries returned before it.
+ */
+struct index_entry_iter {
+	const char *mmap;
+	size_t mmap_size;
+	unsigned int version;
+	unsigned int nr, pos;
+	unsigned int malformed : 1;
+	size_t offset;
+	struct cache_entry *ce;
+	size_t ce_alloc;
+};
+
+int index_entry_iter_init(struct index_entry_iter *iter, const char *path);
+const struct cache_entry *index_entry_iter_next(struct index_entry_iter *iter);
+void index_entry_iter_release(struct index_entry_iter *iter);
+
 void ensure_full_index(struct index_state *istate);
 
 /* For use with `write_locked_index()`. */
@@ -611,6 +644,7 @@ int has_symlink_leading_path(const char *name, int len);
 int threaded_has_symlink_leading_path(struct cache_def *, const char *, int);
 int check_leading_path(const char *name, int len, int warn_on_lstat_err);
 int has_dirs_only_path(const char *name, int len, int prefix_len);
+int threaded_has_dirs_only_path(struct cache_def *, const char *name, int len, int prefix_len);
 void invalidate_lstat_cache(void);
 void schedule_dir_for_removal(const char *name, int len);
 void remove_scheduled_dirs(void);
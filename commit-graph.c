@@ -24,6 +24,7 @@
 #include "json-writer.h"
 #include "trace2.h"
 #include "chunk-format.h"
+#include "thread-utils.h"
 #include "wrapper.h"
 
 void git_test_write_commit_graph_or_die(void)
@@ -899,6 +900,96 @@ int repo_find_commit_pos_in_graph(struct repository *r, struct commit *c,
 	return find_commit_pos_in_graph(c, r->objects->commit_graph, pos);
 }
 
+struct commit_graph *repo_commit_graph(struct repository *r)
+{
+	if (!prepare_commit_graph(r))
+		return NULL;
+	return r->objects->commit_graph;
+}
+
+uint32_t commit_graph_nr_commits(struct commit_graph *g)
+{
+	return g->num_commits + g->num_commits_in_base;
+}
+
+int commit_graph_find_pos(struct commit_graph *g, const struct object_id *oid,
+			  uint32_t *pos)
+{
+	return search_commit_pos_in_graph(oid, g, pos);
+}
+
+void commit_graph_pos_oid(struct commit_graph *g, uint32_t pos,
+			  struct object_id *oid)
+{
+	load_oid_from_graph(g, pos, oid);
+}
+
+static const unsigned char *commit_data_at(struct commit_graph **gp,
+					   uint32_t pos)
+{
+	struct commit_graph *g = *gp;
+
+	while (pos < g->num_commits_in_base)
+		g = g->base_graph;
+	if (pos >= g->num_commits + g->num_commits_in_base)
+		die(_("invalid commit position. commit-graph is likely corrupt"));
+	*gp = g;
+	return g->chunk_commit_data +
+		GRAPH_DATA_WIDTH * (pos - g->num_commits_in_base);
+}
+
+timestamp_t commit_graph_pos_date(struct commit_graph *g, uint32_t pos)
+{
+	const unsigned char *commit_data = commit_data_at(&g, pos);
+	uint64_t date_high, date_low;
+
+	date_high = get_be32(commit_data + g->hash_len + 8) & 0x3;
+	date_low = get_be32(commit_data + g->hash_len + 12);
+	return (timestamp_t)((date_high << 32) | date_low);
+}
+
+static void append_parent_pos(struct commit_graph *g, uint32_t pos,
+			      uint32_t **parents, size_t *nr, size_t *alloc)
+{
+	if (pos >= commit_graph_nr_commits(g))
+		die("invalid parent position %"PRIu32, pos);
+	ALLOC_GROW(*parents, *nr + 1, *alloc);
+	(*parents)[(*nr)++] = pos;
+}
+
+size_t commit_graph_pos_parents(struct commit_graph *g, uint32_t pos,
+				uint32_t **parents, size_t *alloc)
+{
+	struct commit_graph *top = g;
+	const unsigned char *commit_data = commit_data_at(&g, pos);
+	const unsigned char *extra;
+	uint32_t edge_value;
+	size_t nr = 0;
+
+	edge_value = get_be32(commit_data + g->hash_len);
+	if (edge_value == GRAPH_PARENT_NONE)
+		return 0;
+	append_parent_pos(top, edge_value, parents, &nr, alloc);
+
+	edge_value = get_be32(commit_data + g->hash_len + 4);
+	if (edge_value == GRAPH_PARENT_NONE)
+		return nr;
+	if (!(edge_value & GRAPH_EXTRA_EDGES_NEEDED)) {
+		append_parent_pos(top, edge_value, parents, &nr, alloc);
+		return nr;
+	}
+
+	extra = g->chunk_extra_edges +
+		4 * (uint64_t)(edge_value & GRAPH_EDGE_LAST_MASK);
+	do {
+		edge_value = get_be32(extra);
+		append_parent_pos(top, edge_value & GRAPH_EDGE_LAST_MASK,
+				  parents, &nr, alloc);
+		extra += 4;
+	} while (!(edge_value & GRAPH_LAST_EDGE));
+	return nr;
+}
+
 struct commit *lookup_commit_in_graph(struct repository *repo, const struct object_id *id)
 {
 	struct commit *commit;
@@ -1650,12 +1741,79 @@ static void trace2_bloom_filter_write_statistics(struct write_commit_graph_conte
 			   ctx->count_bloom_filter_trunc_large);
 }
 
+/*
+ * Unless 'commitGraph.threads' says otherwise, each thread should have
+ * at least this many filters to compute.
+ */
+#define BLOOM_FILTERS_PER_THREAD 100
+
+struct bloom_filter_work {
+	struct write_commit_graph_context *ctx;
+	struct commit **commits;
+	enum bloom_filter_computed *computed;
+	int nr;
+	int next;
+	int done;
+	struct progress *progress;
+	pthread_mutex_t mutex;
+};
+
+struct bloom_filter_thread {
+	pthread_t pthread;
+	struct bloom_filter_work *work;
+};
+
+static void *compute_bloom_filters_thread(void *data)
+{
+	struct bloom_filter_work *work = ((struct bloom_filter_thread *)data)->work;
+
+	for (;;) {
+		int i;
+
+		pthread_mutex_lock(&work->mutex);
+		i = work->next++;
+		pthread_mutex_unlock(&work->mutex);
+		if (i >= work->nr)
+			break;
+
+		compute_bloom_filter(work->ctx->r, work->commits[i],
+				     work->ctx->bloom_settings,
+				     &work->computed[i]);
+
+		pthread_mutex_lock(&work->mutex);
+		display_progress(work->progress, ++work->done);
+		pthread_mutex_unlock(&work->mutex);
+	}
+	return NULL;
+}
+
+static int bloom_filter_threads(struct write_commit_graph_context *ctx, int nr)
+{
+	int threads = 0;
+
+	if (!HAVE_THREADS)
+		return 1;
+
+	repo_config_get_int(ctx->r, "commitgraph.threads", &threads);
+	if (threads <= 0) {
+		threads = online_cpus();
+		if (threads > nr / BLOOM_FILTERS_PER_THREAD)
+			threads = nr / BLOOM_FILTERS_PER_THREAD;
+	}
+	if (threads > nr)
+		threads = nr;
+	return threads > 1 ? threads : 1;
+}
+
 static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 {
-	int i;
+	int i, threads;
 	struct progress *progress = NULL;
 	struct commit **sorted_commits;
 	int max_new_filters;
+	struct bloom_filter_work work = {
+		.ctx = ctx,
+	};
 
 	init_bloom_filters();
 
@@ -1674,31 +1832,81 @@ static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 	max_new_filters = ctx->opts && ctx->opts->max_new_filters >= 0 ?
 		ctx->opts->max_new_filters : ctx->commits.nr;
 
+	/*
+	 * Look up existing filters and parse the commits whose filters
+	 * are to be computed here, as neither the filter slab nor the
+	 * object machinery may be modified by several threads at once.
+	 * Queued commits keep the sorted order, so that '--max-new-filters'
+	 * picks the same commits as when computing them one by one.
+	 */
+	ALLOC_ARRAY(work.commits, ctx->commits.nr);
 	for (i = 0; i < ctx->commits.nr; i++) {
 		enum bloom_filter_computed computed = 0;
 		struct commit *c = sorted_commits[i];
 		struct bloom_filter *filter = get_or_compute_bloom_filter(
-			ctx->r,
-			c,
-			ctx->count_bloom_filter_computed < max_new_filters,
-			ctx->bloom_settings,
-			&computed);
-		if (computed & BLOOM_COMPUTED) {
-			ctx->count_bloom_filter_computed++;
-			if (computed & BLOOM_TRUNC_EMPTY)
-				ctx->count_bloom_filter_trunc_empty++;
-			if (computed & BLOOM_TRUNC_LARGE)
-				ctx->count_bloom_filter_trunc_large++;
-		} else if (computed & BLOOM_NOT_COMPUTED)
+			ctx->r, c, 0, ctx->bloom_settings, &computed);
+
+		if (!filter && work.nr < max_new_filters) {
+			repo_parse_commit(ctx->r, c);
+			work.commits[work.nr++] = c;
+			continue;
+		}
+
+		if (computed & BLOOM_NOT_COMPUTED)
 			ctx->count_bloom_filter_not_computed++;
 		ctx->total_bloom_filter_data_size += filter
 			? sizeof(unsigned char) * filter->len : 0;
-		display_progress(progress, i + 1);
+		display_progress(progress, ++work.done);
+	}
+	CALLOC_ARRAY(work.computed, work.nr);
+
+	threads = bloom_filter_threads(ctx, work.nr);
+	if (threads > 1) {
+		struct bloom_filter_thread *data;
+
+		CALLOC_ARRAY(data, threads);
+		work.progress = progress;
+		pthread_mutex_init(&work.mutex, NULL);
+		enable_obj_read_lock();
+		for (i = 0; i < threads; i++) {
+			data[i].work = &work;
+			if (pthread_create(&data[i].pthread, NULL,
+					   compute_bloom_filters_thread, &data[i]))
+				die(_("unable to create bloom filter thread"));
+		}
+		for (i = 0; i < threads; i++)
+			if (pthread_join(data[i].pthread, NULL))
+				die(_("unable to join bloom filter thread"));
+		disable_obj_read_lock();
+		pthread_mutex_destroy(&work.mutex);
+		free(data);
+	} else {
+		for (i = 0; i < work.nr; i++) {
+			compute_bloom_filter(ctx->r, work.commits[i],
+					     ctx->bloom_settings,
+					     &work.computed[i]);
+			display_progress(progress, ++work.done);
+		}
+	}
+
+	for (i = 0; i < work.nr; i++) {
+		struct bloom_filter *filter =
+			get_bloom_filter(ctx->r, work.commits[i]);
+
+		ctx->count_bloom_filter_computed++;
+		if (work.computed[i] & BLOOM_TRUNC_EMPTY)
+			ctx->count_bloom_filter_trunc_empty++;
+		if (work.computed[i] & BLOOM_TRUNC_LARGE)
+			ctx->count_bloom_filter_trunc_large++;
+		ctx->total_bloom_filter_data_size +=
+			sizeof(unsigned char) * filter->len;
 	}
 
 	if (trace2_is_enabled())
 		trace2_bloom_filter_write_statistics(ctx);
 
+	free(work.commits);
+	free(work.computed);
 	free(sorted_commits);
 	stop_progress(&progress);
 }
@@ -2084,11 +2292,15 @@ static void split_graph_merge_strategy(struct write_commit_graph_context *ctx)
 	uint32_t i;
 
 	int max_commits = 0;
+	int max_layers = ctx->r->settings.commit_graph_max_layers;
 	int size_mult = 2;
 
 	if (ctx->opts) {
 		max_commits = ctx->opts->max_commits;
 
+		if (ctx->opts->max_layers >= 0)
+			max_layers = ctx->opts->max_layers;
+
 		if (ctx->opts->size_multiple)
 			size_mult = ctx->opts->size_multiple;
 
@@ -2105,7 +2317,9 @@ static void split_graph_merge_strategy(struct write_commit_graph_context *ctx)
 	if (flags != COMMIT_GRAPH_SPLIT_MERGE_PROHIBITED &&
 	    flags != COMMIT_GRAPH_SPLIT_REPLACE) {
 		while (g && (g->num_commits <= size_mult * num_commits ||
-			    (max_commits && num_commits > max_commits))) {
+			    (max_commits && num_commits > max_commits) ||
+			    (max_layers > 0 &&
+			     ctx->num_commit_graphs_after > max_layers))) {
 			if (g->odb != ctx->odb)
 				break;
 
@@ -2471,10 +2685,16 @@ int write_commit_graph(struct object_directory *odb,
 		goto cleanup;
 
 	if (ctx->split) {
+		trace2_data_intmax("commit-graph", ctx->r, "split/new-commits",
+				   ctx->commits.nr);
 		split_graph_merge_strategy(ctx);
 
 		if (!replace)
 			merge_commit_graphs(ctx);
+		trace2_data_intmax("commit-graph", ctx->r, "split/layers-before",
+				   ctx->num_commit_graphs_before);
+		trace2_data_intmax("commit-graph", ctx->r, "split/layers-after",
+				   ctx->num_commit_graphs_after);
 	} else
 		ctx->num_commit_graphs_after = 1;
 
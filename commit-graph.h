@@ -54,6 +54,29 @@ int parse_commit_in_graph(struct repository *r, struct commit *item);
 int repo_find_commit_pos_in_graph(struct repository *r, struct commit *c,
 				  uint32_t *pos);
 
+/*
+ * Helpers for walking the commit-graph by position, without creating a
+ * "struct commit" for each commit visited. Positions run from 0 to
+ * commit_graph_nr_commits() - 1 across all layers of the chain.
+ *
+ * repo_commit_graph() loads the commit-graph of `r` if needed and
+ * returns its top layer, or NULL if there is none or it cannot be used.
+ */
+struct commit_graph *repo_commit_graph(struct repository *r);
+uint32_t commit_graph_nr_commits(struct commit_graph *g);
+int commit_graph_find_pos(struct commit_graph *g, const struct object_id *oid,
+			  uint32_t *pos);
+void commit_graph_pos_oid(struct commit_graph *g, uint32_t pos,
+			  struct object_id *oid);
+timestamp_t commit_graph_pos_date(struct commit_graph *g, uint32_t pos);
+
+/*
+ * Store the positions of the parents of the commit at `pos` in
+ * `*parents`, growing it as needed, and return how many there are.
+ */
+size_t commit_graph_pos_parents(struct commit_graph *g, uint32_t pos,
+				uint32_t **parents, size_t *alloc);
+
 /*
  * Look up the given commit ID in the commit-graph. This will only return a
  * commit if the ID exists both in the graph and in the object database such
@@ -146,6 +169,7 @@ enum commit_graph_split_flags {
 struct commit_graph_opts {
 	int size_multiple;
 	int max_commits;
+	int max_layers;
 	timestamp_t expire_time;
 	enum commit_graph_split_flags split_flags;
 	int max_new_filters;
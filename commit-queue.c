@@ -0,0 +1,95 @@
+#include "git-compat-util.h"
+#include "alloc.h"
+#include "commit.h"
+#include "commit-graph.h"
+#include "commit-queue.h"
+
+#define COMMIT_QUEUE_ARITY 4
+
+/* Whether "a" should be returned before "b" */
+static inline int newer(const struct commit_queue_entry *a,
+			const struct commit_queue_entry *b)
+{
+	if (a->generation != b->generation)
+		return a->generation > b->generation;
+	if (a->date != b->date)
+		return a->date > b->date;
+	return (int)(a->ctr - b->ctr) < 0;
+}
+
+void clear_commit_queue(struct commit_queue *queue)
+{
+	FREE_AND_NULL(queue->array);
+	queue->nr = 0;
+	queue->alloc = 0;
+	queue->insertion_ctr = 0;
+}
+
+void commit_queue_put(struct commit_queue *queue, struct commit *commit)
+{
+	struct commit_queue_entry entry;
+	int ix, parent;
+
+	entry.generation = queue->by_generation ?
+		commit_graph_generation(commit) : 0;
+	entry.date = commit->date;
+	entry.ctr = queue->insertion_ctr++;
+	entry.commit = commit;
+
+	ALLOC_GROW(queue->array, queue->nr + 1, queue->alloc);
+
+	/* Move the hole at the end up until the new entry fits in it */
+	for (ix = queue->nr++; ix; ix = parent) {
+		parent = (ix - 1) / COMMIT_QUEUE_ARITY;
+		if (!newer(&entry, &queue->array[parent]))
+			break;
+		queue->array[ix] = queue->array[parent];
+	}
+	queue->array[ix] = entry;
+}
+
+struct commit *commit_queue_get(struct commit_queue *queue)
+{
+	struct commit *result;
+	struct commit_queue_entry *last;
+	int ix, child;
+
+	if (!queue->nr)
+		return NULL;
+
+	result = queue->array[0].commit;
+	if (!--queue->nr)
+		return result;
+
+	/* Move the hole at the root down until the last entry fits in it */
+	last = &queue->array[queue->nr];
+	for (ix = 0; (child = ix * COMMIT_QUEUE_ARITY + 1) < queue->nr; ix = child) {
+		int i, end = child + COMMIT_QUEUE_ARITY;
+
+		if (end > queue->nr)
+			end = queue->nr;
+		for (i = child + 1; i < end; i++)
+			if (newer(&queue->array[i], &queue->array[child]))
+				child = i;
+
+		if (!newer(&queue->array[child], last))
+			break;
+		queue->array[ix] = queue->array[child];
+	}
+	queue->array[ix] = *last;
+	return result;
+}
+
+struct commit *commit_queue_peek(struct commit_queue *queue)
+{
+	if (!queue->nr)
+		return NULL;
+	return queue->array[0].commit;
+}
+
+timestamp_t commit_queue_peek_generation(struct commit_queue *queue)
+{
+	if (!queue->nr)
+		return 0;
+	return queue->array[0].generation;
+}
@@ -0,0 +1,67 @@
+#ifndef COMMIT_QUEUE_H
+#define COMMIT_QUEUE_H
+
+struct commit;
+
+/*
+ * A priority queue of commits, returning the newest commit first.
+ *
+ * Unlike a "struct prio_queue" using compare_commits_by_commit_date()
+ * or compare_commits_by_gen_then_commit_date(), the keys a commit is
+ * sorted by are read once, when it is put in the queue, and stored
+ * next to it. The heap is 4-ary, so that the children of an entry
+ * share as few cache lines as possible and the heap is shallower.
+ *
+ * As the keys are not read again, a commit must be parsed before it
+ * is put in the queue; an unparsed commit sorts as if it had an
+ * infinite generation number and a zero date. Commits with equal keys
+ * are returned in the order they were put in the queue.
+ */
+
+struct commit_queue_entry {
+	timestamp_t generation;
+	timestamp_t date;
+	unsigned ctr;
+	struct commit *commit;
+};
+
+struct commit_queue {
+	/*
+	 * Compare generation numbers first, and commit dates only
+	 * between commits of the same generation. Otherwise, only
+	 * commit dates are compared.
+	 */
+	unsigned by_generation:1;
+	unsigned insertion_ctr;
+	int alloc, nr;
+	struct commit_queue_entry *array;
+};
+
+#define COMMIT_QUEUE_INIT { 0 }
+#define COMMIT_QUEUE_BY_GENERATION_INIT { .by_generation = 1 }
+
+/*
+ * Add the commit to the queue.
+ */
+void commit_queue_put(struct commit_queue *, struct commit *);
+
+/*
+ * Extract the newest commit out of the queue, or NULL.
+ */
+struct commit *commit_queue_get(struct commit_queue *);
+
+/*
+ * Gain access to the commit that would be returned by
+ * commit_queue_get, but do not remove it from the queue.
+ */
+struct commit *commit_queue_peek(struct commit_queue *);
+
+/*
+ * The generation number that the commit commit_queue_peek() would
+ * return was queued with, or 0 if the queue is empty.
+ */
+timestamp_t commit_queue_peek_generation(struct commit_queue *);
+
+void clear_commit_queue(struct commit_queue *);
+
+#endif /* COMMIT_QUEUE_H */
@@ -4,13 +4,14 @@
 #include "commit-graph.h"
 #include "decorate.h"
 #include "hex.h"
-#include "prio-queue.h"
+#include "commit-queue.h"
 #include "tree.h"
 #include "ref-filter.h"
 #include "revision.h"
 #include "tag.h"
 #include "commit-reach.h"
 #include "ewah/ewok.h"
+#include "pack-bitmap.h"
 
 /* Remember to update object flag allocation in object.h */
 #define PARENT1		(1u<<16)
@@ -39,11 +40,11 @@ static int compare_commits_by_gen(const void *_a, const void *_b)
 	return 0;
 }
 
-static int queue_has_nonstale(struct prio_queue *queue)
+static int queue_has_nonstale(struct commit_queue *queue)
 {
 	int i;
 	for (i = 0; i < queue->nr; i++) {
-		struct commit *commit = queue->array[i].data;
+		struct commit *commit = queue->array[i].commit;
 		if (!(commit->object.flags & STALE))
 			return 1;
 	}
@@ -56,28 +57,28 @@ static struct commit_list *paint_down_to_common(struct repository *r,
 						struct commit **twos,
 						timestamp_t min_generation)
 {
-	struct prio_queue queue = { compare_commits_by_gen_then_commit_date };
+	struct commit_queue queue = COMMIT_QUEUE_BY_GENERATION_INIT;
 	struct commit_list *result = NULL;
 	int i;
 	timestamp_t last_gen = GENERATION_NUMBER_INFINITY;
 
 	if (!min_generation && !corrected_commit_dates_enabled(r))
-		queue.compare = compare_commits_by_commit_date;
+		queue.by_generation = 0;
 
 	one->object.flags |= PARENT1;
 	if (!n) {
 		commit_list_append(one, &result);
 		return result;
 	}
-	prio_queue_put(&queue, one);
+	commit_queue_put(&queue, one);
 
 	for (i = 0; i < n; i++) {
 		twos[i]->object.flags |= PARENT2;
-		prio_queue_put(&queue, twos[i]);
+		commit_queue_put(&queue, twos[i]);
 	}
 
 	while (queue_has_nonstale(&queue)) {
-		struct commit *commit = prio_queue_get(&queue);
+		struct commit *commit = commit_queue_get(&queue);
 		struct commit_list *parents;
 		int flags;
 		timestamp_t generation = commit_graph_generation(commit);
@@ -109,11 +110,11 @@ static struct commit_list *paint_down_to_common(struct repository *r,
 			if (repo_parse_commit(r, p))
 				return NULL;
 			p->object.flags |= flags;
-			prio_queue_put(&queue, p);
+			commit_queue_put(&queue, p);
 		}
 	}
 
-	clear_prio_queue(&queue);
+	clear_commit_queue(&queue);
 	return result;
 }
 
@@ -719,6 +720,22 @@ int commit_contains(struct ref_filter *filter, struct commit *commit,
 	return repo_is_descendant_of(the_repository, commit, list);
 }
 
+void commit_contains_many(struct ref_filter *filter,
+			  struct commit **commits, size_t commits_nr,
+			  struct commit_list *list, unsigned char *result)
+{
+	struct contains_cache cache;
+
+	if (!bitmap_tips_reach_any(the_repository, commits, commits_nr,
+				   list, result))
+		return;
+
+	init_contains_cache(&cache);
+	for (size_t i = 0; i < commits_nr; i++)
+		result[i] = commit_contains(filter, commits[i], list, &cache);
+	clear_contains_cache(&cache);
+}
+
 int can_all_from_reach_with_flag(struct object_array *from,
 				 unsigned int with_flag,
 				 unsigned int assign_flag,
@@ -891,7 +908,7 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 	timestamp_t min_generation = GENERATION_NUMBER_INFINITY;
 	int num_to_find = 0;
 
-	struct prio_queue queue = { compare_commits_by_gen_then_commit_date };
+	struct commit_queue queue = COMMIT_QUEUE_BY_GENERATION_INIT;
 
 	for (item = to; item < to_last; item++) {
 		timestamp_t generation;
@@ -914,11 +931,11 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 			c->object.flags |= PARENT2;
 			repo_parse_commit(the_repository, c);
 
-			prio_queue_put(&queue, *item);
+			commit_queue_put(&queue, *item);
 		}
 	}
 
-	while (num_to_find && (current = prio_queue_get(&queue)) != NULL) {
+	while (num_to_find && (current = commit_queue_get(&queue)) != NULL) {
 		struct commit_list *parents;
 
 		if (current->object.flags & PARENT1) {
@@ -940,7 +957,7 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 				continue;
 
 			p->object.flags |= PARENT2;
-			prio_queue_put(&queue, p);
+			commit_queue_put(&queue, p);
 		}
 	}
 
@@ -953,11 +970,11 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 define_commit_slab(bit_arrays, struct bitmap *);
 static struct bit_arrays bit_arrays;
 
-static void insert_no_dup(struct prio_queue *queue, struct commit *c)
+static void insert_no_dup(struct commit_queue *queue, struct commit *c)
 {
 	if (c->object.flags & PARENT2)
 		return;
-	prio_queue_put(queue, c);
+	commit_queue_put(queue, c);
 	c->object.flags |= PARENT2;
 }
 
@@ -982,12 +999,15 @@ void ahead_behind(struct repository *r,
 		  struct commit **commits, size_t commits_nr,
 		  struct ahead_behind_count *counts, size_t counts_nr)
 {
-	struct prio_queue queue = { .compare = compare_commits_by_gen_then_commit_date };
+	struct commit_queue queue = COMMIT_QUEUE_BY_GENERATION_INIT;
 	size_t width = DIV_ROUND_UP(commits_nr, BITS_IN_EWORD);
 
 	if (!commits_nr || !counts_nr)
 		return;
 
+	if (!bitmap_ahead_behind(r, commits, commits_nr, counts, counts_nr))
+		return;
+
 	for (size_t i = 0; i < counts_nr; i++) {
 		counts[i].ahead = 0;
 		counts[i].behind = 0;
@@ -1006,7 +1026,7 @@ void ahead_behind(struct repository *r,
 	}
 
 	while (queue_has_nonstale(&queue)) {
-		struct commit *c = prio_queue_get(&queue);
+		struct commit *c = commit_queue_get(&queue);
 		struct commit_list *p;
 		struct bitmap *bitmap_c = get_bit_array(c, width);
 
@@ -1049,7 +1069,7 @@ void ahead_behind(struct repository *r,
 	/* STALE is used here, PARENT2 is used by insert_no_dup(). */
 	repo_clear_commit_marks(r, PARENT2 | STALE);
 	clear_bit_arrays(&bit_arrays);
-	clear_prio_queue(&queue);
+	clear_commit_queue(&queue);
 }
 
 struct commit_and_index {
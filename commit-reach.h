@@ -67,6 +67,14 @@ define_commit_slab(contains_cache, enum contains_result);
 int commit_contains(struct ref_filter *filter, struct commit *commit,
 		    struct commit_list *list, struct contains_cache *cache);
 
+/*
+ * Set result[i] to commit_contains() for each of "commits", using
+ * reachability bitmaps where possible.
+ */
+void commit_contains_many(struct ref_filter *filter,
+			  struct commit **commits, size_t commits_nr,
+			  struct commit_list *list, unsigned char *result);
+
 /*
  * Determine if every commit in 'from' can reach at least one commit
  * that is marked with 'with_flag'. As we traverse, use 'assign_flag'
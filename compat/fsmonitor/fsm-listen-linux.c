@@ -0,0 +1,665 @@
+#include "cache.h"
+#include "alloc.h"
+#include "config.h"
+#include "fsmonitor.h"
+#include "fsm-listen.h"
+#include "fsmonitor--daemon.h"
+#include "gettext.h"
+#include "hashmap.h"
+#include "trace2.h"
+#include <sys/inotify.h>
+#include <poll.h>
+
+/*
+ * inotify(7) is not recursive, so we have to place a watch on every
+ * directory in the working directory and keep that set of watches up
+ * to date as directories are created, deleted, and renamed.
+ *
+ * Each watch is identified by a "watch descriptor" (wd) and all events
+ * are reported relative to the directory of that watch, so we keep a
+ * map from wd to the absolute pathname of the watched directory.
+ *
+ * We do not recursively watch the .git directory (or an external
+ * gitdir).  We only need to know if it is deleted or renamed away and
+ * when cookie files are created, so we place a (non-recursive) watch
+ * on the gitdir itself and on the cookie directory.
+ */
+
+#define WATCH_MASK_WORKTREE (IN_MODIFY | IN_ATTRIB | IN_CREATE | \
+			     IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+			     IN_DELETE_SELF | IN_MOVE_SELF | \
+			     IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+#define WATCH_MASK_GITDIR (IN_DELETE_SELF | IN_MOVE_SELF | \
+			   IN_ONLYDIR | IN_DONT_FOLLOW)
+
+#define WATCH_MASK_COOKIES (IN_CREATE | IN_MOVED_TO | \
+			    IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+/*
+ * The kernel returns variable-length `struct inotify_event` records.
+ * Read as many of them as we can in one read(2) to avoid falling
+ * behind (and overflowing the kernel queue) during bursts of activity.
+ */
+#define EVENT_BUF_SIZE (64 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+
+enum watch_kind {
+	WATCH_WORKTREE_DIR = 0,
+	WATCH_WORKTREE_ROOT,
+	WATCH_GITDIR,
+	WATCH_COOKIE_DIR,
+};
+
+struct watch_entry {
+	struct hashmap_entry ent; /* keyed by wd */
+	int wd;
+	enum watch_kind kind;
+	char *path; /* absolute path of the watched directory */
+};
+
+struct fsm_listen_data
+{
+	int fd_inotify;
+	int fd_shutdown[2]; /* pipe to wake up the listener */
+
+	struct hashmap watches; /* of struct watch_entry */
+
+	enum shutdown_style {
+		SHUTDOWN_EVENT = 0,
+		FORCE_SHUTDOWN,
+		FORCE_ERROR_STOP,
+	} shutdown_style;
+};
+
+static int watch_entry_cmp(const void *cmp_data UNUSED,
+			   const struct hashmap_entry *eptr,
+			   const struct hashmap_entry *entry_or_key,
+			   const void *keydata UNUSED)
+{
+	const struct watch_entry *a, *b;
+
+	a = container_of(eptr, const struct watch_entry, ent);
+	b = container_of(entry_or_key, const struct watch_entry, ent);
+
+	return a->wd != b->wd;
+}
+
+static struct watch_entry *find_watch(struct fsm_listen_data *data, int wd)
+{
+	struct watch_entry key;
+
+	hashmap_entry_init(&key.ent, memhash(&wd, sizeof(wd)));
+	key.wd = wd;
+
+	return hashmap_get_entry(&data->watches, &key, ent, NULL);
+}
+
+static void free_watch(struct watch_entry *w)
+{
+	if (!w)
+		return;
+	free(w->path);
+	free(w);
+}
+
+static void forget_watch(struct fsm_listen_data *data, int wd)
+{
+	struct watch_entry key;
+	struct watch_entry *w;
+
+	hashmap_entry_init(&key.ent, memhash(&wd, sizeof(wd)));
+	key.wd = wd;
+
+	w = hashmap_remove_entry(&data->watches, &key, ent, NULL);
+	free_watch(w);
+}
+
+static void report_watch_limit(const char *path)
+{
+	error(_("inotify watch limit reached while watching '%s'"), path);
+	error(_("consider raising /proc/sys/fs/inotify/max_user_watches"));
+}
+
+/*
+ * Add (or update) a single watch.  Note that the kernel returns the
+ * existing watch descriptor if the inode is already being watched
+ * (for example, after a directory was renamed within the worktree),
+ * so we update the pathname of an existing entry in place.
+ *
+ * Returns 0 on success, -1 on error.  If the directory vanished
+ * before we could watch it, that is not an error (we will receive
+ * (or have received) an event for its deletion).
+ */
+static int add_watch(struct fsm_listen_data *data, const char *path,
+		     enum watch_kind kind)
+{
+	uint32_t mask;
+	struct watch_entry *w;
+	int wd;
+
+	switch (kind) {
+	case WATCH_GITDIR:
+		mask = WATCH_MASK_GITDIR;
+		break;
+	case WATCH_COOKIE_DIR:
+		mask = WATCH_MASK_COOKIES;
+		break;
+	default:
+		mask = WATCH_MASK_WORKTREE;
+		break;
+	}
+
+	wd = inotify_add_watch(data->fd_inotify, path, mask);
+	if (wd < 0) {
+		if (errno == ENOENT || errno == ENOTDIR)
+			return 0;
+		if (errno == ENOSPC)
+			report_watch_limit(path);
+		else
+			error_errno(_("inotify_add_watch('%s') failed"), path);
+		return -1;
+	}
+
+	w = find_watch(data, wd);
+	if (w) {
+		free(w->path);
+		w->path = xstrdup(path);
+		w->kind = kind;
+		return 0;
+	}
+
+	CALLOC_ARRAY(w, 1);
+	hashmap_entry_init(&w->ent, memhash(&wd, sizeof(wd)));
+	w->wd = wd;
+	w->kind = kind;
+	w->path = xstrdup(path);
+	hashmap_add(&data->watches, &w->ent);
+
+	return 0;
+}
+
+static int add_gitdir_watches(struct fsmonitor_daemon_state *state,
+			      const char *gitdir)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	struct strbuf cookie_dir = STRBUF_INIT;
+	int ret;
+
+	if (add_watch(data, gitdir, WATCH_GITDIR))
+		return -1;
+
+	/* `path_cookie_prefix` has a trailing slash */
+	strbuf_addbuf(&cookie_dir, &state->path_cookie_prefix);
+	strbuf_strip_suffix(&cookie_dir, "/");
+	ret = add_watch(data, cookie_dir.buf, WATCH_COOKIE_DIR);
+	strbuf_release(&cookie_dir);
+
+	return ret;
+}
+
+/*
+ * Recursively add watches on the directory `path->buf` and all of its
+ * subdirectories.  We do not descend into ".git" at the root of the
+ * worktree (see `add_gitdir_watches()`).
+ */
+static int add_watches_recursive(struct fsmonitor_daemon_state *state,
+				 struct strbuf *path, enum watch_kind kind)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	DIR *dir;
+	struct dirent *de;
+	size_t baselen;
+	int ret = 0;
+
+	if (add_watch(data, path->buf, kind))
+		return -1;
+
+	dir = opendir(path->buf);
+	if (!dir) {
+		if (errno == ENOENT || errno == ENOTDIR)
+			return 0;
+		return error_errno(_("could not open directory '%s'"),
+				   path->buf);
+	}
+
+	strbuf_addch(path, '/');
+	baselen = path->len;
+
+	while (!ret && (de = readdir(dir))) {
+		struct stat st;
+
+		if (is_dot_or_dotdot(de->d_name))
+			continue;
+
+		strbuf_setlen(path, baselen);
+		strbuf_addstr(path, de->d_name);
+
+		if (DTYPE(de) != DT_DIR) {
+			if (DTYPE(de) != DT_UNKNOWN)
+				continue;
+			if (lstat(path->buf, &st) || !S_ISDIR(st.st_mode))
+				continue;
+		}
+
+		switch (fsmonitor_classify_path_absolute(state, path->buf)) {
+		case IS_WORKDIR_PATH:
+			ret = add_watches_recursive(state, path,
+						    WATCH_WORKTREE_DIR);
+			break;
+
+		case IS_DOT_GIT:
+			ret = add_gitdir_watches(state, path->buf);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	closedir(dir);
+	strbuf_setlen(path, baselen - 1);
+	return ret;
+}
+
+/*
+ * Remove the watches on a directory (and everything below it) that
+ * was moved away.  If it was moved to somewhere else within the
+ * worktree, we will see an IN_MOVED_TO event and watch it again under
+ * its new name.
+ */
+static void remove_watches_recursive(struct fsm_listen_data *data,
+				     const char *path)
+{
+	struct hashmap_iter iter;
+	struct watch_entry *w;
+	int *doomed = NULL;
+	size_t nr = 0, alloc = 0, k;
+	size_t len = strlen(path);
+
+	hashmap_for_each_entry(&data->watches, &iter, w, ent) {
+		if (w->kind != WATCH_WORKTREE_DIR)
+			continue;
+		if (strncmp(w->path, path, len) ||
+		    (w->path[len] && w->path[len] != '/'))
+			continue;
+		ALLOC_GROW(doomed, nr + 1, alloc);
+		doomed[nr++] = w->wd;
+	}
+
+	for (k = 0; k < nr; k++) {
+		inotify_rm_watch(data->fd_inotify, doomed[k]);
+		forget_watch(data, doomed[k]);
+	}
+
+	free(doomed);
+}
+
+static void log_mask_set(const char *path, uint32_t mask)
+{
+	struct strbuf msg = STRBUF_INIT;
+
+	if (mask & IN_ACCESS)
+		strbuf_addstr(&msg, "IN_ACCESS|");
+	if (mask & IN_MODIFY)
+		strbuf_addstr(&msg, "IN_MODIFY|");
+	if (mask & IN_ATTRIB)
+		strbuf_addstr(&msg, "IN_ATTRIB|");
+	if (mask & IN_CLOSE_WRITE)
+		strbuf_addstr(&msg, "IN_CLOSE_WRITE|");
+	if (mask & IN_CLOSE_NOWRITE)
+		strbuf_addstr(&msg, "IN_CLOSE_NOWRITE|");
+	if (mask & IN_OPEN)
+		strbuf_addstr(&msg, "IN_OPEN|");
+	if (mask & IN_MOVED_FROM)
+		strbuf_addstr(&msg, "IN_MOVED_FROM|");
+	if (mask & IN_MOVED_TO)
+		strbuf_addstr(&msg, "IN_MOVED_TO|");
+	if (mask & IN_CREATE)
+		strbuf_addstr(&msg, "IN_CREATE|");
+	if (mask & IN_DELETE)
+		strbuf_addstr(&msg, "IN_DELETE|");
+	if (mask & IN_DELETE_SELF)
+		strbuf_addstr(&msg, "IN_DELETE_SELF|");
+	if (mask & IN_MOVE_SELF)
+		strbuf_addstr(&msg, "IN_MOVE_SELF|");
+	if (mask & IN_UNMOUNT)
+		strbuf_addstr(&msg, "IN_UNMOUNT|");
+	if (mask & IN_Q_OVERFLOW)
+		strbuf_addstr(&msg, "IN_Q_OVERFLOW|");
+	if (mask & IN_IGNORED)
+		strbuf_addstr(&msg, "IN_IGNORED|");
+	if (mask & IN_ISDIR)
+		strbuf_addstr(&msg, "IN_ISDIR|");
+
+	trace_printf_key(&trace_fsmonitor, "inotify: '%s', mask=0x%x %s",
+			 path, mask, msg.buf);
+
+	strbuf_release(&msg);
+}
+
+/*
+ * Process one buffer of events read from the inotify fd and publish
+ * the resulting batch of paths and cookies.
+ *
+ * Returns 0 if we should keep listening, or -1 if the listener should
+ * shut down (`data->shutdown_style` says how).
+ */
+static int process_events(struct fsmonitor_daemon_state *state,
+			  const char *buf, ssize_t len)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	struct fsmonitor_batch *batch = NULL;
+	struct string_list cookie_list = STRING_LIST_INIT_DUP;
+	struct strbuf path = STRBUF_INIT;
+	struct strbuf rel = STRBUF_INIT;
+	const char *p;
+	int ret = 0;
+
+	for (p = buf; p < buf + len;
+	     p += sizeof(struct inotify_event) + ((const struct inotify_event *)p)->len) {
+		const struct inotify_event *ev = (const struct inotify_event *)p;
+		struct watch_entry *w;
+		const char *slash;
+
+		if (ev->mask & IN_Q_OVERFLOW) {
+			/*
+			 * The kernel dropped events, so we have lost
+			 * sync with the filesystem.  Flush everything
+			 * (including the batch we were building, since
+			 * it is relative to the token being flushed).
+			 */
+			trace_printf_key(&trace_fsmonitor,
+					 "inotify: queue overflow");
+			fsmonitor_force_resync(state);
+			fsmonitor_batch__free_list(batch);
+			string_list_clear(&cookie_list, 0);
+			batch = NULL;
+			continue;
+		}
+
+		w = find_watch(data, ev->wd);
+		if (!w)
+			continue; /* an event for a watch we already removed */
+
+		if (ev->mask & IN_IGNORED) {
+			/* the kernel removed the watch (deleted or unmounted) */
+			forget_watch(data, ev->wd);
+			continue;
+		}
+
+		strbuf_reset(&path);
+		strbuf_addstr(&path, w->path);
+		if (ev->len) {
+			strbuf_addch(&path, '/');
+			strbuf_addstr(&path, ev->name);
+		}
+
+		if (trace_pass_fl(&trace_fsmonitor))
+			log_mask_set(path.buf, ev->mask);
+
+		if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+			switch (w->kind) {
+			case WATCH_WORKTREE_ROOT:
+				trace_printf_key(&trace_fsmonitor,
+						 "event: worktree root %s",
+						 (ev->mask & IN_DELETE_SELF) ?
+						 "removed" : "renamed");
+				goto force_shutdown;
+
+			case WATCH_GITDIR:
+				trace_printf_key(&trace_fsmonitor,
+						 "event: gitdir %s",
+						 (ev->mask & IN_DELETE_SELF) ?
+						 "removed" : "renamed");
+				goto force_shutdown;
+
+			default:
+				/*
+				 * Subdirectories report their own removal
+				 * and renames to their parent directory.
+				 */
+				continue;
+			}
+		}
+
+		/*
+		 * Other events on a watched directory itself are also
+		 * reported (with a name) to the watch on its parent.
+		 */
+		if (!ev->len)
+			continue;
+
+		switch (fsmonitor_classify_path_absolute(state, path.buf)) {
+
+		case IS_INSIDE_DOT_GIT_WITH_COOKIE_PREFIX:
+		case IS_INSIDE_GITDIR_WITH_COOKIE_PREFIX:
+			/* special case cookie files within .git or gitdir */
+
+			/* Use just the filename of the cookie file. */
+			slash = find_last_dir_sep(path.buf);
+			string_list_append(&cookie_list,
+					   slash ? slash + 1 : path.buf);
+			break;
+
+		case IS_INSIDE_DOT_GIT:
+		case IS_INSIDE_GITDIR:
+			/* ignore all other paths inside of .git or gitdir */
+			break;
+
+		case IS_DOT_GIT:
+		case IS_GITDIR:
+			/*
+			 * If .git directory is deleted or renamed away,
+			 * we have to quit.
+			 */
+			if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+				trace_printf_key(&trace_fsmonitor,
+						 "event: gitdir removed or renamed");
+				goto force_shutdown;
+			}
+			break;
+
+		case IS_WORKDIR_PATH:
+			/* queue normal pathnames */
+
+			strbuf_reset(&rel);
+			strbuf_addstr(&rel,
+				      path.buf + state->path_worktree_watch.len + 1);
+
+			if (ev->mask & IN_ISDIR) {
+				/*
+				 * Keep our set of watches in sync with the
+				 * directory structure.  A directory that
+				 * was created or moved into place may
+				 * already contain files that were created
+				 * before we could watch it, so the trailing
+				 * slash tells the client to invalidate
+				 * everything below it.
+				 */
+				if (ev->mask & IN_MOVED_FROM)
+					remove_watches_recursive(data, path.buf);
+				if (ev->mask & (IN_CREATE | IN_MOVED_TO) &&
+				    add_watches_recursive(state, &path,
+							  WATCH_WORKTREE_DIR)) {
+					data->shutdown_style = FORCE_ERROR_STOP;
+					ret = -1;
+					goto done;
+				}
+
+				strbuf_addch(&rel, '/');
+			}
+
+			if (!batch)
+				batch = fsmonitor_batch__new();
+			fsmonitor_batch__add_path(batch, rel.buf);
+			break;
+
+		case IS_OUTSIDE_CONE:
+		default:
+			trace_printf_key(&trace_fsmonitor,
+					 "ignoring '%s'", path.buf);
+			break;
+		}
+	}
+
+	fsmonitor_publish(state, batch, &cookie_list);
+	batch = NULL;
+	goto done;
+
+force_shutdown:
+	data->shutdown_style = FORCE_SHUTDOWN;
+	ret = -1;
+
+done:
+	fsmonitor_batch__free_list(batch);
+	string_list_clear(&cookie_list, 0);
+	strbuf_release(&path);
+	strbuf_release(&rel);
+	return ret;
+}
+
+int fsm_listen__ctor(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+	struct strbuf path = STRBUF_INIT;
+
+	CALLOC_ARRAY(data, 1);
+	state->listen_data = data;
+	data->fd_shutdown[0] = data->fd_shutdown[1] = -1;
+	hashmap_init(&data->watches, watch_entry_cmp, NULL, 0);
+
+	data->fd_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (data->fd_inotify < 0) {
+		error_errno(_("inotify_init1() failed"));
+		goto failed;
+	}
+
+	if (pipe(data->fd_shutdown) < 0) {
+		error_errno(_("could not create shutdown pipe"));
+		goto failed;
+	}
+
+	strbuf_addbuf(&path, &state->path_worktree_watch);
+	if (add_watches_recursive(state, &path, WATCH_WORKTREE_ROOT))
+		goto failed;
+
+	if (state->nr_paths_watching > 1 &&
+	    add_gitdir_watches(state, state->path_gitdir_watch.buf))
+		goto failed;
+
+	trace2_data_intmax("fsm_listen", NULL, "linux/watches",
+			   hashmap_get_size(&data->watches));
+
+	strbuf_release(&path);
+	return 0;
+
+failed:
+	error(_("unable to watch '%s' with inotify"),
+	      state->path_worktree_watch.buf);
+	strbuf_release(&path);
+	fsm_listen__dtor(state);
+	return -1;
+}
+
+void fsm_listen__dtor(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+	struct hashmap_iter iter;
+	struct watch_entry *w;
+
+	if (!state || !state->listen_data)
+		return;
+
+	data = state->listen_data;
+
+	hashmap_for_each_entry(&data->watches, &iter, w, ent)
+		free(w->path);
+	hashmap_clear_and_free(&data->watches, struct watch_entry, ent);
+
+	if (data->fd_inotify >= 0)
+		close(data->fd_inotify);
+	if (data->fd_shutdown[0] >= 0)
+		close(data->fd_shutdown[0]);
+	if (data->fd_shutdown[1] >= 0)
+		close(data->fd_shutdown[1]);
+
+	FREE_AND_NULL(state->listen_data);
+}
+
+void fsm_listen__stop_async(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data = state->listen_data;
+
+	/*
+	 * The listener may already have exited (after forcing a
+	 * shutdown); the pipe stays open until the dtor, so a write
+	 * here is harmless either way.
+	 */
+	if (write(data->fd_shutdown[1], "", 1) < 0)
+		trace_printf_key(&trace_fsmonitor,
+				 "could not signal listener shutdown: %s",
+				 strerror(errno));
+}
+
+void fsm_listen__loop(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	char *buf = xmalloc(EVENT_BUF_SIZE);
+	struct pollfd pfd[2];
+
+	/*
+	 * The kernel guarantees that the records in a single read(2)
+	 * are suitably aligned relative to the start of the buffer,
+	 * and xmalloc() gives us an aligned start.
+	 */
+	pfd[0].fd = data->fd_shutdown[0];
+	pfd[0].events = POLLIN;
+	pfd[1].fd = data->fd_inotify;
+	pfd[1].events = POLLIN;
+
+	for (;;) {
+		ssize_t len;
+
+		if (poll(pfd, ARRAY_SIZE(pfd), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			error_errno(_("poll() failed on inotify fd"));
+			data->shutdown_style = FORCE_ERROR_STOP;
+			break;
+		}
+
+		if (pfd[0].revents) {
+			data->shutdown_style = SHUTDOWN_EVENT;
+			break;
+		}
+
+		if (!(pfd[1].revents & POLLIN))
+			continue;
+
+		len = read(data->fd_inotify, buf, EVENT_BUF_SIZE);
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			error_errno(_("could not read inotify events"));
+			data->shutdown_style = FORCE_ERROR_STOP;
+			break;
+		}
+
+		if (process_events(state, buf, len))
+			break;
+	}
+
+	free(buf);
+
+	switch (data->shutdown_style) {
+	case FORCE_ERROR_STOP:
+		state->listen_error_code = -1;
+		/* fall thru */
+	case FORCE_SHUTDOWN:
+		ipc_server_stop_async(state->ipc_server_data);
+		/* fall thru */
+	case SHUTDOWN_EVENT:
+	default:
+		break;
+	}
+}
@@ -0,0 +1,103 @@
+#include "fsmonitor.h"
+#include "fsmonitor-path-utils.h"
+#include <sys/vfs.h>
+
+/*
+ * statfs(2) on Linux does not tell us whether a filesystem is local,
+ * only its type (as a magic number), so classify the well-known
+ * network filesystems as remote.  inotify only reports changes made
+ * through the local kernel, so changes made on the server or by other
+ * clients of these filesystems would never be seen.
+ */
+static const struct fs_magic {
+	long magic;
+	const char *typename;
+	int is_remote;
+} fs_magic_table[] = {
+	{ 0x6969, "nfs", 1 },
+	{ 0x517b, "smb", 1 },
+	{ 0xfe534d42, "smb2", 1 },
+	{ 0xff534d42, "cifs", 1 },
+	{ 0x5346414f, "afs", 1 },
+	{ 0x6b414653, "afs", 1 },
+	{ 0x73757245, "coda", 1 },
+	{ 0x01021997, "v9fs", 1 },
+	{ 0x00c36400, "ceph", 1 },
+	{ 0x47504653, "gpfs", 1 },
+	{ 0x0bd00bd0, "lustre", 1 },
+	{ 0x65735546, "fuse", 0 },
+	{ 0x4d44, "msdos", 0 },
+	{ 0x5346544e, "ntfs", 0 },
+	{ 0x7366746e, "ntfs3", 0 },
+	{ 0x2011bab0, "exfat", 0 },
+	{ 0xef53, "ext4", 0 },
+	{ 0x58465342, "xfs", 0 },
+	{ 0x9123683e, "btrfs", 0 },
+	{ 0x01021994, "tmpfs", 0 },
+	{ 0x794c7630, "overlayfs", 0 },
+	{ 0x2fc12fc1, "zfs", 0 },
+};
+
+int fsmonitor__get_fs_info(const char *path, struct fs_info *fs_info)
+{
+	struct statfs fs;
+	size_t k;
+
+	if (statfs(path, &fs) == -1) {
+		int saved_errno = errno;
+		trace_printf_key(&trace_fsmonitor, "statfs('%s') failed: %s",
+				 path, strerror(saved_errno));
+		errno = saved_errno;
+		return -1;
+	}
+
+	fs_info->is_remote = 0;
+	fs_info->typename = NULL;
+
+	for (k = 0; k < ARRAY_SIZE(fs_magic_table); k++) {
+		if ((unsigned long)fs.f_type !=
+		    (unsigned long)fs_magic_table[k].magic)
+			continue;
+		fs_info->is_remote = fs_magic_table[k].is_remote;
+		fs_info->typename = xstrdup(fs_magic_table[k].typename);
+		break;
+	}
+	if (!fs_info->typename)
+		fs_info->typename = xstrfmt("0x%08lx", (unsigned long)fs.f_type);
+
+	trace_printf_key(&trace_fsmonitor,
+			 "statfs('%s') [type 0x%08lx] '%s'",
+			 path, (unsigned long)fs.f_type, fs_info->typename);
+
+	trace_printf_key(&trace_fsmonitor,
+				"'%s' is_remote: %d",
+				path, fs_info->is_remote);
+	return 0;
+}
+
+int fsmonitor__is_fs_remote(const char *path)
+{
+	struct fs_info fs;
+	if (fsmonitor__get_fs_info(path, &fs))
+		return -1;
+
+	free(fs.typename);
+
+	return fs.is_remote;
+}
+
+/*
+ * Linux does not have the synthetic firmlinks that macOS has, so
+ * there are never any aliases to resolve.
+ */
+int fsmonitor__get_alias(const char *path UNUSED,
+			 struct alias_info *info UNUSED)
+{
+	return 0;
+}
+
+char *fsmonitor__resolve_alias(const char *path UNUSED,
+	const struct alias_info *info UNUSED)
+{
+	return NULL;
+}
@@ -0,0 +1,216 @@
+#include "git-compat-util.h"
+#include "lstat-ring.h"
+
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*
+ * This talks to io_uring(7) directly rather than through liburing: all
+ * we need is to queue IORING_OP_STATX requests and wait for them.
+ */
+
+struct lstat_ring {
+	int fd;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	unsigned int depth;
+	struct statx *stx;
+};
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static void stat_from_statx(struct stat *st, const struct statx *stx)
+{
+	memset(st, 0, sizeof(*st));
+	st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+	st->st_ino = stx->stx_ino;
+	st->st_mode = stx->stx_mode;
+	st->st_nlink = stx->stx_nlink;
+	st->st_uid = stx->stx_uid;
+	st->st_gid = stx->stx_gid;
+	st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+	st->st_size = stx->stx_size;
+	st->st_blksize = stx->stx_blksize;
+	st->st_blocks = stx->stx_blocks;
+	st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+	st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+	st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+	st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+	st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+	st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+struct lstat_ring *lstat_ring_new(unsigned int depth)
+{
+	struct io_uring_params p;
+	struct lstat_ring *ring;
+	const char *probe_path = ".";
+	struct stat probe_st;
+	int probe_ret;
+
+	memset(&p, 0, sizeof(p));
+	CALLOC_ARRAY(ring, 1);
+	ring->fd = io_uring_setup(depth, &p);
+	if (ring->fd < 0) {
+		free(ring);
+		return NULL;
+	}
+
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto fail_sq_ring;
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_ring = ring->sq_ring;
+	else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size,
+				     PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, ring->fd,
+				     IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+			goto fail_cq_ring;
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto fail_sqes;
+
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ring + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)((char *)ring->sq_ring + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ring + p.sq_off.array);
+	ring->cq_head = (unsigned *)((char *)ring->cq_ring + p.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ring + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)((char *)ring->cq_ring + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring +
+					     p.cq_off.cqes);
+
+	/* the kernel may round the depth up, but never down */
+	ring->depth = depth;
+	CALLOC_ARRAY(ring->stx, depth);
+
+	/*
+	 * Kernels before 5.6 set up the ring but fail IORING_OP_STATX,
+	 * and seccomp filters may fail it as well: find out now.
+	 */
+	if (lstat_ring_run(ring, 1, &probe_path, &probe_st, &probe_ret) ||
+	    probe_ret) {
+		lstat_ring_free(ring);
+		return NULL;
+	}
+	return ring;
+
+fail_sqes:
+	if (ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+fail_cq_ring:
+	munmap(ring->sq_ring, ring->sq_ring_size);
+fail_sq_ring:
+	close(ring->fd);
+	free(ring);
+	return NULL;
+}
+
+int lstat_ring_run(struct lstat_ring *ring, unsigned int nr,
+		   const char **paths, struct stat *st, int *ret)
+{
+	unsigned int i, tail, to_submit, pending;
+
+	if (nr > ring->depth)
+		BUG("lstat_ring_run() with %u paths on a ring of %u",
+		    nr, ring->depth);
+
+	tail = *ring->sq_tail;
+	for (i = 0; i < nr; i++) {
+		unsigned int idx = tail & *ring->sq_mask;
+		struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_STATX;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (uintptr_t)paths[i];
+		sqe->len = STATX_BASIC_STATS;
+		sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+		sqe->off = (uintptr_t)&ring->stx[i];
+		sqe->user_data = i;
+		ring->sq_array[idx] = idx;
+		tail++;
+	}
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	to_submit = nr;
+	pending = nr;
+	while (pending) {
+		unsigned int head, cq_tail;
+		int submitted;
+
+		submitted = io_uring_enter(ring->fd, to_submit, 1,
+					   IORING_ENTER_GETEVENTS);
+		if (submitted < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				continue;
+			if (to_submit == nr)
+				return -1;
+			/* the requests in flight still write to ring->stx */
+			die_errno("io_uring_enter");
+		}
+		to_submit -= submitted;
+
+		head = *ring->cq_head;
+		cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != cq_tail; head++) {
+			struct io_uring_cqe *cqe =
+				&ring->cqes[head & *ring->cq_mask];
+
+			i = cqe->user_data;
+			ret[i] = cqe->res;
+			if (!cqe->res)
+				stat_from_statx(&st[i], &ring->stx[i]);
+			pending--;
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+void lstat_ring_free(struct lstat_ring *ring)
+{
+	if (!ring)
+		return;
+	munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	munmap(ring->sq_ring, ring->sq_ring_size);
+	close(ring->fd);
+	free(ring->stx);
+	free(ring);
+}
@@ -1152,6 +1152,7 @@ static int ident_to_worktree(const char *src, size_t len,
 			     struct strbuf *buf, int ident)
 {
 	struct object_id oid;
+	char hex[GIT_MAX_HEXSZ + 1];
 	char *to_free = NULL, *dollar, *spc;
 	int cnt;
 
@@ -1222,7 +1223,7 @@ static int ident_to_worktree(const char *src, size_t len,
 
 		/* step 4: substitute */
 		strbuf_addstr(buf, "Id: ");
-		strbuf_addstr(buf, oid_to_hex(&oid));
+		strbuf_addstr(buf, oid_to_hex_r(hex, &oid));
 		strbuf_addstr(buf, " $");
 	}
 	strbuf_add(buf, src, len);
@@ -1944,9 +1945,10 @@ static struct stream_filter_vtbl ident_vtbl = {
 static struct stream_filter *ident_filter(const struct object_id *oid)
 {
 	struct ident_filter *ident = xmalloc(sizeof(*ident));
+	char hex[GIT_MAX_HEXSZ + 1];
 
 	xsnprintf(ident->ident, sizeof(ident->ident),
-		  ": %s $", oid_to_hex(oid));
+		  ": %s $", oid_to_hex_r(hex, oid));
 	strbuf_init(&ident->left, 0);
 	ident->filter.vtbl = &ident_vtbl;
 	ident->state = 0;
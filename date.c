@@ -208,11 +208,24 @@ void show_date_relative(timestamp_t time, struct strbuf *timebuf)
 
 struct date_mode *date_mode_from_type(enum date_mode_type type)
 {
-	static struct date_mode mode = DATE_MODE_INIT;
-	if (type == DATE_STRFTIME)
+	/*
+	 * One entry per type, so that threads asking for different types
+	 * at the same time do not overwrite each other's answer.
+	 */
+	static struct date_mode modes[] = {
+		[DATE_NORMAL] = { .type = DATE_NORMAL },
+		[DATE_HUMAN] = { .type = DATE_HUMAN },
+		[DATE_RELATIVE] = { .type = DATE_RELATIVE },
+		[DATE_SHORT] = { .type = DATE_SHORT },
+		[DATE_ISO8601] = { .type = DATE_ISO8601 },
+		[DATE_ISO8601_STRICT] = { .type = DATE_ISO8601_STRICT },
+		[DATE_RFC2822] = { .type = DATE_RFC2822 },
+		[DATE_RAW] = { .type = DATE_RAW },
+		[DATE_UNIX] = { .type = DATE_UNIX },
+	};
+	if (type == DATE_STRFTIME || type >= ARRAY_SIZE(modes))
 		BUG("cannot create anonymous strftime date_mode struct");
-	mode.type = type;
-	return &mode;
+	return &modes[type];
 }
 
 static void show_date_normal(struct strbuf *buf, timestamp_t time, struct tm *tm, int tz, struct tm *human_tm, int human_tz, int local)
@@ -282,18 +295,17 @@ static void show_date_normal(struct strbuf *buf, timestamp_t time, struct tm *tm
 		strbuf_addf(buf, " %+05d", tz);
 }
 
-const char *show_date(timestamp_t time, int tz, const struct date_mode *mode)
+void show_date_buf(struct strbuf *buf, timestamp_t time, int tz,
+		   const struct date_mode *mode)
 {
 	struct tm *tm;
 	struct tm tmbuf = { 0 };
 	struct tm human_tm = { 0 };
 	int human_tz = -1;
-	static struct strbuf timebuf = STRBUF_INIT;
 
 	if (mode->type == DATE_UNIX) {
-		strbuf_reset(&timebuf);
-		strbuf_addf(&timebuf, "%"PRItime, time);
-		return timebuf.buf;
+		strbuf_addf(buf, "%"PRItime, time);
+		return;
 	}
 
 	if (mode->type == DATE_HUMAN) {
@@ -309,15 +321,13 @@ const char *show_date(timestamp_t time, int tz, const struct date_mode *mode)
 		tz = local_tzoffset(time);
 
 	if (mode->type == DATE_RAW) {
-		strbuf_reset(&timebuf);
-		strbuf_addf(&timebuf, "%"PRItime" %+05d", time, tz);
-		return timebuf.buf;
+		strbuf_addf(buf, "%"PRItime" %+05d", time, tz);
+		return;
 	}
 
 	if (mode->type == DATE_RELATIVE) {
-		strbuf_reset(&timebuf);
-		show_date_relative(time, &timebuf);
-		return timebuf.buf;
+		show_date_relative(time, buf);
+		return;
 	}
 
 	if (mode->local)
@@ -329,12 +339,11 @@ const char *show_date(timestamp_t time, int tz, const struct date_mode *mode)
 		tz = 0;
 	}
 
-	strbuf_reset(&timebuf);
 	if (mode->type == DATE_SHORT)
-		strbuf_addf(&timebuf, "%04d-%02d-%02d", tm->tm_year + 1900,
+		strbuf_addf(buf, "%04d-%02d-%02d", tm->tm_year + 1900,
 				tm->tm_mon + 1, tm->tm_mday);
 	else if (mode->type == DATE_ISO8601)
-		strbuf_addf(&timebuf, "%04d-%02d-%02d %02d:%02d:%02d %+05d",
+		strbuf_addf(buf, "%04d-%02d-%02d %02d:%02d:%02d %+05d",
 				tm->tm_year + 1900,
 				tm->tm_mon + 1,
 				tm->tm_mday,
@@ -343,22 +352,30 @@ const char *show_date(timestamp_t time, int tz, const struct date_mode *mode)
 	else if (mode->type == DATE_ISO8601_STRICT) {
 		char sign = (tz >= 0) ? '+' : '-';
 		tz = abs(tz);
-		strbuf_addf(&timebuf, "%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d",
+		strbuf_addf(buf, "%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d",
 				tm->tm_year + 1900,
 				tm->tm_mon + 1,
 				tm->tm_mday,
 				tm->tm_hour, tm->tm_min, tm->tm_sec,
 				sign, tz / 100, tz % 100);
 	} else if (mode->type == DATE_RFC2822)
-		strbuf_addf(&timebuf, "%.3s, %d %.3s %d %02d:%02d:%02d %+05d",
+		strbuf_addf(buf, "%.3s, %d %.3s %d %02d:%02d:%02d %+05d",
 			weekday_names[tm->tm_wday], tm->tm_mday,
 			month_names[tm->tm_mon], tm->tm_year + 1900,
 			tm->tm_hour, tm->tm_min, tm->tm_sec, tz);
 	else if (mode->type == DATE_STRFTIME)
-		strbuf_addftime(&timebuf, mode->strftime_fmt, tm, tz,
+		strbuf_addftime(buf, mode->strftime_fmt, tm, tz,
 				!mode->local);
 	else
-		show_date_normal(&timebuf, time, tm, tz, &human_tm, human_tz, mode->local);
+		show_date_normal(buf, time, tm, tz, &human_tm, human_tz, mode->local);
+}
+
+const char *show_date(timestamp_t time, int tz, const struct date_mode *mode)
+{
+	static struct strbuf timebuf = STRBUF_INIT;
+
+	strbuf_reset(&timebuf);
+	show_date_buf(&timebuf, time, tz, mode);
 	return timebuf.buf;
 }
 
@@ -45,6 +45,13 @@ struct date_mode *date_mode_from_type(enum date_mode_type type);
  */
 const char *show_date(timestamp_t time, int timezone, const struct date_mode *mode);
 
+/**
+ * Like show_date(), but append the result to 'buf' instead of using
+ * static memory, so that it may be called from several threads.
+ */
+void show_date_buf(struct strbuf *buf, timestamp_t time, int timezone,
+		   const struct date_mode *mode);
+
 /**
  * Parse a date format for later use with show_date().
  *
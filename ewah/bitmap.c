@@ -19,10 +19,235 @@
 #include "git-compat-util.h"
 #include "alloc.h"
 #include "ewok.h"
+#include "ewok_rlw.h"
 
 #define EWAH_MASK(x) ((eword_t)1 << (x % BITS_IN_EWORD))
 #define EWAH_BLOCK(x) (x / BITS_IN_EWORD)
 
+/*
+ * The set operations below are plain loops over arrays of words.  They
+ * run on every bitmap walk, so each comes in several implementations
+ * and we pick the first one that the CPU supports the first time any
+ * of them is needed.  The vector implementations are compiled with
+ * function-level target attributes, so the rest of the build needs no
+ * special flags.
+ */
+struct bitmap_impl {
+	const char *name;
+	int (*supported)(void);
+	void (*or_words)(eword_t *dst, const eword_t *src, size_t nr);
+	void (*and_not_words)(eword_t *dst, const eword_t *src, size_t nr);
+	/* Is any bit set in "a" but not in "b"? */
+	int (*any_and_not)(const eword_t *a, const eword_t *b, size_t nr);
+	size_t (*popcount_words)(const eword_t *words, size_t nr);
+};
+
+static void or_words_generic(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		dst[i] |= src[i];
+}
+
+static void and_not_words_generic(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		dst[i] &= ~src[i];
+}
+
+static int any_and_not_generic(const eword_t *a, const eword_t *b, size_t nr)
+{
+	size_t i = 0;
+
+	/*
+	 * Check in blocks rather than after every word, which keeps the
+	 * inner loop free of branches.
+	 */
+	while (i + 8 <= nr) {
+		eword_t acc = 0;
+		size_t end = i + 8;
+
+		for (; i < end; i++)
+			acc |= a[i] & ~b[i];
+		if (acc)
+			return 1;
+	}
+	for (; i < nr; i++)
+		if (a[i] & ~b[i])
+			return 1;
+	return 0;
+}
+
+static size_t popcount_words_generic(const eword_t *words, size_t nr)
+{
+	size_t i, count = 0;
+
+	for (i = 0; i < nr; i++)
+		count += ewah_bit_popcount64(words[i]);
+	return count;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define BITMAP_X86_AVX2
+#endif
+
+#ifdef BITMAP_X86_AVX2
+#include <cpuid.h>
+#include <immintrin.h>
+
+/*
+ * Does the CPU have AVX2, and does the OS save the SSE and AVX register
+ * state on context switches?
+ */
+static int avx2_supported(void)
+{
+	unsigned int eax, ebx, ecx, edx, xcr0_lo, xcr0_hi;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid(1, eax, ebx, ecx, edx);
+	if (!(ecx & bit_OSXSAVE))
+		return 0;
+	__asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+	if ((xcr0_lo & 0x6) != 0x6)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return !!(ebx & bit_AVX2);
+}
+
+__attribute__((target("avx2")))
+static void or_words_avx2(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= nr; i += 4) {
+		__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, s));
+	}
+	for (; i < nr; i++)
+		dst[i] |= src[i];
+}
+
+__attribute__((target("avx2")))
+static void and_not_words_avx2(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= nr; i += 4) {
+		__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_andnot_si256(s, d));
+	}
+	for (; i < nr; i++)
+		dst[i] &= ~src[i];
+}
+
+__attribute__((target("avx2")))
+static int any_and_not_avx2(const eword_t *a, const eword_t *b, size_t nr)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= nr; i += 8) {
+		__m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i a1 = _mm256_loadu_si256((const __m256i *)(a + i + 4));
+		__m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i b1 = _mm256_loadu_si256((const __m256i *)(b + i + 4));
+		__m256i acc = _mm256_or_si256(_mm256_andnot_si256(b0, a0),
+					      _mm256_andnot_si256(b1, a1));
+		if (!_mm256_testz_si256(acc, acc))
+			return 1;
+	}
+	for (; i < nr; i++)
+		if (a[i] & ~b[i])
+			return 1;
+	return 0;
+}
+
+/*
+ * AVX2 has no population count instruction; look up the count of each
+ * nibble with a byte shuffle, and sum the bytes of each 64-bit lane
+ * with psadbw.
+ */
+__attribute__((target("avx2")))
+static size_t popcount_words_avx2(const eword_t *words, size_t nr)
+{
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+						1, 2, 2, 3, 2, 3, 3, 4,
+						0, 1, 1, 2, 1, 2, 2, 3,
+						1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i acc = _mm256_setzero_si256();
+	uint64_t lanes[4];
+	size_t i = 0, count;
+
+	for (; i + 4 <= nr; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+		__m256i lo = _mm256_and_si256(v, low_mask);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+		__m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+					      _mm256_shuffle_epi8(lookup, hi));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+	}
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+	count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (; i < nr; i++)
+		count += ewah_bit_popcount64(words[i]);
+	return count;
+}
+#endif
+
+/* In order of preference. */
+static const struct bitmap_impl bitmap_impls[] = {
+#ifdef BITMAP_X86_AVX2
+	{ "avx2", avx2_supported, or_words_avx2, and_not_words_avx2,
+	  any_and_not_avx2, popcount_words_avx2 },
+#endif
+	{ "generic", NULL, or_words_generic, and_not_words_generic,
+	  any_and_not_generic, popcount_words_generic },
+};
+
+static const struct bitmap_impl *bitmap_impl;
+
+static const struct bitmap_impl *get_bitmap_impl(void)
+{
+	int i;
+
+	if (bitmap_impl)
+		return bitmap_impl;
+	for (i = 0; i < ARRAY_SIZE(bitmap_impls); i++) {
+		if (!bitmap_impls[i].supported || bitmap_impls[i].supported()) {
+			bitmap_impl = &bitmap_impls[i];
+			break;
+		}
+	}
+	return bitmap_impl;
+}
+
+const char *bitmap_impl_name(unsigned int n)
+{
+	return n < ARRAY_SIZE(bitmap_impls) ? bitmap_impls[n].name : NULL;
+}
+
+int bitmap_use_impl(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(bitmap_impls); i++) {
+		if (strcmp(bitmap_impls[i].name, name))
+			continue;
+		if (bitmap_impls[i].supported && !bitmap_impls[i].supported())
+			return -1;
+		bitmap_impl = &bitmap_impls[i];
+		return 0;
+	}
+	return -1;
+}
+
 struct bitmap *bitmap_word_alloc(size_t word_alloc)
 {
 	struct bitmap *bitmap = xmalloc(sizeof(struct bitmap));
@@ -124,50 +349,88 @@ void bitmap_and_not(struct bitmap *self, struct bitmap *other)
 	const size_t count = (self->word_alloc < other->word_alloc) ?
 		self->word_alloc : other->word_alloc;
 
-	size_t i;
-
-	for (i = 0; i < count; ++i)
-		self->words[i] &= ~other->words[i];
+	get_bitmap_impl()->and_not_words(self->words, other->words, count);
 }
 
 void bitmap_or(struct bitmap *self, const struct bitmap *other)
 {
-	size_t i;
-
 	bitmap_grow(self, other->word_alloc);
-	for (i = 0; i < other->word_alloc; i++)
-		self->words[i] |= other->words[i];
+	get_bitmap_impl()->or_words(self->words, other->words, other->word_alloc);
 }
 
-void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
+/*
+ * Make "self" exactly "word_alloc" words long if it is shorter; unlike
+ * bitmap_grow() this does not leave room for later growth.
+ */
+static void bitmap_reserve(struct bitmap *self, size_t word_alloc)
 {
 	size_t original_size = self->word_alloc;
-	size_t other_final = (other->bit_size / BITS_IN_EWORD) + 1;
-	size_t i = 0;
-	struct ewah_iterator it;
-	eword_t word;
 
-	if (self->word_alloc < other_final) {
-		self->word_alloc = other_final;
+	if (self->word_alloc < word_alloc) {
+		self->word_alloc = word_alloc;
 		REALLOC_ARRAY(self->words, self->word_alloc);
 		memset(self->words + original_size, 0x0,
 			(self->word_alloc - original_size) * sizeof(eword_t));
 	}
+}
 
-	ewah_iterator_init(&it, other);
+static size_t ewah_final_words(struct ewah_bitmap *ewah)
+{
+	return (ewah->bit_size / BITS_IN_EWORD) + 1;
+}
 
-	while (ewah_iterator_next(&word, &it))
-		self->words[i++] |= word;
+/*
+ * Walk the run-length words of "other" directly instead of expanding
+ * it word by word: runs of zeroes are skipped, runs of ones are filled
+ * in, and each group of literal words is ORed in with a single call.
+ */
+static void bitmap_or_ewah_words(struct bitmap *self, struct ewah_bitmap *other)
+{
+	const struct bitmap_impl *k = get_bitmap_impl();
+	size_t pos = 0, i = 0;
+
+	while (pos < other->buffer_size) {
+		eword_t rlw = other->buffer[pos++];
+		size_t run = rlw_get_running_len(&rlw);
+		size_t lit = rlw_get_literal_words(&rlw);
+
+		if (lit > other->buffer_size - pos)
+			lit = other->buffer_size - pos;
+		if (i + run + lit > self->word_alloc)
+			bitmap_grow(self, i + run + lit);
+
+		if (run && rlw_get_run_bit(&rlw))
+			memset(self->words + i, 0xff, run * sizeof(eword_t));
+		i += run;
+
+		k->or_words(self->words + i, other->buffer + pos, lit);
+		i += lit;
+		pos += lit;
+	}
 }
 
-size_t bitmap_popcount(struct bitmap *self)
+void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
 {
-	size_t i, count = 0;
+	bitmap_reserve(self, ewah_final_words(other));
+	bitmap_or_ewah_words(self, other);
+}
 
-	for (i = 0; i < self->word_alloc; ++i)
-		count += ewah_bit_popcount64(self->words[i]);
+void bitmap_or_ewah_many(struct bitmap *self, struct ewah_bitmap **others,
+			 size_t nr)
+{
+	size_t i, word_alloc = 0;
+
+	for (i = 0; i < nr; i++)
+		if (word_alloc < ewah_final_words(others[i]))
+			word_alloc = ewah_final_words(others[i]);
+	bitmap_reserve(self, word_alloc);
+	for (i = 0; i < nr; i++)
+		bitmap_or_ewah_words(self, others[i]);
+}
 
-	return count;
+size_t bitmap_popcount(struct bitmap *self)
+{
+	return get_bitmap_impl()->popcount_words(self->words, self->word_alloc);
 }
 
 int bitmap_equals(struct bitmap *self, struct bitmap *other)
@@ -210,11 +473,7 @@ int bitmap_is_subset(struct bitmap *self, struct bitmap *other)
 		}
 	}
 
-	for (i = 0; i < common_size; i++) {
-		if (self->words[i] & ~other->words[i])
-			return 1;
-	}
-	return 0;
+	return get_bitmap_impl()->any_and_not(self->words, other->words, common_size);
 }
 
 void bitmap_free(struct bitmap *bitmap)
@@ -95,6 +95,13 @@ uint32_t ewah_checksum(struct ewah_bitmap *self);
  */
 void ewah_each_bit(struct ewah_bitmap *self, ewah_callback callback, void *payload);
 
+/**
+ * Return whether the bit at position `pos` is set. This skips over
+ * runs without decompressing them, but still has to look at every
+ * marker word before `pos`.
+ */
+int ewah_get(struct ewah_bitmap *self, size_t pos);
+
 /**
  * Set a given bit on the bitmap.
  *
@@ -188,6 +195,108 @@ void bitmap_and_not(struct bitmap *self, struct bitmap *other);
 void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other);
 void bitmap_or(struct bitmap *self, const struct bitmap *other);
 
+/*
+ * OR all of "others" into "self", growing "self" only once to fit the
+ * largest of them.
+ */
+void bitmap_or_ewah_many(struct bitmap *self, struct ewah_bitmap **others,
+			 size_t nr);
+
 size_t bitmap_popcount(struct bitmap *self);
 
+/*
+ * The word loops behind the operations above are picked at runtime
+ * among the implementations that the CPU supports (e.g. AVX2).  These
+ * are meant for tests and benchmarks: bitmap_impl_name() returns the
+ * name of the n-th implementation built in, or NULL past the last one,
+ * and bitmap_use_impl() switches to the named implementation, returning
+ * -1 if it is unknown or not supported by this CPU.
+ */
+const char *bitmap_impl_name(unsigned int n);
+int bitmap_use_impl(const char *name);
+
+/**
+ * Roaring-style compressed bitmap.
+ *
+ * The bit positions are split into chunks of 2^16 bits, and each chunk
+ * that has any bit set is stored as a container of whichever of these
+ * types is the smallest for its contents:
+ *
+ *  - an array of the (sorted) positions of its set bits,
+ *  - a plain bitset of 1024 words,
+ *  - a list of runs of consecutive set bits.
+ *
+ * Unlike an EWAH bitmap, a chunk can be found and combined with others
+ * without decompressing the chunks that come before it.
+ */
+#define ROARING_CHUNK_BITS 65536
+
+enum roaring_container_type {
+	ROARING_ARRAY = 1,
+	ROARING_BITSET = 2,
+	ROARING_RUN = 3,
+};
+
+/* The run of set bits [start, start + length] of a chunk. */
+struct roaring_run {
+	uint16_t start;
+	uint16_t length;
+};
+
+struct roaring_container {
+	/* The high 16 bits of the positions in this container. */
+	uint16_t key;
+	uint16_t type;
+	/*
+	 * The number of positions in an array container, of runs in a
+	 * run container, and of bits set in a bitset container.
+	 */
+	uint32_t nr;
+	/* uint16_t, struct roaring_run or eword_t, depending on "type" */
+	void *data;
+};
+
+struct roaring_bitmap {
+	/* Sorted by key */
+	struct roaring_container *containers;
+	size_t nr, alloc;
+};
+
+struct roaring_bitmap *roaring_new(void);
+void roaring_free(struct roaring_bitmap *self);
+
+struct roaring_bitmap *ewah_to_roaring(struct ewah_bitmap *ewah);
+struct ewah_bitmap *roaring_to_ewah(const struct roaring_bitmap *self);
+
+int roaring_serialize_to(struct roaring_bitmap *self,
+			 int (*write_fun)(void *out, const void *buf, size_t len),
+			 void *out);
+ssize_t roaring_read_mmap(struct roaring_bitmap *self, const void *map, size_t len);
+
+/**
+ * Store the symmetric difference of `a` and `b` in `out`, which must be
+ * empty. Only the chunks present in both are decompressed.
+ */
+void roaring_xor(const struct roaring_bitmap *a, const struct roaring_bitmap *b,
+		 struct roaring_bitmap *out);
+
+/**
+ * Store the intersection of `a` and `b` (or, for roaring_and_not(), the
+ * bits of `a` that are not in `b`) in `out`, which must be empty. Array
+ * containers are filtered without being decompressed, and the other
+ * chunks present in both are combined word by word.
+ */
+void roaring_and(const struct roaring_bitmap *a, const struct roaring_bitmap *b,
+		 struct roaring_bitmap *out);
+void roaring_and_not(const struct roaring_bitmap *a, const struct roaring_bitmap *b,
+		     struct roaring_bitmap *out);
+
+void bitmap_or_roaring(struct bitmap *self, const struct roaring_bitmap *other);
+
+/**
+ * Return whether the bit at position `pos` is set; only the chunk
+ * that holds it is looked at.
+ */
+int roaring_get(const struct roaring_bitmap *self, size_t pos);
+
 #endif
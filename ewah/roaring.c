@@ -0,0 +1,753 @@
+#include "git-compat-util.h"
+#include "alloc.h"
+#include "ewok.h"
+
+#define ROARING_CHUNK_WORDS (ROARING_CHUNK_BITS / BITS_IN_EWORD)
+
+/*
+ * A container never needs more than this many bytes: that is the size
+ * of a bitset, and a sparser array or run container is only used when
+ * it is smaller.
+ */
+#define ROARING_MAX_CONTAINER_BYTES (ROARING_CHUNK_WORDS * sizeof(eword_t))
+
+struct roaring_bitmap *roaring_new(void)
+{
+	struct roaring_bitmap *self;
+
+	CALLOC_ARRAY(self, 1);
+	return self;
+}
+
+void roaring_free(struct roaring_bitmap *self)
+{
+	size_t i;
+
+	if (!self)
+		return;
+
+	for (i = 0; i < self->nr; i++)
+		free(self->containers[i].data);
+	free(self->containers);
+	free(self);
+}
+
+static size_t container_bytes(const struct roaring_container *c)
+{
+	switch (c->type) {
+	case ROARING_ARRAY:
+		return st_mult(c->nr, sizeof(uint16_t));
+	case ROARING_RUN:
+		return st_mult(c->nr, sizeof(struct roaring_run));
+	case ROARING_BITSET:
+		return ROARING_MAX_CONTAINER_BYTES;
+	}
+	BUG("unknown roaring container type %d", c->type);
+}
+
+static struct roaring_container *append_container(struct roaring_bitmap *self,
+						  uint16_t key)
+{
+	struct roaring_container *c;
+
+	ALLOC_GROW(self->containers, self->nr + 1, self->alloc);
+	c = &self->containers[self->nr++];
+	memset(c, 0, sizeof(*c));
+	c->key = key;
+	return c;
+}
+
+static void copy_container(struct roaring_bitmap *self,
+			   const struct roaring_container *src)
+{
+	struct roaring_container *c = append_container(self, src->key);
+
+	c->type = src->type;
+	c->nr = src->nr;
+	c->data = xmemdupz(src->data, container_bytes(src));
+}
+
+enum roaring_op {
+	ROARING_OP_OR,
+	ROARING_OP_XOR,
+	ROARING_OP_ANDNOT,
+};
+
+/*
+ * Set (or flip, or clear, depending on "op") the bits [start, end] of
+ * a chunk's words.
+ */
+static void words_range(eword_t *words, uint32_t start, uint32_t end,
+			enum roaring_op op)
+{
+	size_t first = start / BITS_IN_EWORD, last = end / BITS_IN_EWORD, i;
+	eword_t first_mask = ~(eword_t)0 << (start % BITS_IN_EWORD);
+	eword_t last_mask = ~(eword_t)0 >> (BITS_IN_EWORD - 1 - end % BITS_IN_EWORD);
+
+	if (first == last)
+		first_mask &= last_mask;
+
+	switch (op) {
+	case ROARING_OP_OR:
+		words[first] |= first_mask;
+		if (first == last)
+			return;
+		for (i = first + 1; i < last; i++)
+			words[i] = ~(eword_t)0;
+		words[last] |= last_mask;
+		break;
+	case ROARING_OP_XOR:
+		words[first] ^= first_mask;
+		if (first == last)
+			return;
+		for (i = first + 1; i < last; i++)
+			words[i] = ~words[i];
+		words[last] ^= last_mask;
+		break;
+	case ROARING_OP_ANDNOT:
+		words[first] &= ~first_mask;
+		if (first == last)
+			return;
+		for (i = first + 1; i < last; i++)
+			words[i] = 0;
+		words[last] &= ~last_mask;
+		break;
+	}
+}
+
+/*
+ * OR (or XOR, or AND-NOT, depending on "op") the container into the
+ * words of its chunk; only the first "nr_words" words of a bitset are
+ * looked at, the remaining ones must be zero.
+ */
+static void container_apply(const struct roaring_container *c,
+			    eword_t *words, size_t nr_words, enum roaring_op op)
+{
+	uint32_t i;
+
+	switch (c->type) {
+	case ROARING_ARRAY: {
+		const uint16_t *values = c->data;
+
+		switch (op) {
+		case ROARING_OP_OR:
+			for (i = 0; i < c->nr; i++)
+				words[values[i] / BITS_IN_EWORD] |=
+					(eword_t)1 << (values[i] % BITS_IN_EWORD);
+			break;
+		case ROARING_OP_XOR:
+			for (i = 0; i < c->nr; i++)
+				words[values[i] / BITS_IN_EWORD] ^=
+					(eword_t)1 << (values[i] % BITS_IN_EWORD);
+			break;
+		case ROARING_OP_ANDNOT:
+			for (i = 0; i < c->nr; i++)
+				words[values[i] / BITS_IN_EWORD] &=
+					~((eword_t)1 << (values[i] % BITS_IN_EWORD));
+			break;
+		}
+		break;
+	}
+	case ROARING_RUN: {
+		const struct roaring_run *runs = c->data;
+
+		for (i = 0; i < c->nr; i++)
+			words_range(words, runs[i].start,
+				    runs[i].start + runs[i].length, op);
+		break;
+	}
+	case ROARING_BITSET: {
+		const eword_t *src = c->data;
+
+		/*
+		 * Keep these loops free of anything but the operation
+		 * itself, so that the compiler can vectorize them.
+		 */
+		if (nr_words > ROARING_CHUNK_WORDS)
+			nr_words = ROARING_CHUNK_WORDS;
+		switch (op) {
+		case ROARING_OP_OR:
+			for (i = 0; i < nr_words; i++)
+				words[i] |= src[i];
+			break;
+		case ROARING_OP_XOR:
+			for (i = 0; i < nr_words; i++)
+				words[i] ^= src[i];
+			break;
+		case ROARING_OP_ANDNOT:
+			for (i = 0; i < nr_words; i++)
+				words[i] &= ~src[i];
+			break;
+		}
+		break;
+	}
+	default:
+		BUG("unknown roaring container type %d", c->type);
+	}
+}
+
+/* Decompress the container into all the words of its chunk. */
+static void container_words(const struct roaring_container *c, eword_t *words)
+{
+	if (c->type == ROARING_BITSET) {
+		memcpy(words, c->data, ROARING_MAX_CONTAINER_BYTES);
+		return;
+	}
+	memset(words, 0, ROARING_MAX_CONTAINER_BYTES);
+	container_apply(c, words, ROARING_CHUNK_WORDS, ROARING_OP_OR);
+}
+
+/* Return the index of the last non-zero word of the container's chunk. */
+static uint32_t container_last_word(const struct roaring_container *c)
+{
+	switch (c->type) {
+	case ROARING_ARRAY:
+		return ((const uint16_t *)c->data)[c->nr - 1] / BITS_IN_EWORD;
+	case ROARING_RUN: {
+		const struct roaring_run *run = (const struct roaring_run *)c->data + c->nr - 1;
+		return (run->start + run->length) / BITS_IN_EWORD;
+	}
+	case ROARING_BITSET: {
+		const eword_t *words = c->data;
+		uint32_t i = ROARING_CHUNK_WORDS - 1;
+
+		while (i && !words[i])
+			i--;
+		return i;
+	}
+	}
+	BUG("unknown roaring container type %d", c->type);
+}
+
+/*
+ * Append a container for the chunk "key" holding the bits set in
+ * "words", using whichever representation is the smallest. Nothing
+ * is added if no bit is set.
+ */
+static void add_chunk(struct roaring_bitmap *self, uint16_t key,
+		      const eword_t *words)
+{
+	struct roaring_container *c;
+	uint32_t card = 0, runs = 0, i, n = 0;
+	eword_t carry = 0;
+
+	for (i = 0; i < ROARING_CHUNK_WORDS; i++) {
+		eword_t w = words[i];
+
+		card += ewah_bit_popcount64(w);
+		/* count the bits that start a run of ones */
+		runs += ewah_bit_popcount64(w & ~((w << 1) | carry));
+		carry = w >> (BITS_IN_EWORD - 1);
+	}
+	if (!card)
+		return;
+
+	c = append_container(self, key);
+	if (runs * sizeof(struct roaring_run) < card * sizeof(uint16_t) &&
+	    runs * sizeof(struct roaring_run) < ROARING_MAX_CONTAINER_BYTES) {
+		struct roaring_run *out;
+		uint32_t pos = 0;
+
+		c->type = ROARING_RUN;
+		c->nr = runs;
+		ALLOC_ARRAY(out, runs);
+		while (n < runs) {
+			uint32_t start, end;
+			eword_t w;
+
+			/* find the next set bit at or after "pos" */
+			i = pos / BITS_IN_EWORD;
+			w = words[i] & (~(eword_t)0 << (pos % BITS_IN_EWORD));
+			while (!w)
+				w = words[++i];
+			start = i * BITS_IN_EWORD + ewah_bit_ctz64(w);
+
+			/* and the next clear bit after that */
+			w = ~words[i] & (~(eword_t)0 << (start % BITS_IN_EWORD));
+			while (!w && ++i < ROARING_CHUNK_WORDS)
+				w = ~words[i];
+			end = i < ROARING_CHUNK_WORDS ?
+				i * BITS_IN_EWORD + ewah_bit_ctz64(w) :
+				ROARING_CHUNK_BITS;
+
+			out[n].start = start;
+			out[n].length = end - 1 - start;
+			n++;
+			pos = end;
+		}
+		c->data = out;
+	} else if (card * sizeof(uint16_t) < ROARING_MAX_CONTAINER_BYTES) {
+		uint16_t *out;
+
+		c->type = ROARING_ARRAY;
+		c->nr = card;
+		ALLOC_ARRAY(out, card);
+		for (i = 0; i < ROARING_CHUNK_WORDS; i++) {
+			eword_t w = words[i];
+
+			while (w) {
+				out[n++] = i * BITS_IN_EWORD + ewah_bit_ctz64(w);
+				w &= w - 1;
+			}
+		}
+		c->data = out;
+	} else {
+		c->type = ROARING_BITSET;
+		c->nr = card;
+		c->data = xmemdupz(words, ROARING_MAX_CONTAINER_BYTES);
+	}
+}
+
+struct roaring_bitmap *ewah_to_roaring(struct ewah_bitmap *ewah)
+{
+	struct roaring_bitmap *self = roaring_new();
+	eword_t words[ROARING_CHUNK_WORDS];
+	struct ewah_iterator it;
+	eword_t word;
+	size_t i = 0;
+	uint32_t key = 0;
+
+	ewah_iterator_init(&it, ewah);
+	while (ewah_iterator_next(&word, &it)) {
+		words[i++] = word;
+		if (i == ROARING_CHUNK_WORDS) {
+			if (key > UINT16_MAX)
+				BUG("bitmap too large for a roaring bitmap");
+			add_chunk(self, key++, words);
+			i = 0;
+		}
+	}
+	if (i) {
+		memset(words + i, 0, (ROARING_CHUNK_WORDS - i) * sizeof(eword_t));
+		add_chunk(self, key, words);
+	}
+	return self;
+}
+
+struct ewah_bitmap *roaring_to_ewah(const struct roaring_bitmap *self)
+{
+	struct ewah_bitmap *ewah = ewah_new();
+	eword_t words[ROARING_CHUNK_WORDS];
+	size_t empty = 0, i, j;
+	uint32_t next_key = 0;
+
+	for (i = 0; i < self->nr; i++) {
+		const struct roaring_container *c = &self->containers[i];
+
+		empty += (size_t)(c->key - next_key) * ROARING_CHUNK_WORDS;
+		next_key = c->key + 1;
+
+		container_words(c, words);
+		for (j = 0; j < ROARING_CHUNK_WORDS; j++) {
+			if (!words[j]) {
+				empty++;
+				continue;
+			}
+			if (empty) {
+				ewah_add_empty_words(ewah, 0, empty);
+				empty = 0;
+			}
+			ewah_add(ewah, words[j]);
+		}
+	}
+	return ewah;
+}
+
+void roaring_xor(const struct roaring_bitmap *a, const struct roaring_bitmap *b,
+		 struct roaring_bitmap *out)
+{
+	eword_t words[ROARING_CHUNK_WORDS];
+	size_t i = 0, j = 0;
+
+	while (i < a->nr || j < b->nr) {
+		const struct roaring_container *ca = i < a->nr ? &a->containers[i] : NULL;
+		const struct roaring_container *cb = j < b->nr ? &b->containers[j] : NULL;
+
+		if (!cb || (ca && ca->key < cb->key)) {
+			copy_container(out, ca);
+			i++;
+		} else if (!ca || cb->key < ca->key) {
+			copy_container(out, cb);
+			j++;
+		} else {
+			container_words(ca, words);
+			container_apply(cb, words, ROARING_CHUNK_WORDS, ROARING_OP_XOR);
+			add_chunk(out, ca->key, words);
+			i++;
+			j++;
+		}
+	}
+}
+
+/*
+ * Append an array container for the chunk of "arr" holding the values
+ * of "arr" that are (if "want" is set) or are not (otherwise) in
+ * "other", a container for the same chunk. Both are sorted, so they
+ * are walked side by side.
+ */
+static void filter_array(struct roaring_bitmap *out,
+			 const struct roaring_container *arr,
+			 const struct roaring_container *other, int want)
+{
+	const uint16_t *values = arr->data;
+	struct roaring_container *c;
+	uint16_t *result;
+	uint32_t i, j = 0, n = 0;
+
+	ALLOC_ARRAY(result, arr->nr);
+	for (i = 0; i < arr->nr; i++) {
+		uint16_t v = values[i];
+		int present;
+
+		switch (other->type) {
+		case ROARING_ARRAY: {
+			const uint16_t *o = other->data;
+
+			while (j < other->nr && o[j] < v)
+				j++;
+			present = j < other->nr && o[j] == v;
+			break;
+		}
+		case ROARING_RUN: {
+			const struct roaring_run *runs = other->data;
+
+			while (j < other->nr &&
+			       runs[j].start + runs[j].length < v)
+				j++;
+			present = j < other->nr && runs[j].start <= v;
+			break;
+		}
+		case ROARING_BITSET: {
+			const eword_t *words = other->data;
+
+			present = !!(words[v / BITS_IN_EWORD] &
+				     ((eword_t)1 << (v % BITS_IN_EWORD)));
+			break;
+		}
+		default:
+			BUG("unknown roaring container type %d", other->type);
+		}
+		if (present == want)
+			result[n++] = v;
+	}
+
+	if (!n) {
+		free(result);
+		return;
+	}
+	c = append_container(out, arr->key);
+	c->type = ROARING_ARRAY;
+	c->nr = n;
+	c->data = result;
+}
+
+void roaring_and(const struct roaring_bitmap *a, const struct roaring_bitmap *b,
+		 struct roaring_bitmap *out)
+{
+	eword_t words[ROARING_CHUNK_WORDS], other[ROARING_CHUNK_WORDS];
+	size_t i = 0, j = 0, k;
+
+	while (i < a->nr && j < b->nr) {
+		const struct roaring_container *ca = &a->containers[i];
+		const struct roaring_container *cb = &b->containers[j];
+		const eword_t *src;
+
+		if (ca->key < cb->key) {
+			i++;
+			continue;
+		} else if (cb->key < ca->key) {
+			j++;
+			continue;
+		}
+
+		if (ca->type == ROARING_ARRAY)
+			filter_array(out, ca, cb, 1);
+		else if (cb->type == ROARING_ARRAY)
+			filter_array(out, cb, ca, 1);
+		else {
+			container_words(ca, words);
+			if (cb->type == ROARING_BITSET)
+				src = cb->data;
+			else {
+				container_words(cb, other);
+				src = other;
+			}
+			for (k = 0; k < ROARING_CHUNK_WORDS; k++)
+				words[k] &= src[k];
+			add_chunk(out, ca->key, words);
+		}
+		i++;
+		j++;
+	}
+}
+
+void roaring_and_not(const struct roaring_bitmap *a, const struct roaring_bitmap *b,
+		     struct roaring_bitmap *out)
+{
+	eword_t words[ROARING_CHUNK_WORDS];
+	size_t i, j = 0;
+
+	for (i = 0; i < a->nr; i++) {
+		const struct roaring_container *ca = &a->containers[i];
+		const struct roaring_container *cb;
+
+		while (j < b->nr && b->containers[j].key < ca->key)
+			j++;
+		if (j == b->nr || b->containers[j].key != ca->key) {
+			copy_container(out, ca);
+			continue;
+		}
+		cb = &b->containers[j];
+
+		if (ca->type == ROARING_ARRAY)
+			filter_array(out, ca, cb, 0);
+		else {
+			container_words(ca, words);
+			container_apply(cb, words, ROARING_CHUNK_WORDS,
+					ROARING_OP_ANDNOT);
+			add_chunk(out, ca->key, words);
+		}
+	}
+}
+
+void bitmap_or_roaring(struct bitmap *self, const struct roaring_bitmap *other)
+{
+	size_t original_size = self->word_alloc;
+	size_t other_final, i;
+
+	if (!other->nr)
+		return;
+
+	other_final = (size_t)other->containers[other->nr - 1].key * ROARING_CHUNK_WORDS +
+		container_last_word(&other->containers[other->nr - 1]) + 1;
+	if (self->word_alloc < other_final) {
+		self->word_alloc = other_final;
+		REALLOC_ARRAY(self->words, self->word_alloc);
+		memset(self->words + original_size, 0x0,
+		       (self->word_alloc - original_size) * sizeof(eword_t));
+	}
+
+	for (i = 0; i < other->nr; i++) {
+		const struct roaring_container *c = &other->containers[i];
+		size_t base = (size_t)c->key * ROARING_CHUNK_WORDS;
+
+		container_apply(c, self->words + base, self->word_alloc - base,
+				ROARING_OP_OR);
+	}
+}
+
+int roaring_get(const struct roaring_bitmap *self, size_t pos)
+{
+	uint16_t key, low = pos % ROARING_CHUNK_BITS;
+	const struct roaring_container *c = NULL;
+	size_t lo = 0, hi = self->nr;
+	uint32_t i;
+
+	if (pos / ROARING_CHUNK_BITS > 0xffff)
+		return 0;
+	key = pos / ROARING_CHUNK_BITS;
+
+	while (lo < hi) {
+		size_t mi = lo + (hi - lo) / 2;
+
+		if (self->containers[mi].key == key) {
+			c = &self->containers[mi];
+			break;
+		}
+		if (self->containers[mi].key < key)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+	if (!c)
+		return 0;
+
+	switch (c->type) {
+	case ROARING_ARRAY: {
+		const uint16_t *values = c->data;
+
+		lo = 0;
+		hi = c->nr;
+		while (lo < hi) {
+			size_t mi = lo + (hi - lo) / 2;
+
+			if (values[mi] == low)
+				return 1;
+			if (values[mi] < low)
+				lo = mi + 1;
+			else
+				hi = mi;
+		}
+		return 0;
+	}
+	case ROARING_RUN: {
+		const struct roaring_run *runs = c->data;
+
+		for (i = 0; i < c->nr && runs[i].start <= low; i++)
+			if (low <= runs[i].start + runs[i].length)
+				return 1;
+		return 0;
+	}
+	case ROARING_BITSET: {
+		const eword_t *words = c->data;
+
+		return !!(words[low / BITS_IN_EWORD] &
+			  ((eword_t)1 << (low % BITS_IN_EWORD)));
+	}
+	default:
+		BUG("unknown roaring container type %d", c->type);
+	}
+}
+
+int roaring_serialize_to(struct roaring_bitmap *self,
+			 int (*write_fun)(void *, const void *, size_t),
+			 void *data)
+{
+	eword_t dump[ROARING_CHUNK_WORDS];
+	size_t i, j, total = 0;
+
+	/* 32 bit -- number of containers */
+	put_be32(dump, self->nr);
+	if (write_fun(data, dump, 4) != 4)
+		return -1;
+	total += 4;
+
+	/* 16 bit key, 16 bit type, 32 bit count -- for each container */
+	for (i = 0; i < self->nr; i++) {
+		const struct roaring_container *c = &self->containers[i];
+
+		put_be32(dump, (uint32_t)c->key << 16 | c->type);
+		put_be32((unsigned char *)dump + 4, c->nr);
+		if (write_fun(data, dump, 8) != 8)
+			return -1;
+		total += 8;
+	}
+
+	/* then the contents of each container */
+	for (i = 0; i < self->nr; i++) {
+		const struct roaring_container *c = &self->containers[i];
+		size_t len = container_bytes(c);
+
+		switch (c->type) {
+		case ROARING_ARRAY: {
+			const uint16_t *values = c->data;
+			uint16_t *out = (uint16_t *)dump;
+			for (j = 0; j < c->nr; j++)
+				out[j] = htons(values[j]);
+			break;
+		}
+		case ROARING_RUN: {
+			const struct roaring_run *runs = c->data;
+			uint16_t *out = (uint16_t *)dump;
+			for (j = 0; j < c->nr; j++) {
+				out[2 * j] = htons(runs[j].start);
+				out[2 * j + 1] = htons(runs[j].length);
+			}
+			break;
+		}
+		case ROARING_BITSET: {
+			const eword_t *words = c->data;
+			for (j = 0; j < ROARING_CHUNK_WORDS; j++)
+				dump[j] = htonll(words[j]);
+			break;
+		}
+		}
+
+		if (write_fun(data, dump, len) != len)
+			return -1;
+		total += len;
+	}
+
+	return total;
+}
+
+ssize_t roaring_read_mmap(struct roaring_bitmap *self, const void *map, size_t len)
+{
+	const uint8_t *ptr = map, *headers;
+	uint32_t nr, i, j;
+
+	if (len < 4)
+		return error("corrupt roaring bitmap: eof before container count");
+	nr = get_be32(ptr);
+	ptr += 4;
+	len -= 4;
+
+	if (len / 8 < nr)
+		return error("corrupt roaring bitmap: eof in container headers");
+	headers = ptr;
+	ptr += st_mult(nr, 8);
+	len -= st_mult(nr, 8);
+
+	ALLOC_GROW(self->containers, nr, self->alloc);
+	for (i = 0; i < nr; i++) {
+		struct roaring_container *c;
+		uint16_t key = get_be16(headers + 8 * i);
+		size_t bytes;
+
+		if (i && key <= self->containers[i - 1].key)
+			return error("corrupt roaring bitmap: containers out of order");
+
+		c = append_container(self, key);
+		c->type = get_be16(headers + 8 * i + 2);
+		c->nr = get_be32(headers + 8 * i + 4);
+
+		if (c->type != ROARING_ARRAY && c->type != ROARING_RUN &&
+		    c->type != ROARING_BITSET)
+			return error("corrupt roaring bitmap: unknown container type %u",
+				     (unsigned)c->type);
+		if (!c->nr || c->nr > ROARING_CHUNK_BITS)
+			return error("corrupt roaring bitmap: bad container size");
+
+		bytes = container_bytes(c);
+		if (len < bytes)
+			return error("corrupt roaring bitmap: eof in container data");
+
+		switch (c->type) {
+		case ROARING_ARRAY: {
+			uint16_t *values;
+
+			ALLOC_ARRAY(values, c->nr);
+			c->data = values;
+			for (j = 0; j < c->nr; j++) {
+				values[j] = get_be16(ptr + 2 * j);
+				if (j && values[j] <= values[j - 1])
+					return error("corrupt roaring bitmap: unsorted array container");
+			}
+			break;
+		}
+		case ROARING_RUN: {
+			struct roaring_run *runs;
+
+			ALLOC_ARRAY(runs, c->nr);
+			c->data = runs;
+			for (j = 0; j < c->nr; j++) {
+				runs[j].start = get_be16(ptr + 4 * j);
+				runs[j].length = get_be16(ptr + 4 * j + 2);
+				if ((uint32_t)runs[j].start + runs[j].length >= ROARING_CHUNK_BITS ||
+				    (j && runs[j].start <= runs[j - 1].start + runs[j - 1].length))
+					return error("corrupt roaring bitmap: bad run container");
+			}
+			break;
+		}
+		case ROARING_BITSET: {
+			eword_t *words;
+			int any = 0;
+
+			ALLOC_ARRAY(words, ROARING_CHUNK_WORDS);
+			c->data = words;
+			for (j = 0; j < ROARING_CHUNK_WORDS; j++) {
+				words[j] = get_be64(ptr + 8 * j);
+				any |= !!words[j];
+			}
+			if (!any)
+				return error("corrupt roaring bitmap: empty bitset container");
+			break;
+		}
+		}
+
+		ptr += bytes;
+		len -= bytes;
+	}
+
+	return ptr - (const uint8_t *)map;
+}
@@ -18,6 +18,7 @@
 #include "setup.h"
 #include "strvec.h"
 #include "bloom.h"
+#include "strmap.h"
 
 static void range_set_grow(struct range_set *rs, size_t extra)
 {
@@ -1147,12 +1148,34 @@ int line_log_print(struct rev_info *rev, struct commit *commit)
 	return 1;
 }
 
+/*
+ * The same few paths are checked against the filter of every commit,
+ * so hash each of them only once.
+ */
+static struct bloom_keyvec *bloom_keyvec_for_path(struct rev_info *rev,
+						  const char *path)
+{
+	struct bloom_keyvec *vec;
+
+	if (!rev->line_log_bloom_keys) {
+		CALLOC_ARRAY(rev->line_log_bloom_keys, 1);
+		strmap_init(rev->line_log_bloom_keys);
+	}
+
+	vec = strmap_get(rev->line_log_bloom_keys, path);
+	if (!vec) {
+		vec = bloom_keyvec_new(path, strlen(path),
+				       rev->bloom_filter_settings);
+		strmap_put(rev->line_log_bloom_keys, path, vec);
+	}
+	return vec;
+}
+
 static int bloom_filter_check(struct rev_info *rev,
 			      struct commit *commit,
 			      struct line_log_data *range)
 {
 	struct bloom_filter *filter;
-	struct bloom_key key;
 	int result = 0;
 
 	if (!commit->parents)
@@ -1166,12 +1189,11 @@ static int bloom_filter_check(struct rev_info *rev,
 		return 0;
 
 	while (!result && range) {
-		fill_bloom_key(range->path, strlen(range->path), &key, rev->bloom_filter_settings);
-
-		if (bloom_filter_contains(filter, &key, rev->bloom_filter_settings))
+		if (bloom_filter_contains_vec(filter,
+					      bloom_keyvec_for_path(rev, range->path),
+					      rev->bloom_filter_settings))
 			result = 1;
 
-		clear_bloom_key(&key);
 		range = range->next;
 	}
 
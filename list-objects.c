@@ -14,6 +14,12 @@
 #include "packfile.h"
 #include "object-store.h"
 #include "trace.h"
+#include "trace2.h"
+#include "oidmap.h"
+#include "prio-queue.h"
+#include "thread-utils.h"
+
+struct tree_prefetch;
 
 struct traversal_context {
 	struct rev_info *revs;
@@ -21,8 +27,304 @@ struct traversal_context {
 	show_commit_fn show_commit;
 	void *show_data;
 	struct filter *filter;
+	struct tree_prefetch *prefetch;
+};
+
+/*
+ * With revs->traverse_threads, worker threads read the trees reachable
+ * from the pending objects ahead of traverse_non_commits(), depth
+ * first and in the order of the pending objects it processes them in.
+ * The traversal itself stays in the main thread and picks up the
+ * buffers as it reaches each tree, so the objects are shown in the
+ * same order as without the threads.
+ *
+ * The trees are read without looking at object flags, which the
+ * traversal may be changing at the same time; a tree the traversal
+ * ends up skipping is simply dropped once the traversal has moved
+ * past the pending object it was found under.
+ */
+enum prefetch_state {
+	PREFETCH_QUEUED,
+	PREFETCH_READING,
+	PREFETCH_READY,
+	PREFETCH_DONE,
+};
+
+struct prefetched_tree {
+	struct oidmap_entry entry;
+	enum prefetch_state state;
+	/* index of the pending object this tree was found under */
+	int root;
+	unsigned ctr;
+	void *buffer;
+	unsigned long size;
+	struct prefetched_tree *next_in_root;
 };
 
+struct tree_prefetch {
+	struct repository *repo;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t ready_cond;
+	/* all trees seen so far, which the threads share as a seen-set */
+	struct oidmap trees;
+	/* the trees to read, lowest root first, then depth first */
+	struct prio_queue queue;
+	unsigned ctr;
+	struct prefetched_tree **roots;
+	int nr_roots;
+	/* the pending object the traversal is at */
+	int current_root;
+	size_t buffered;
+	int idle_threads;
+	int traversal_waiting;
+	int stop;
+	int nr_threads;
+	pthread_t *threads;
+};
+
+/* How much tree data may be read ahead of the traversal. */
+#define TREE_PREFETCH_LIMIT (64 * 1024 * 1024)
+
+static int prefetch_cmp(const void *a_, const void *b_, void *data UNUSED)
+{
+	const struct prefetched_tree *a = a_, *b = b_;
+
+	if (a->root != b->root)
+		return a->root < b->root ? -1 : 1;
+	/* the most recently found subtree first */
+	return a->ctr > b->ctr ? -1 : a->ctr < b->ctr;
+}
+
+/* Must be called with the mutex held. */
+static void prefetch_add(struct tree_prefetch *pf,
+			 const struct object_id *oid, int root,
+			 enum prefetch_state state)
+{
+	struct prefetched_tree *t;
+
+	if (oidmap_get(&pf->trees, oid))
+		return;
+
+	CALLOC_ARRAY(t, 1);
+	oidcpy(&t->entry.oid, oid);
+	t->state = state;
+	t->root = root;
+	t->ctr = pf->ctr++;
+	oidmap_put(&pf->trees, t);
+	if (root < pf->nr_roots) {
+		t->next_in_root = pf->roots[root];
+		pf->roots[root] = t;
+	}
+	if (state == PREFETCH_QUEUED)
+		prio_queue_put(&pf->queue, t);
+}
+
+static void *prefetch_thread(void *data)
+{
+	struct tree_prefetch *pf = data;
+	struct oid_array subtrees = OID_ARRAY_INIT;
+
+	trace2_thread_start("prefetch_tree");
+	pthread_mutex_lock(&pf->mutex);
+	while (!pf->stop) {
+		struct prefetched_tree *t = prio_queue_peek(&pf->queue);
+		enum object_type type;
+		struct tree_desc desc;
+		struct name_entry entry;
+		void *buffer;
+		unsigned long size;
+		size_t i;
+
+		if (!t || pf->buffered > TREE_PREFETCH_LIMIT) {
+			pf->idle_threads++;
+			pthread_cond_wait(&pf->work_cond, &pf->mutex);
+			pf->idle_threads--;
+			continue;
+		}
+		prio_queue_get(&pf->queue);
+		if (t->state != PREFETCH_QUEUED)
+			continue;
+		if (t->root < pf->current_root) {
+			t->state = PREFETCH_DONE;
+			continue;
+		}
+		t->state = PREFETCH_READING;
+		pthread_mutex_unlock(&pf->mutex);
+
+		buffer = repo_read_object_file(pf->repo, &t->entry.oid,
+					       &type, &size);
+		if (buffer && type != OBJ_TREE)
+			FREE_AND_NULL(buffer);
+		if (buffer &&
+		    !init_tree_desc_gently(&desc, buffer, size, 0)) {
+			while (tree_entry_gently(&desc, &entry))
+				if (S_ISDIR(entry.mode))
+					oid_array_append(&subtrees, &entry.oid);
+		}
+
+		pthread_mutex_lock(&pf->mutex);
+		if (buffer) {
+			t->buffer = buffer;
+			t->size = size;
+			t->state = PREFETCH_READY;
+			pf->buffered += size;
+		} else {
+			/* let the traversal report the error */
+			t->state = PREFETCH_DONE;
+		}
+		for (i = 0; i < subtrees.nr; i++)
+			prefetch_add(pf, &subtrees.oid[i], t->root,
+				     PREFETCH_QUEUED);
+		oid_array_clear(&subtrees);
+		if (pf->traversal_waiting)
+			pthread_cond_signal(&pf->ready_cond);
+		if (pf->idle_threads && pf->queue.nr)
+			pthread_cond_signal(&pf->work_cond);
+	}
+	pthread_mutex_unlock(&pf->mutex);
+	trace2_thread_exit();
+	return NULL;
+}
+
+/*
+ * Hand the prefetched buffer of a tree over to the traversal, or
+ * return NULL if it has to read the tree itself.
+ */
+static void *prefetch_take(struct tree_prefetch *pf,
+			   const struct object_id *oid, unsigned long *size)
+{
+	struct prefetched_tree *t;
+	void *buffer = NULL;
+
+	pthread_mutex_lock(&pf->mutex);
+	t = oidmap_get(&pf->trees, oid);
+	if (!t) {
+		/* make sure nobody reads it later on */
+		prefetch_add(pf, oid, pf->current_root, PREFETCH_DONE);
+	} else {
+		while (t->state == PREFETCH_READING) {
+			pf->traversal_waiting = 1;
+			pthread_cond_wait(&pf->ready_cond, &pf->mutex);
+			pf->traversal_waiting = 0;
+		}
+		if (t->state == PREFETCH_READY) {
+			buffer = t->buffer;
+			*size = t->size;
+			t->buffer = NULL;
+			pf->buffered -= t->size;
+			if (pf->idle_threads &&
+			    pf->buffered + t->size > TREE_PREFETCH_LIMIT)
+				pthread_cond_broadcast(&pf->work_cond);
+		}
+		t->state = PREFETCH_DONE;
+	}
+	pthread_mutex_unlock(&pf->mutex);
+	return buffer;
+}
+
+/*
+ * The traversal moves on to the pending object "root"; drop whatever
+ * was read for the ones before it but not used.
+ */
+static void prefetch_advance(struct tree_prefetch *pf, int root)
+{
+	size_t buffered;
+	int i;
+
+	pthread_mutex_lock(&pf->mutex);
+	buffered = pf->buffered;
+	for (i = pf->current_root; i < root && i < pf->nr_roots; i++) {
+		struct prefetched_tree *t;
+
+		for (t = pf->roots[i]; t; t = t->next_in_root) {
+			if (t->state != PREFETCH_READY)
+				continue;
+			FREE_AND_NULL(t->buffer);
+			pf->buffered -= t->size;
+			t->state = PREFETCH_DONE;
+		}
+		pf->roots[i] = NULL;
+	}
+	pf->current_root = root;
+	if (pf->idle_threads && buffered > TREE_PREFETCH_LIMIT &&
+	    pf->buffered <= TREE_PREFETCH_LIMIT)
+		pthread_cond_broadcast(&pf->work_cond);
+	pthread_mutex_unlock(&pf->mutex);
+}
+
+static struct tree_prefetch *start_tree_prefetch(struct traversal_context *ctx)
+{
+	struct rev_info *revs = ctx->revs;
+	struct tree_prefetch *pf;
+	int i;
+
+	if (!HAVE_THREADS || revs->traverse_threads <= 1 ||
+	    !revs->tree_objects || ctx->filter ||
+	    revs->diffopt.pathspec.nr || obj_read_use_lock)
+		return NULL;
+
+	CALLOC_ARRAY(pf, 1);
+	pf->repo = revs->repo;
+	pthread_mutex_init(&pf->mutex, NULL);
+	pthread_cond_init(&pf->work_cond, NULL);
+	pthread_cond_init(&pf->ready_cond, NULL);
+	oidmap_init(&pf->trees, 0);
+	pf->queue.compare = prefetch_cmp;
+	pf->nr_roots = revs->pending.nr;
+	CALLOC_ARRAY(pf->roots, pf->nr_roots);
+
+	for (i = 0; i < revs->pending.nr; i++) {
+		struct object *obj = revs->pending.objects[i].item;
+
+		if (obj->type != OBJ_TREE ||
+		    (obj->flags & (UNINTERESTING | SEEN)))
+			continue;
+		prefetch_add(pf, &obj->oid, i, PREFETCH_QUEUED);
+	}
+
+	enable_obj_read_lock();
+	pf->nr_threads = revs->traverse_threads;
+	CALLOC_ARRAY(pf->threads, pf->nr_threads);
+	for (i = 0; i < pf->nr_threads; i++) {
+		int err = pthread_create(&pf->threads[i], NULL,
+					 prefetch_thread, pf);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+	}
+	return pf;
+}
+
+static void stop_tree_prefetch(struct tree_prefetch *pf)
+{
+	struct oidmap_iter iter;
+	struct prefetched_tree *t;
+	int i;
+
+	if (!pf)
+		return;
+
+	pthread_mutex_lock(&pf->mutex);
+	pf->stop = 1;
+	pthread_cond_broadcast(&pf->work_cond);
+	pthread_mutex_unlock(&pf->mutex);
+	for (i = 0; i < pf->nr_threads; i++)
+		pthread_join(pf->threads[i], NULL);
+	disable_obj_read_lock();
+
+	oidmap_iter_init(&pf->trees, &iter);
+	while ((t = oidmap_iter_next(&iter)))
+		free(t->buffer);
+	oidmap_free(&pf->trees, 1);
+	clear_prio_queue(&pf->queue);
+	pthread_cond_destroy(&pf->ready_cond);
+	pthread_cond_destroy(&pf->work_cond);
+	pthread_mutex_destroy(&pf->mutex);
+	free(pf->roots);
+	free(pf->threads);
+	free(pf);
+}
+
 static void show_commit(struct traversal_context *ctx,
 			struct commit *commit)
 {
@@ -156,6 +458,12 @@ static void process_tree(struct traversal_context *ctx,
 	    !revs->include_check_obj(&tree->object, revs->include_check_data))
 		return;
 
+	if (ctx->prefetch && !obj->parsed) {
+		unsigned long size;
+		void *buffer = prefetch_take(ctx->prefetch, &obj->oid, &size);
+		if (buffer)
+			parse_tree_buffer(tree, buffer, size);
+	}
 	failed_parse = parse_tree_gently(tree, 1);
 	if (failed_parse) {
 		if (revs->ignore_missing_links)
@@ -340,6 +648,8 @@ static void traverse_non_commits(struct traversal_context *ctx,
 		struct object *obj = pending->item;
 		const char *name = pending->name;
 		const char *path = pending->path;
+		if (ctx->prefetch)
+			prefetch_advance(ctx->prefetch, i);
 		if (obj->flags & (UNINTERESTING | SEEN))
 			continue;
 		if (obj->type == OBJ_TAG) {
@@ -404,7 +714,10 @@ static void do_traverse(struct traversal_context *ctx)
 			 */
 			traverse_non_commits(ctx, &csp);
 	}
+	ctx->prefetch = start_tree_prefetch(ctx);
 	traverse_non_commits(ctx, &csp);
+	stop_tree_prefetch(ctx->prefetch);
+	ctx->prefetch = NULL;
 	strbuf_release(&csp);
 }
 
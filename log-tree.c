@@ -1,4 +1,5 @@
 #include "git-compat-util.h"
+#include "bloom.h"
 #include "commit-reach.h"
 #include "config.h"
 #include "diff.h"
@@ -638,6 +639,62 @@ static void next_commentary_block(struct rev_info *opt, struct strbuf *sb)
 	opt->shown_dashes = 1;
 }
 
+static void init_log_pretty_context(struct rev_info *opt,
+				    struct pretty_print_context *ctx)
+{
+	ctx->date_mode = opt->date_mode;
+	ctx->date_mode_explicit = opt->date_mode_explicit;
+	ctx->abbrev = opt->diffopt.abbrev;
+	ctx->preserve_subject = opt->preserve_subject;
+	ctx->encode_email_headers = opt->encode_email_headers;
+	ctx->reflog_info = opt->reflog_info;
+	ctx->fmt = opt->commit_format;
+	ctx->mailmap = opt->mailmap;
+	ctx->color = opt->diffopt.use_color;
+	ctx->expand_tabs_in_log = opt->expand_tabs_in_log;
+	ctx->output_encoding = get_log_output_encoding();
+	ctx->rev = opt;
+}
+
+int log_tree_can_preformat(struct rev_info *opt)
+{
+	struct userformat_want w = { 0 };
+
+	/*
+	 * Everything that show_log() adds around the message, or that
+	 * goes into it from state other than the commit itself (notes,
+	 * signatures, decorations, reflogs, the graph), must stay on
+	 * the main thread.
+	 */
+	if (!opt->verbose_header || cmit_fmt_is_mail(opt->commit_format) ||
+	    opt->graph || opt->show_notes || opt->show_signature ||
+	    opt->reflog_info || opt->sources || opt->rewrite_parents ||
+	    opt->children.name || opt->track_linear || opt->boundary)
+		return 0;
+
+	/* Highlighting --grep matches shares the compiled patterns. */
+	if (want_color(opt->diffopt.use_color) &&
+	    (opt->grep_filter.pattern_list || opt->grep_filter.header_list))
+		return 0;
+
+	if (opt->commit_format == CMIT_FMT_USERFORMAT) {
+		userformat_find_requirements(NULL, &w);
+		if (w.notes || w.source || w.decorate || w.serial)
+			return 0;
+	}
+	return 1;
+}
+
+void log_tree_format_message(struct rev_info *opt, struct commit *commit,
+			     struct strbuf *out)
+{
+	struct pretty_print_context ctx = {0};
+
+	init_log_pretty_context(opt, &ctx);
+	ctx.after_subject = opt->extra_headers;
+	pretty_print_commit(&ctx, commit, out);
+}
+
 void show_log(struct rev_info *opt)
 {
 	struct strbuf msgbuf = STRBUF_INIT;
@@ -771,24 +828,16 @@ void show_log(struct rev_info *opt)
 	if (ctx.need_8bit_cte >= 0 && opt->add_signoff)
 		ctx.need_8bit_cte =
 			has_non_ascii(fmt_name(WANT_COMMITTER_IDENT));
-	ctx.date_mode = opt->date_mode;
-	ctx.date_mode_explicit = opt->date_mode_explicit;
-	ctx.abbrev = opt->diffopt.abbrev;
+	init_log_pretty_context(opt, &ctx);
 	ctx.after_subject = extra_headers;
-	ctx.preserve_subject = opt->preserve_subject;
-	ctx.encode_email_headers = opt->encode_email_headers;
-	ctx.reflog_info = opt->reflog_info;
-	ctx.fmt = opt->commit_format;
-	ctx.mailmap = opt->mailmap;
-	ctx.color = opt->diffopt.use_color;
-	ctx.expand_tabs_in_log = opt->expand_tabs_in_log;
-	ctx.output_encoding = get_log_output_encoding();
-	ctx.rev = opt;
 	if (opt->from_ident.mail_begin && opt->from_ident.name_begin)
 		ctx.from_ident = &opt->from_ident;
 	if (opt->graph)
 		ctx.graph_width = graph_width(opt->graph);
-	pretty_print_commit(&ctx, commit, &msgbuf);
+	if (opt->preformatted_msg)
+		strbuf_addbuf(&msgbuf, opt->preformatted_msg);
+	else
+		pretty_print_commit(&ctx, commit, &msgbuf);
 
 	if (opt->add_signoff)
 		append_signoff(&msgbuf, 0, APPEND_SIGNOFF_DEDUP);
@@ -1027,6 +1076,45 @@ static int do_remerge_diff(struct rev_info *opt,
 	return !opt->loginfo;
 }
 
+/*
+ * With --follow, history is not pruned, so every commit gets diffed
+ * against its parent just to find that it does not touch the followed
+ * path. Ask the changed-path Bloom filter first: when it rules the path
+ * out, the diff would be empty, and try_to_follow_renames() would not
+ * look for a rename either.
+ */
+static int follow_path_may_change(struct rev_info *opt, struct commit *commit)
+{
+	struct pathspec_item *pi;
+	struct bloom_filter *filter;
+
+	if (!opt->diffopt.flags.follow_renames ||
+	    !opt->bloom_filter_settings ||
+	    opt->diffopt.pathspec.nr != 1)
+		return 1;
+
+	pi = &opt->diffopt.pathspec.items[0];
+	if (pi->nowildcard_len < pi->len || !pi->len ||
+	    pi->match[pi->len - 1] == '/')
+		return 1;
+
+	filter = get_bloom_filter(opt->repo, commit);
+	if (!filter)
+		return 1;
+
+	/* The followed path changes whenever a rename is found. */
+	if (!opt->follow_bloom_path || strcmp(opt->follow_bloom_path, pi->match)) {
+		bloom_keyvec_free(opt->follow_bloom_keyvec);
+		free(opt->follow_bloom_path);
+		opt->follow_bloom_path = xstrdup(pi->match);
+		opt->follow_bloom_keyvec = bloom_keyvec_new(pi->match, pi->len,
+							    opt->bloom_filter_settings);
+	}
+
+	return bloom_filter_contains_vec(filter, opt->follow_bloom_keyvec,
+					 opt->bloom_filter_settings);
+}
+
 /*
  * Show the diff of a commit.
  *
@@ -1084,6 +1172,9 @@ static int log_tree_diff(struct rev_info *opt, struct commit *commit, struct log
 			return 0;
 	}
 
+	if (!is_merge && !follow_path_may_change(opt, commit))
+		return 0;
+
 	showed_log = 0;
 	for (;;) {
 		struct commit *parent = parents->item;
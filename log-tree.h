@@ -17,6 +17,16 @@ int parse_decorate_color_config(const char *var, const char *slot_name, const ch
 int log_tree_diff_flush(struct rev_info *);
 int log_tree_commit(struct rev_info *, struct commit *);
 void show_log(struct rev_info *opt);
+
+/*
+ * Return whether the messages shown by show_log() for "opt" may be
+ * produced ahead of time with log_tree_format_message(), which is then
+ * safe to call for different commits from several threads at once, as
+ * long as nothing else touches the object store or the commits.
+ */
+int log_tree_can_preformat(struct rev_info *opt);
+void log_tree_format_message(struct rev_info *opt, struct commit *commit,
+			     struct strbuf *out);
 void format_decorations_extended(struct strbuf *sb, const struct commit *commit,
 			     int use_color,
 			     const char *prefix,
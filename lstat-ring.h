@@ -0,0 +1,57 @@
+#ifndef LSTAT_RING_H
+#define LSTAT_RING_H
+
+/*
+ * A batch of lstat() calls that are all in flight at the same time,
+ * instead of each waiting for the previous one. This hides the latency
+ * of each call on network filesystems and with cold caches.
+ *
+ * This is only available when built with HAVE_IO_URING, and even then
+ * the kernel may not support it or may not allow it: callers must be
+ * ready for lstat_ring_new() to return NULL and use lstat() instead.
+ */
+struct lstat_ring;
+
+#ifdef HAVE_IO_URING
+
+/*
+ * Create a ring able to run up to "depth" lstat() calls at a time, or
+ * return NULL if it cannot be used.
+ */
+struct lstat_ring *lstat_ring_new(unsigned int depth);
+
+/*
+ * lstat() the "nr" paths, which must not be more than the depth of the
+ * ring, into the corresponding "st". ret[i] is set to 0 if paths[i]
+ * could be lstat()ed, or to a negative errno value.
+ *
+ * Returns 0 on success, or -1 if the ring failed before any call was
+ * started; the ring should then be freed and lstat() used instead.
+ */
+int lstat_ring_run(struct lstat_ring *ring, unsigned int nr,
+		   const char **paths, struct stat *st, int *ret);
+
+void lstat_ring_free(struct lstat_ring *ring);
+
+#else
+
+static inline struct lstat_ring *lstat_ring_new(unsigned int depth UNUSED)
+{
+	return NULL;
+}
+
+static inline int lstat_ring_run(struct lstat_ring *ring UNUSED,
+				 unsigned int nr UNUSED,
+				 const char **paths UNUSED,
+				 struct stat *st UNUSED, int *ret UNUSED)
+{
+	return -1;
+}
+
+static inline void lstat_ring_free(struct lstat_ring *ring UNUSED)
+{
+}
+
+#endif
+
+#endif /* LSTAT_RING_H */
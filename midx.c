@@ -236,7 +236,9 @@ int prepare_midx_pack(struct repository *r, struct multi_pack_index *m, uint32_t
 	p->multi_pack_index = 1;
 	m->packs[pack_int_id] = p;
 	install_packed_git(r, p);
+	packed_git_lock();
 	list_add_tail(&p->mru, &r->objects->packed_git_mru);
+	packed_git_unlock();
 
 	return 0;
 }
@@ -1152,6 +1154,9 @@ static int write_midx_bitmap(const char *midx_name,
 	if (flags & MIDX_WRITE_BITMAP_LOOKUP_TABLE)
 		options |= BITMAP_OPT_LOOKUP_TABLE;
 
+	if (flags & MIDX_WRITE_BITMAP_ROARING)
+		options |= BITMAP_OPT_ROARING;
+
 	/*
 	 * Build the MIDX-order index based on pdata.objects (which is already
 	 * in MIDX order; c.f., 'midx_pack_order_cmp()' for the definition of
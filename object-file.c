@@ -1541,6 +1541,7 @@ void enable_obj_read_lock(void)
 
 	obj_read_use_lock = 1;
 	init_recursive_mutex(&obj_read_mutex);
+	init_pack_locks();
 }
 
 void disable_obj_read_lock(void)
@@ -1550,6 +1551,7 @@ void disable_obj_read_lock(void)
 
 	obj_read_use_lock = 0;
 	pthread_mutex_destroy(&obj_read_mutex);
+	destroy_pack_locks();
 }
 
 int fetch_if_missing = 1;
@@ -1646,7 +1648,16 @@ static int do_oid_object_info_extended(struct repository *r,
 		 * information below, so return early.
 		 */
 		return 0;
+
+	/*
+	 * Reading from the pack only needs the pack-level locks, which
+	 * packed_object_info() takes as needed, so let other threads
+	 * look up and read objects in the meantime. The pack itself is
+	 * never freed while the object store is in use.
+	 */
+	obj_read_unlock();
 	rtype = packed_object_info(r, e.p, e.offset, oi);
+	obj_read_lock();
 	if (rtype < 0) {
 		mark_bad_packed_object(e.p, real);
 		return do_oid_object_info_extended(r, real, oi, 0);
@@ -410,6 +410,12 @@ void assert_oid_type(const struct object_id *oid, enum object_type expect);
  * following functions in parallel: repo_read_object_file(),
  * read_object_with_reference(), oid_object_info() and oid_object_info_extended().
  *
+ * The object read lock protects the object database as a whole (the list
+ * of packs and alternates, loose objects, etc.). It is not held while
+ * reading an object from a pack: that is protected by finer-grained locks
+ * in packfile.c, so that pack lookups, inflation and delta reconstruction
+ * in different threads run in parallel.
+ *
  * obj_read_lock() and obj_read_unlock() may also be used to protect other
  * section which cannot execute in parallel with object reading. Since the used
  * lock is a recursive mutex, these sections can even contain calls to object
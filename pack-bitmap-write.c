@@ -654,6 +654,15 @@ static inline void dump_bitmap(struct hashfile *f, struct ewah_bitmap *bitmap)
 		die("Failed to write bitmap index");
 }
 
+static void dump_roaring(struct hashfile *f, struct ewah_bitmap *bitmap)
+{
+	struct roaring_bitmap *roaring = ewah_to_roaring(bitmap);
+
+	if (roaring_serialize_to(roaring, hashwrite_ewah_helper, f) < 0)
+		die("Failed to write bitmap index");
+	roaring_free(roaring);
+}
+
 static const struct object_id *oid_access(size_t pos, const void *table)
 {
 	const struct pack_idx_entry * const *index = table;
@@ -661,6 +670,7 @@ static const struct object_id *oid_access(size_t pos, const void *table)
 }
 
 static void write_selected_commits_v1(struct hashfile *f,
+				      uint16_t version,
 				      uint32_t *commit_positions,
 				      off_t *offsets)
 {
@@ -676,7 +686,10 @@ static void write_selected_commits_v1(struct hashfile *f,
 		hashwrite_u8(f, stored->xor_offset);
 		hashwrite_u8(f, stored->flags);
 
-		dump_bitmap(f, stored->write_as);
+		if (version == 2)
+			dump_roaring(f, stored->write_as);
+		else
+			dump_bitmap(f, stored->write_as);
 	}
 }
 
@@ -775,7 +788,7 @@ void bitmap_writer_finish(struct pack_idx_entry **index,
 			  const char *filename,
 			  uint16_t options)
 {
-	static uint16_t default_version = 1;
+	uint16_t version = 1;
 	static uint16_t flags = BITMAP_OPT_FULL_DAG;
 	struct strbuf tmp_file = STRBUF_INIT;
 	struct hashfile *f;
@@ -787,10 +800,15 @@ void bitmap_writer_finish(struct pack_idx_entry **index,
 
 	int fd = odb_mkstemp(&tmp_file, "pack/tmp_bitmap_XXXXXX");
 
+	if (options & BITMAP_OPT_ROARING) {
+		version = 2;
+		options &= ~BITMAP_OPT_ROARING;
+	}
+
 	f = hashfd(fd, tmp_file.buf);
 
 	memcpy(header.magic, BITMAP_IDX_SIGNATURE, sizeof(BITMAP_IDX_SIGNATURE));
-	header.version = htons(default_version);
+	header.version = htons(version);
 	header.options = htons(flags | options);
 	header.entry_count = htonl(writer.selected_nr);
 	hashcpy(header.checksum, writer.pack_checksum);
@@ -816,7 +834,7 @@ void bitmap_writer_finish(struct pack_idx_entry **index,
 		commit_positions[i] = commit_pos;
 	}
 
-	write_selected_commits_v1(f, commit_positions, offsets);
+	write_selected_commits_v1(f, version, commit_positions, offsets);
 
 	if (options & BITMAP_OPT_LOOKUP_TABLE)
 		write_lookup_table(f, commit_positions, offsets);
@@ -21,6 +21,12 @@
 #include "list-objects-filter-options.h"
 #include "midx.h"
 #include "config.h"
+#include "commit-graph.h"
+#include "commit-reach.h"
+#include "commit-slab.h"
+#include "prio-queue.h"
+#include "replace-object.h"
+#include "shallow.h"
 
 /*
  * An entry on the bitmap index, representing the bitmap for a given
@@ -29,6 +35,12 @@
 struct stored_bitmap {
 	struct object_id oid;
 	struct ewah_bitmap *root;
+	/*
+	 * Version 2 indexes store the bitmaps of commits as roaring
+	 * bitmaps; "root" is then only filled in for callers of
+	 * bitmap_for_commit(), which need an EWAH bitmap.
+	 */
+	struct roaring_bitmap *roaring;
 	struct stored_bitmap *xor;
 	int flags;
 };
@@ -118,11 +130,34 @@ struct bitmap_index {
 	unsigned int version;
 };
 
+static struct roaring_bitmap *lookup_stored_roaring(struct stored_bitmap *st)
+{
+	struct roaring_bitmap *composed;
+
+	if (!st->xor)
+		return st->roaring;
+
+	composed = roaring_new();
+	roaring_xor(st->roaring, lookup_stored_roaring(st->xor), composed);
+
+	roaring_free(st->roaring);
+	st->roaring = composed;
+	st->xor = NULL;
+
+	return composed;
+}
+
 static struct ewah_bitmap *lookup_stored_bitmap(struct stored_bitmap *st)
 {
 	struct ewah_bitmap *parent;
 	struct ewah_bitmap *composed;
 
+	if (st->roaring) {
+		if (!st->root)
+			st->root = roaring_to_ewah(lookup_stored_roaring(st));
+		return st->root;
+	}
+
 	if (!st->xor)
 		return st->root;
 
@@ -159,6 +194,40 @@ static struct ewah_bitmap *read_bitmap_1(struct bitmap_index *index)
 	return b;
 }
 
+/*
+ * Read the bitmap of a bitmapped commit from the current read position
+ * into either "ewah" or "roaring", depending on the index version. The
+ * type bitmaps are EWAH bitmaps in both versions, and are read with
+ * read_bitmap_1().
+ */
+static int read_commit_bitmap(struct bitmap_index *index,
+			      struct ewah_bitmap **ewah,
+			      struct roaring_bitmap **roaring)
+{
+	struct roaring_bitmap *b;
+	ssize_t bitmap_size;
+
+	*ewah = NULL;
+	*roaring = NULL;
+
+	if (index->version == 1) {
+		*ewah = read_bitmap_1(index);
+		return *ewah ? 0 : -1;
+	}
+
+	b = roaring_new();
+	bitmap_size = roaring_read_mmap(b, index->map + index->map_pos,
+					index->map_size - index->map_pos);
+	if (bitmap_size < 0) {
+		roaring_free(b);
+		return error(_("failed to load bitmap index (corrupted?)"));
+	}
+
+	index->map_pos += bitmap_size;
+	*roaring = b;
+	return 0;
+}
+
 static uint32_t bitmap_num_objects(struct bitmap_index *index)
 {
 	if (index->midx)
@@ -178,7 +247,7 @@ static int load_bitmap_header(struct bitmap_index *index)
 		return error(_("corrupted bitmap index file (wrong header)"));
 
 	index->version = ntohs(header->version);
-	if (index->version != 1)
+	if (index->version != 1 && index->version != 2)
 		return error(_("unsupported version '%d' for bitmap index file"), index->version);
 
 	/* Parse known bitmap format options */
@@ -217,6 +286,7 @@ static int load_bitmap_header(struct bitmap_index *index)
 
 static struct stored_bitmap *store_bitmap(struct bitmap_index *index,
 					  struct ewah_bitmap *root,
+					  struct roaring_bitmap *roaring,
 					  const struct object_id *oid,
 					  struct stored_bitmap *xor_with,
 					  int flags)
@@ -227,6 +297,7 @@ static struct stored_bitmap *store_bitmap(struct bitmap_index *index,
 
 	stored = xmalloc(sizeof(struct stored_bitmap));
 	stored->root = root;
+	stored->roaring = roaring;
 	stored->xor = xor_with;
 	stored->flags = flags;
 	oidcpy(&stored->oid, oid);
@@ -278,6 +349,7 @@ static int load_bitmap_entries_v1(struct bitmap_index *index)
 	for (i = 0; i < index->entry_count; ++i) {
 		int xor_offset, flags;
 		struct ewah_bitmap *bitmap = NULL;
+		struct roaring_bitmap *roaring = NULL;
 		struct stored_bitmap *xor_bitmap = NULL;
 		uint32_t commit_idx_pos;
 		struct object_id oid;
@@ -293,8 +365,7 @@ static int load_bitmap_entries_v1(struct bitmap_index *index)
 			return error(_("corrupt ewah bitmap: commit index %u out of range"),
 				     (unsigned)commit_idx_pos);
 
-		bitmap = read_bitmap_1(index);
-		if (!bitmap)
+		if (read_commit_bitmap(index, &bitmap, &roaring) < 0)
 			return -1;
 
 		if (xor_offset > MAX_XOR_OFFSET || xor_offset > i)
@@ -308,7 +379,7 @@ static int load_bitmap_entries_v1(struct bitmap_index *index)
 		}
 
 		recent_bitmaps[i % MAX_XOR_OFFSET] = store_bitmap(
-			index, bitmap, &oid, xor_bitmap, flags);
+			index, bitmap, roaring, &oid, xor_bitmap, flags);
 	}
 
 	return 0;
@@ -716,6 +787,7 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 	struct bitmap_lookup_table_triplet triplet;
 	struct object_id *oid = &commit->object.oid;
 	struct ewah_bitmap *bitmap;
+	struct roaring_bitmap *roaring;
 	struct stored_bitmap *xor_bitmap = NULL;
 	const int bitmap_header_size = 6;
 	static struct bitmap_lookup_table_xor_item *xor_items = NULL;
@@ -785,12 +857,12 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 
 		bitmap_git->map_pos += sizeof(uint32_t) + sizeof(uint8_t);
 		xor_flags = read_u8(bitmap_git->map, &bitmap_git->map_pos);
-		bitmap = read_bitmap_1(bitmap_git);
 
-		if (!bitmap)
+		if (read_commit_bitmap(bitmap_git, &bitmap, &roaring) < 0)
 			goto corrupt;
 
-		xor_bitmap = store_bitmap(bitmap_git, bitmap, &xor_item->oid, xor_bitmap, xor_flags);
+		xor_bitmap = store_bitmap(bitmap_git, bitmap, roaring, &xor_item->oid,
+					  xor_bitmap, xor_flags);
 		xor_items_nr--;
 	}
 
@@ -826,12 +898,11 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 	 */
 	bitmap_git->map_pos += sizeof(uint32_t) + sizeof(uint8_t);
 	flags = read_u8(bitmap_git->map, &bitmap_git->map_pos);
-	bitmap = read_bitmap_1(bitmap_git);
 
-	if (!bitmap)
+	if (read_commit_bitmap(bitmap_git, &bitmap, &roaring) < 0)
 		goto corrupt;
 
-	return store_bitmap(bitmap_git, bitmap, oid, xor_bitmap, flags);
+	return store_bitmap(bitmap_git, bitmap, roaring, oid, xor_bitmap, flags);
 
 corrupt:
 	free(xor_items);
@@ -839,24 +910,41 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 	return NULL;
 }
 
-struct ewah_bitmap *bitmap_for_commit(struct bitmap_index *bitmap_git,
-				      struct commit *commit)
+static struct stored_bitmap *stored_bitmap_for_commit(struct bitmap_index *bitmap_git,
+						      struct commit *commit)
 {
 	khiter_t hash_pos = kh_get_oid_map(bitmap_git->bitmaps,
 					   commit->object.oid);
 	if (hash_pos >= kh_end(bitmap_git->bitmaps)) {
-		struct stored_bitmap *bitmap = NULL;
 		if (!bitmap_git->table_lookup)
 			return NULL;
 
 		/* this is a fairly hot codepath - no trace2_region please */
 		/* NEEDSWORK: cache misses aren't recorded */
-		bitmap = lazy_bitmap_for_commit(bitmap_git, commit);
-		if (!bitmap)
-			return NULL;
-		return lookup_stored_bitmap(bitmap);
+		return lazy_bitmap_for_commit(bitmap_git, commit);
 	}
-	return lookup_stored_bitmap(kh_value(bitmap_git->bitmaps, hash_pos));
+	return kh_value(bitmap_git->bitmaps, hash_pos);
+}
+
+struct ewah_bitmap *bitmap_for_commit(struct bitmap_index *bitmap_git,
+				      struct commit *commit)
+{
+	struct stored_bitmap *bitmap = stored_bitmap_for_commit(bitmap_git, commit);
+	if (!bitmap)
+		return NULL;
+	return lookup_stored_bitmap(bitmap);
+}
+
+/*
+ * OR the reachability bitmap of a bitmapped commit into "base", without
+ * converting it to EWAH first if it was stored as a roaring bitmap.
+ */
+static void bitmap_or_stored(struct bitmap *base, struct stored_bitmap *st)
+{
+	if (st->roaring)
+		bitmap_or_roaring(base, lookup_stored_roaring(st));
+	else
+		bitmap_or_ewah(base, lookup_stored_bitmap(st));
 }
 
 static inline int bitmap_position_extended(struct bitmap_index *bitmap_git,
@@ -967,7 +1055,7 @@ static int add_to_include_set(struct bitmap_index *bitmap_git,
 			      struct commit *commit,
 			      int bitmap_pos)
 {
-	struct ewah_bitmap *partial;
+	struct stored_bitmap *partial;
 
 	if (data->seen && bitmap_get(data->seen, bitmap_pos))
 		return 0;
@@ -975,9 +1063,9 @@ static int add_to_include_set(struct bitmap_index *bitmap_git,
 	if (bitmap_get(data->base, bitmap_pos))
 		return 0;
 
-	partial = bitmap_for_commit(bitmap_git, commit);
+	partial = stored_bitmap_for_commit(bitmap_git, commit);
 	if (partial) {
-		bitmap_or_ewah(data->base, partial);
+		bitmap_or_stored(data->base, partial);
 		return 0;
 	}
 
@@ -1026,21 +1114,28 @@ static int should_include_obj(struct object *obj, void *_data)
 	return 1;
 }
 
-static int add_commit_to_bitmap(struct bitmap_index *bitmap_git,
-				struct bitmap **base,
-				struct commit *commit)
+/*
+ * OR the bitmaps of all "tips" into a new bitmap.  The EWAH ones are
+ * combined in one go, so that the result is only grown once.
+ */
+static struct bitmap *bitmap_or_stored_many(struct stored_bitmap **tips,
+					    size_t nr)
 {
-	struct ewah_bitmap *or_with = bitmap_for_commit(bitmap_git, commit);
-
-	if (!or_with)
-		return 0;
+	struct bitmap *base = bitmap_new();
+	struct ewah_bitmap **ewah;
+	size_t i, ewah_nr = 0;
 
-	if (!*base)
-		*base = ewah_to_bitmap(or_with);
-	else
-		bitmap_or_ewah(*base, or_with);
+	ALLOC_ARRAY(ewah, nr);
+	for (i = 0; i < nr; i++) {
+		if (tips[i]->roaring)
+			bitmap_or_roaring(base, lookup_stored_roaring(tips[i]));
+		else
+			ewah[ewah_nr++] = lookup_stored_bitmap(tips[i]);
+	}
+	bitmap_or_ewah_many(base, ewah, ewah_nr);
 
-	return 1;
+	free(ewah);
+	return base;
 }
 
 static struct bitmap *find_objects(struct bitmap_index *bitmap_git,
@@ -1052,6 +1147,8 @@ static struct bitmap *find_objects(struct bitmap_index *bitmap_git,
 	int needs_walk = 0;
 
 	struct object_list *not_mapped = NULL;
+	struct stored_bitmap **tips = NULL;
+	size_t tips_nr = 0, tips_alloc = 0;
 
 	/*
 	 * Go through all the roots for the walk. The ones that have bitmaps
@@ -1063,10 +1160,13 @@ static struct bitmap *find_objects(struct bitmap_index *bitmap_git,
 	 */
 	while (roots) {
 		struct object *object = roots->item;
+		struct stored_bitmap *st;
 		roots = roots->next;
 
 		if (object->type == OBJ_COMMIT &&
-		    add_commit_to_bitmap(bitmap_git, &base, (struct commit *)object)) {
+		    (st = stored_bitmap_for_commit(bitmap_git, (struct commit *)object))) {
+			ALLOC_GROW(tips, tips_nr + 1, tips_alloc);
+			tips[tips_nr++] = st;
 			object->flags |= SEEN;
 			continue;
 		}
@@ -1074,6 +1174,10 @@ static struct bitmap *find_objects(struct bitmap_index *bitmap_git,
 		object_list_insert(object, &not_mapped);
 	}
 
+	if (tips_nr)
+		base = bitmap_or_stored_many(tips, tips_nr);
+	free(tips);
+
 	/*
 	 * Best case scenario: We found bitmaps for all the roots,
 	 * so the resulting `or` bitmap has the full reachability analysis
@@ -1899,6 +2003,403 @@ void count_bitmap_commit_list(struct bitmap_index *bitmap_git,
 		*tags = count_object_type(bitmap_git, OBJ_TAG);
 }
 
+/*
+ * Bitmaps record the history as it is stored in the object database,
+ * so they cannot be used when grafts, replace refs or a shallow clone
+ * change the parents of some commits.
+ */
+static int bitmap_history_compatible(struct repository *r)
+{
+	if (read_replace_refs) {
+		prepare_replace_object(r);
+		if (hashmap_get_size(&r->objects->replace_map->map))
+			return 0;
+	}
+
+	prepare_commit_graft(r);
+	if (r->parsed_objects &&
+	    (r->parsed_objects->grafts_nr || r->parsed_objects->substituted_parent))
+		return 0;
+	if (is_repository_shallow(r))
+		return 0;
+
+	return 1;
+}
+
+/*
+ * How many commits without a bitmap a fringe walk may visit before
+ * giving up.  Bitmaps are sparse in old history, and past this point
+ * the regular walks, which can stop as soon as the remaining history
+ * no longer matters, are cheaper.
+ */
+#define FRINGE_WALK_BUDGET 10000
+
+define_commit_slab(fringe_bits, struct bitmap *);
+
+/*
+ * A commit met by fringe_walk(), together with the set of input
+ * commits that can reach it.  "bitmap" is the stored bitmap if the
+ * commit has one, in which case the walk stopped there.  "pos" starts
+ * out as -1; callers that need the bit positions of the other commits
+ * fill it in, leaving -1 for those that are not in the bitmapped pack.
+ */
+struct fringe_entry {
+	struct commit *commit;
+	struct stored_bitmap *bitmap;
+	int pos;
+	struct bitmap *reached_by;
+};
+
+/*
+ * Walk from "commits" down to the nearest bitmapped commits, recording
+ * every commit met in "entries".  Commits come out of the queue in
+ * generation order, so the set of input commits reaching each one is
+ * complete by the time it is visited.  Commits with a generation below
+ * "min_generation" are neither recorded nor walked past.  Returns -1
+ * if the walk runs over budget.
+ */
+static int fringe_walk(struct repository *r,
+		       struct bitmap_index *bitmap_git,
+		       struct commit **commits, size_t commits_nr,
+		       timestamp_t min_generation,
+		       struct fringe_entry **entries,
+		       size_t *entries_nr, size_t *entries_alloc)
+{
+	struct prio_queue queue = { .compare = compare_commits_by_gen_then_commit_date };
+	struct fringe_bits bits;
+	size_t width = DIV_ROUND_UP(commits_nr, BITS_IN_EWORD);
+	unsigned int budget = FRINGE_WALK_BUDGET;
+	int ret = 0;
+
+	ensure_generations_valid(r, commits, commits_nr);
+	init_fringe_bits(&bits);
+
+	for (size_t i = 0; i < commits_nr; i++) {
+		struct bitmap **b = fringe_bits_at(&bits, commits[i]);
+
+		if (!*b) {
+			*b = bitmap_word_alloc(width);
+			prio_queue_put(&queue, commits[i]);
+		}
+		bitmap_set(*b, i);
+	}
+
+	while (queue.nr) {
+		struct commit *c = prio_queue_get(&queue);
+		struct bitmap **b = fringe_bits_at(&bits, c);
+		struct fringe_entry *e;
+		struct commit_list *p;
+
+		if (commit_graph_generation(c) < min_generation) {
+			bitmap_free(*b);
+			*b = NULL;
+			continue;
+		}
+
+		ALLOC_GROW(*entries, *entries_nr + 1, *entries_alloc);
+		e = &(*entries)[(*entries_nr)++];
+		e->commit = c;
+		e->reached_by = *b;
+		e->bitmap = stored_bitmap_for_commit(bitmap_git, c);
+		e->pos = -1;
+		*b = NULL;
+
+		if (e->bitmap)
+			continue;
+
+		if (!budget--) {
+			ret = -1;
+			break;
+		}
+
+		if (repo_parse_commit(r, c)) {
+			ret = -1;
+			break;
+		}
+		for (p = c->parents; p; p = p->next) {
+			struct bitmap **pb = fringe_bits_at(&bits, p->item);
+
+			repo_parse_commit(r, p->item);
+			if (!*pb) {
+				*pb = bitmap_word_alloc(width);
+				prio_queue_put(&queue, p->item);
+			}
+			bitmap_or(*pb, e->reached_by);
+		}
+	}
+
+	while (queue.nr)
+		bitmap_free(*fringe_bits_at(&bits, prio_queue_get(&queue)));
+	clear_fringe_bits(&bits);
+	clear_prio_queue(&queue);
+	return ret;
+}
+
+/*
+ * Build the set of objects in the bitmapped pack that are reachable
+ * from the input commit "index": the stored bitmaps of the bitmapped
+ * commits it reaches, plus the commits the walk found on the way.
+ */
+static struct bitmap *ahead_behind_reach(struct fringe_entry *entries,
+					 size_t entries_nr, size_t index)
+{
+	struct bitmap *result;
+	struct stored_bitmap **tips = NULL;
+	size_t tips_nr = 0, tips_alloc = 0;
+	size_t i;
+
+	for (i = 0; i < entries_nr; i++) {
+		if (!entries[i].bitmap || !bitmap_get(entries[i].reached_by, index))
+			continue;
+		ALLOC_GROW(tips, tips_nr + 1, tips_alloc);
+		tips[tips_nr++] = entries[i].bitmap;
+	}
+	result = tips_nr ? bitmap_or_stored_many(tips, tips_nr) : bitmap_new();
+	free(tips);
+
+	for (i = 0; i < entries_nr; i++)
+		if (!entries[i].bitmap && entries[i].pos >= 0 &&
+		    bitmap_get(entries[i].reached_by, index))
+			bitmap_set(result, entries[i].pos);
+
+	return result;
+}
+
+/* Count the commits that are in "a" but not in "b". */
+static unsigned int count_commits_and_not(struct bitmap *commits,
+					  struct bitmap *a, struct bitmap *b)
+{
+	unsigned int count = 0;
+	size_t i, nr = a->word_alloc < commits->word_alloc ?
+		a->word_alloc : commits->word_alloc;
+
+	for (i = 0; i < nr; i++) {
+		eword_t word = a->words[i] & commits->words[i];
+		if (i < b->word_alloc)
+			word &= ~b->words[i];
+		count += ewah_bit_popcount64(word);
+	}
+	return count;
+}
+
+int bitmap_ahead_behind(struct repository *r,
+			struct commit **commits, size_t commits_nr,
+			struct ahead_behind_count *counts, size_t counts_nr)
+{
+	struct bitmap_index *bitmap_git;
+	struct fringe_entry *entries = NULL;
+	size_t entries_nr = 0, entries_alloc = 0;
+	struct bitmap *commit_mask = NULL;
+	struct bitmap **reach = NULL;
+	unsigned int *uses = NULL;
+	size_t i, j;
+	int ret = -1;
+
+	if (!bitmap_history_compatible(r))
+		return -1;
+	bitmap_git = prepare_bitmap_git(r);
+	if (!bitmap_git)
+		return -1;
+
+	trace2_region_enter("pack-bitmap", "ahead-behind", r);
+
+	if (fringe_walk(r, bitmap_git, commits, commits_nr, 0,
+			&entries, &entries_nr, &entries_alloc) < 0) {
+		trace2_data_string("pack-bitmap", r,
+				   "ahead-behind/fallback", "walk budget");
+		goto cleanup;
+	}
+	trace2_data_intmax("pack-bitmap", r, "ahead-behind/walked",
+			   entries_nr);
+
+	/*
+	 * Commits the walk met have their own bit position set in the
+	 * reachability bitmaps, even if they are not in the bitmapped
+	 * pack, so mark those positions as commits, too.
+	 */
+	commit_mask = ewah_to_bitmap(bitmap_git->commits);
+	for (i = 0; i < entries_nr; i++) {
+		if (entries[i].bitmap)
+			continue;
+		entries[i].pos = bitmap_position(bitmap_git,
+						 &entries[i].commit->object.oid);
+		if (entries[i].pos >= 0)
+			bitmap_set(commit_mask, entries[i].pos);
+	}
+
+	/*
+	 * Keep the reachability bitmap of each commit only as long as
+	 * some pair still needs it; typically many tips are compared to
+	 * the same base, and only the bitmap of the base stays around.
+	 */
+	CALLOC_ARRAY(reach, commits_nr);
+	CALLOC_ARRAY(uses, commits_nr);
+	for (i = 0; i < counts_nr; i++) {
+		uses[counts[i].tip_index]++;
+		uses[counts[i].base_index]++;
+	}
+
+	for (i = 0; i < counts_nr; i++) {
+		size_t tip = counts[i].tip_index;
+		size_t base = counts[i].base_index;
+
+		if (!reach[tip])
+			reach[tip] = ahead_behind_reach(entries, entries_nr, tip);
+		if (!reach[base])
+			reach[base] = ahead_behind_reach(entries, entries_nr, base);
+
+		counts[i].ahead = count_commits_and_not(commit_mask, reach[tip],
+							reach[base]);
+		counts[i].behind = count_commits_and_not(commit_mask, reach[base],
+							 reach[tip]);
+
+		/*
+		 * Commits outside of the bitmapped pack have no bit
+		 * position; the walk met all of them, so count them
+		 * directly.
+		 */
+		for (j = 0; j < entries_nr; j++) {
+			int from_tip, from_base;
+
+			if (entries[j].bitmap || entries[j].pos >= 0)
+				continue;
+			from_tip = bitmap_get(entries[j].reached_by, tip);
+			from_base = bitmap_get(entries[j].reached_by, base);
+			if (from_tip && !from_base)
+				counts[i].ahead++;
+			else if (from_base && !from_tip)
+				counts[i].behind++;
+		}
+
+		if (!--uses[tip]) {
+			bitmap_free(reach[tip]);
+			reach[tip] = NULL;
+		}
+		if (!--uses[base]) {
+			bitmap_free(reach[base]);
+			reach[base] = NULL;
+		}
+	}
+	ret = 0;
+
+cleanup:
+	if (reach)
+		for (i = 0; i < commits_nr; i++)
+			bitmap_free(reach[i]);
+	free(reach);
+	free(uses);
+	bitmap_free(commit_mask);
+	for (i = 0; i < entries_nr; i++)
+		bitmap_free(entries[i].reached_by);
+	free(entries);
+	free_bitmap_index(bitmap_git);
+
+	trace2_region_leave("pack-bitmap", "ahead-behind", r);
+	return ret;
+}
+
+static int stored_bitmap_get(struct stored_bitmap *st, int pos)
+{
+	if (st->roaring)
+		return roaring_get(lookup_stored_roaring(st), pos);
+	return ewah_get(lookup_stored_bitmap(st), pos);
+}
+
+int bitmap_tips_reach_any(struct repository *r,
+			  struct commit **tips, size_t tips_nr,
+			  struct commit_list *want, unsigned char *result)
+{
+	struct bitmap_index *bitmap_git;
+	struct fringe_entry *entries = NULL;
+	size_t entries_nr = 0, entries_alloc = 0;
+	struct bitmap *found;
+	struct commit_list *w;
+	struct commit **wants = NULL;
+	timestamp_t min_generation = GENERATION_NUMBER_INFINITY;
+	int *want_pos = NULL;
+	size_t want_nr = 0, want_alloc = 0;
+	size_t i, j;
+	int ret = -1;
+
+	/*
+	 * Without a commit-graph, the walk would first have to compute
+	 * generation numbers for all of history.
+	 */
+	if (!generation_numbers_enabled(r) || !bitmap_history_compatible(r))
+		return -1;
+	bitmap_git = prepare_bitmap_git(r);
+	if (!bitmap_git)
+		return -1;
+
+	trace2_region_enter("pack-bitmap", "tips-reach-any", r);
+
+	for (w = want; w; w = w->next) {
+		ALLOC_GROW(wants, want_nr + 1, want_alloc);
+		wants[want_nr++] = w->item;
+	}
+	ensure_generations_valid(r, wants, want_nr);
+
+	/*
+	 * Nothing below the oldest wanted commit can reach any of them,
+	 * so the walk may stop there even before it meets a bitmap.
+	 */
+	ALLOC_ARRAY(want_pos, want_nr);
+	for (i = 0; i < want_nr; i++) {
+		timestamp_t generation = commit_graph_generation(wants[i]);
+
+		if (generation < min_generation)
+			min_generation = generation;
+		want_pos[i] = bitmap_position(bitmap_git, &wants[i]->object.oid);
+	}
+
+	if (fringe_walk(r, bitmap_git, tips, tips_nr, min_generation,
+			&entries, &entries_nr, &entries_alloc) < 0) {
+		trace2_data_string("pack-bitmap", r,
+				   "tips-reach-any/fallback", "walk budget");
+		goto cleanup;
+	}
+	trace2_data_intmax("pack-bitmap", r, "tips-reach-any/walked",
+			   entries_nr);
+
+	/*
+	 * A tip reaches a wanted commit if the walk met that commit, or
+	 * met a bitmapped commit whose bitmap has it.  Wanted commits
+	 * outside of the bitmapped pack can only be met by the walk, as
+	 * the pack is closed under reachability.
+	 */
+	found = bitmap_word_alloc(DIV_ROUND_UP(tips_nr, BITS_IN_EWORD));
+	for (i = 0; i < entries_nr; i++) {
+		struct fringe_entry *e = &entries[i];
+		int hit = 0;
+
+		if (e->bitmap) {
+			for (j = 0; !hit && j < want_nr; j++)
+				hit = want_pos[j] >= 0 &&
+				      stored_bitmap_get(e->bitmap, want_pos[j]);
+		} else {
+			for (w = want; !hit && w; w = w->next)
+				hit = w->item == e->commit;
+		}
+		if (hit)
+			bitmap_or(found, e->reached_by);
+	}
+	for (i = 0; i < tips_nr; i++)
+		result[i] = !!bitmap_get(found, i);
+	bitmap_free(found);
+	ret = 0;
+
+cleanup:
+	free(wants);
+	free(want_pos);
+	for (i = 0; i < entries_nr; i++)
+		bitmap_free(entries[i].reached_by);
+	free(entries);
+	free_bitmap_index(bitmap_git);
+
+	trace2_region_leave("pack-bitmap", "tips-reach-any", r);
+	return ret;
+}
+
 struct bitmap_test_data {
 	struct bitmap_index *bitmap_git;
 	struct bitmap *base;
@@ -2186,6 +2687,7 @@ void free_bitmap_index(struct bitmap_index *b)
 		struct stored_bitmap *sb;
 		kh_foreach_value(b->bitmaps, sb, {
 			ewah_pool_free(sb->root);
+			roaring_free(sb->roaring);
 			free(sb);
 		});
 	}
@@ -7,7 +7,9 @@
 #include "pack-objects.h"
 #include "string-list.h"
 
+struct ahead_behind_count;
 struct commit;
+struct commit_list;
 struct repository;
 struct rev_info;
 
@@ -36,6 +38,12 @@ enum pack_bitmap_opts {
 	BITMAP_OPT_FULL_DAG = 0x1,
 	BITMAP_OPT_HASH_CACHE = 0x4,
 	BITMAP_OPT_LOOKUP_TABLE = 0x10,
+
+	/*
+	 * Not stored in the header: asks bitmap_writer_finish() to write
+	 * a version 2 index, whose commit bitmaps are roaring bitmaps.
+	 */
+	BITMAP_OPT_ROARING = 0x8000,
 };
 
 enum pack_bitmap_flags {
@@ -84,6 +92,27 @@ int bitmap_has_oid_in_uninteresting(struct bitmap_index *, const struct object_i
 
 off_t get_disk_usage_from_bitmap(struct bitmap_index *, struct rev_info *);
 
+/*
+ * Compute ahead/behind counts like ahead_behind() does, using the
+ * reachability bitmaps and walking only from commits that are not
+ * covered by them.  Returns -1 if there are no usable bitmaps or if
+ * some commits are too far from any bitmapped commit, in which case
+ * "counts" must be computed some other way.
+ */
+int bitmap_ahead_behind(struct repository *r,
+			struct commit **commits, size_t commits_nr,
+			struct ahead_behind_count *counts, size_t counts_nr);
+
+/*
+ * Set result[i] to 1 if tips[i] can reach any commit in "want", and
+ * to 0 otherwise, using the reachability bitmaps and walking only
+ * from tips that are not covered by them.  Returns -1 like
+ * bitmap_ahead_behind() if that is not possible.
+ */
+int bitmap_tips_reach_any(struct repository *r,
+			  struct commit **tips, size_t tips_nr,
+			  struct commit_list *want, unsigned char *result);
+
 void bitmap_writer_show_progress(int show);
 void bitmap_writer_set_checksum(const unsigned char *sha1);
 void bitmap_writer_build_type_index(struct packing_data *to_pack,
@@ -135,8 +135,9 @@ static void create_pack_revindex(struct packed_git *p)
 	unsigned i;
 	const char *index = p->index_data;
 	const unsigned hashsz = the_hash_algo->rawsz;
+	struct revindex_entry *revindex;
 
-	ALLOC_ARRAY(p->revindex, num_ent + 1);
+	ALLOC_ARRAY(revindex, num_ent + 1);
 	index += 4 * 256;
 
 	if (p->index_version > 1) {
@@ -146,18 +147,18 @@ static void create_pack_revindex(struct packed_git *p)
 		for (i = 0; i < num_ent; i++) {
 			const uint32_t off = ntohl(*off_32++);
 			if (!(off & 0x80000000)) {
-				p->revindex[i].offset = off;
+				revindex[i].offset = off;
 			} else {
-				p->revindex[i].offset = get_be64(off_64);
+				revindex[i].offset = get_be64(off_64);
 				off_64 += 2;
 			}
-			p->revindex[i].nr = i;
+			revindex[i].nr = i;
 		}
 	} else {
 		for (i = 0; i < num_ent; i++) {
 			const uint32_t hl = *((uint32_t *)(index + (hashsz + 4) * i));
-			p->revindex[i].offset = ntohl(hl);
-			p->revindex[i].nr = i;
+			revindex[i].offset = ntohl(hl);
+			revindex[i].nr = i;
 		}
 	}
 
@@ -165,9 +166,12 @@ static void create_pack_revindex(struct packed_git *p)
 	 * This knows the pack format -- the hash trailer
 	 * follows immediately after the last object data.
 	 */
-	p->revindex[num_ent].offset = p->pack_size - hashsz;
-	p->revindex[num_ent].nr = -1;
-	sort_revindex(p->revindex, num_ent, p->pack_size);
+	revindex[num_ent].offset = p->pack_size - hashsz;
+	revindex[num_ent].nr = -1;
+	sort_revindex(revindex, num_ent, p->pack_size);
+
+	/* publish only once complete; readers check for it without locking */
+	p->revindex = revindex;
 }
 
 static int create_pack_revindex_in_memory(struct packed_git *p)
@@ -292,17 +296,21 @@ int load_pack_revindex_from_disk(struct packed_git *p)
 
 int load_pack_revindex(struct repository *r, struct packed_git *p)
 {
-	if (p->revindex || p->revindex_data)
-		return 0;
+	int ret = 0;
 
 	prepare_repo_settings(r);
 
-	if (r->settings.pack_read_reverse_index &&
-	    !load_pack_revindex_from_disk(p))
-		return 0;
-	else if (!create_pack_revindex_in_memory(p))
-		return 0;
-	return -1;
+	/* check under the lock, like open_pack_index() */
+	packed_git_lock();
+	if (p->revindex || p->revindex_data)
+		; /* already loaded */
+	else if (r->settings.pack_read_reverse_index &&
+		 !load_pack_revindex_from_disk(p))
+		; /* ok */
+	else if (create_pack_revindex_in_memory(p))
+		ret = -1;
+	packed_git_unlock();
+	return ret;
 }
 
 /*
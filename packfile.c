@@ -16,6 +16,7 @@
 #include "object.h"
 #include "tag.h"
 #include "trace.h"
+#include "trace2.h"
 #include "tree-walk.h"
 #include "tree.h"
 #include "object-file.h"
@@ -48,6 +49,55 @@ char *sha1_pack_index_name(const unsigned char *sha1)
 	return odb_pack_name(&buf, sha1, "idx");
 }
 
+/*
+ * When the object read lock is enabled (see enable_obj_read_lock()),
+ * reading an object from a pack does not hold obj_read_mutex, so that
+ * index lookups, window management, inflation and delta application
+ * in different threads can proceed in parallel.  Instead:
+ *
+ *  - packed_git_mutex protects the lazily initialized state of each
+ *    packed_git (its index and reverse index, pack fd and mmap'd
+ *    windows, including their use counts), the global list of packs
+ *    that window and fd eviction walk, the most-recently-used order
+ *    of packs, and the window and fd accounting below.  It is recursive, as opening a pack may need
+ *    to open its index.  It is only held for bookkeeping, never
+ *    across inflating or patching object data.
+ *
+ *  - each shard of the delta base cache has its own mutex, see
+ *    "struct delta_base_cache_shard" below.
+ *
+ * The lock order is obj_read_mutex, then packed_git_mutex; the delta
+ * base cache locks are leaf locks.
+ */
+static pthread_mutex_t packed_git_mutex;
+
+static void init_delta_base_cache_shards(void);
+static void destroy_delta_base_cache_shards(void);
+
+void init_pack_locks(void)
+{
+	init_recursive_mutex(&packed_git_mutex);
+	init_delta_base_cache_shards();
+}
+
+void destroy_pack_locks(void)
+{
+	pthread_mutex_destroy(&packed_git_mutex);
+	destroy_delta_base_cache_shards();
+}
+
+void packed_git_lock(void)
+{
+	if (obj_read_use_lock)
+		pthread_mutex_lock(&packed_git_mutex);
+}
+
+void packed_git_unlock(void)
+{
+	if (obj_read_use_lock)
+		pthread_mutex_unlock(&packed_git_mutex);
+}
+
 static unsigned int pack_used_ctr;
 static unsigned int pack_mmap_calls;
 static unsigned int peak_pack_open_windows;
@@ -190,9 +240,9 @@ int load_idx(const char *path, const unsigned int hashsz, void *idx_map,
 	}
 
 	p->index_version = version;
-	p->index_data = idx_map;
 	p->index_size = idx_size;
 	p->num_objects = nr;
+	p->index_data = idx_map;
 	return 0;
 }
 
@@ -200,28 +250,31 @@ int open_pack_index(struct packed_git *p)
 {
 	char *idx_name;
 	size_t len;
-	int ret;
-
-	if (p->index_data)
-		return 0;
+	int ret = 0;
 
-	if (!strip_suffix(p->pack_name, ".pack", &len))
-		BUG("pack_name does not end in .pack");
-	idx_name = xstrfmt("%.*s.idx", (int)len, p->pack_name);
-	ret = check_packed_git_idx(idx_name, p);
-	free(idx_name);
+	/*
+	 * Check under the lock, so that a thread which finds the index
+	 * already loaded also sees what load_idx() stored along with it.
+	 */
+	packed_git_lock();
+	if (!p->index_data) {
+		if (!strip_suffix(p->pack_name, ".pack", &len))
+			BUG("pack_name does not end in .pack");
+		idx_name = xstrfmt("%.*s.idx", (int)len, p->pack_name);
+		ret = check_packed_git_idx(idx_name, p);
+		free(idx_name);
+	}
+	packed_git_unlock();
 	return ret;
 }
 
 uint32_t get_pack_fanout(struct packed_git *p, uint32_t value)
 {
-	const uint32_t *level1_ofs = p->index_data;
+	const uint32_t *level1_ofs;
 
-	if (!level1_ofs) {
-		if (open_pack_index(p))
-			return 0;
-		level1_ofs = p->index_data;
-	}
+	if (open_pack_index(p))
+		return 0;
+	level1_ofs = p->index_data;
 
 	if (p->index_version > 1) {
 		level1_ofs += 2;
@@ -630,7 +683,11 @@ unsigned char *use_pack(struct packed_git *p,
 		off_t offset,
 		unsigned long *left)
 {
-	struct pack_window *win = *w_cursor;
+	struct pack_window *win;
+	unsigned char *ret;
+
+	packed_git_lock();
+	win = *w_cursor;
 
 	/* Since packfiles end in a hash of their content and it's
 	 * pointless to ask for an offset into the middle of that
@@ -695,14 +752,18 @@ unsigned char *use_pack(struct packed_git *p,
 	offset -= win->offset;
 	if (left)
 		*left = win->len - xsize_t(offset);
-	return win->base + offset;
+	ret = win->base + offset;
+	packed_git_unlock();
+	return ret;
 }
 
 void unuse_pack(struct pack_window **w_cursor)
 {
 	struct pack_window *w = *w_cursor;
 	if (w) {
+		packed_git_lock();
 		w->inuse_cnt--;
+		packed_git_unlock();
 		*w_cursor = NULL;
 	}
 }
@@ -760,11 +821,13 @@ struct packed_git *add_packed_git(const char *path, size_t path_len, int local)
 
 void install_packed_git(struct repository *r, struct packed_git *pack)
 {
+	packed_git_lock();
 	if (pack->pack_fd != -1)
 		pack_open_fds++;
 
 	pack->next = r->objects->packed_git;
 	r->objects->packed_git = pack;
+	packed_git_unlock();
 
 	hashmap_entry_init(&pack->packmap_ent, strhash(pack->pack_name));
 	hashmap_add(&r->objects->pack_map, &pack->packmap_ent);
@@ -979,17 +1042,21 @@ static int sort_pack(const struct packed_git *a, const struct packed_git *b)
 
 static void rearrange_packed_git(struct repository *r)
 {
+	packed_git_lock();
 	sort_packs(&r->objects->packed_git, sort_pack);
+	packed_git_unlock();
 }
 
 static void prepare_packed_git_mru(struct repository *r)
 {
 	struct packed_git *p;
 
+	packed_git_lock();
 	INIT_LIST_HEAD(&r->objects->packed_git_mru);
 
 	for (p = r->objects->packed_git; p; p = p->next)
 		list_add_tail(&p->mru, &r->objects->packed_git_mru);
+	packed_git_unlock();
 }
 
 static void prepare_packed_git(struct repository *r)
@@ -1126,7 +1193,7 @@ unsigned long get_size_from_delta(struct packed_git *p,
 		 * ensure no other thread will modify the window in the
 		 * meantime, we rely on the packed_window.inuse_cnt. This
 		 * counter is incremented before window reading and checked
-		 * before window disposal.
+		 * before window disposal, both under packed_git_mutex.
 		 *
 		 * Other worrying sections could be the call to close_pack_fd(),
 		 * which can close packs even with in-use windows, and to
@@ -1134,9 +1201,7 @@ unsigned long get_size_from_delta(struct packed_git *p,
 		 * "closing the file descriptor does not unmap the region". And
 		 * for the latter, it won't re-open already available packs.
 		 */
-		obj_read_unlock();
 		st = git_inflate(&stream, Z_FINISH);
-		obj_read_lock();
 		curpos += stream.next_in - in;
 	} while ((st == Z_OK || st == Z_BUF_ERROR) &&
 		 stream.total_out < sizeof(delta_head));
@@ -1186,7 +1251,10 @@ int unpack_object_header(struct packed_git *p,
 
 void mark_bad_packed_object(struct packed_git *p, const struct object_id *oid)
 {
+	/* readers look at bad_objects with obj_read_mutex held */
+	obj_read_lock();
 	oidset_insert(&p->bad_objects, oid);
+	obj_read_unlock();
 }
 
 const struct packed_git *has_packed_and_bad(struct repository *r,
@@ -1360,10 +1428,43 @@ static enum object_type packed_to_object_type(struct repository *r,
 	goto out;
 }
 
-static struct hashmap delta_base_cache;
-static size_t delta_base_cached;
+/*
+ * The delta base cache is split into shards, picked by the hash of the
+ * (pack, offset) key.  Each shard has its own lock, so that threads
+ * unpacking unrelated objects do not all contend on one lock.  Sharding
+ * only pays off when the object read lock is enabled; otherwise a
+ * single shard is used.
+ *
+ * The shards share core.deltaBaseCacheLimit rather than each getting an
+ * equal part of it: a shard only evicts its entries while the cache as
+ * a whole is over the limit, so one large base does not flush the rest
+ * of its shard while the other shards have room to spare.
+ *
+ * Each shard is a segmented LRU.  New entries go to the "probation"
+ * list and are moved to the "protected" list when they are used again.
+ * Eviction takes from the cold end of the probation list first, so
+ * walking a long delta chain once does not flush the bases that are
+ * needed over and over (e.g. the tree of a directory that most commits
+ * touch).  The protected list of a shard is bounded to half of the
+ * limit, and entries pushed out of it go back to the probation list.
+ */
+#define DELTA_BASE_CACHE_SHARDS 16
+
+struct delta_base_cache_shard {
+	pthread_mutex_t mutex;
+	struct hashmap map;
+	struct list_head probation;
+	struct list_head protected_lru;
+	size_t cached;
+	size_t protected_cached;
+};
 
-static LIST_HEAD(delta_base_cache_lru);
+static struct delta_base_cache_shard delta_base_cache[DELTA_BASE_CACHE_SHARDS];
+static unsigned int delta_base_cache_nr_shards = 1;
+
+/* The size of all shards together; a leaf lock, taken under a shard's. */
+static pthread_mutex_t delta_base_cache_total_mutex;
+static size_t delta_base_cache_total;
 
 struct delta_base_cache_key {
 	struct packed_git *p;
@@ -1377,6 +1478,7 @@ struct delta_base_cache_entry {
 	void *data;
 	unsigned long size;
 	enum object_type type;
+	unsigned is_protected : 1;
 };
 
 static unsigned int pack_entry_hash(struct packed_git *p, off_t base_offset)
@@ -1388,19 +1490,56 @@ static unsigned int pack_entry_hash(struct packed_git *p, off_t base_offset)
 	return hash;
 }
 
+static struct delta_base_cache_shard *delta_base_cache_shard(unsigned int hash)
+{
+	/*
+	 * The hashmap of each shard buckets its entries by the low bits
+	 * of the hash, so pick the shard from a remix of all bits instead.
+	 */
+	uint32_t mixed = (uint32_t)hash * 0x9e3779b9;
+	return &delta_base_cache[(mixed >> 24) % delta_base_cache_nr_shards];
+}
+
+static inline void delta_base_cache_lock(struct delta_base_cache_shard *shard)
+{
+	if (obj_read_use_lock)
+		pthread_mutex_lock(&shard->mutex);
+}
+
+static inline void delta_base_cache_unlock(struct delta_base_cache_shard *shard)
+{
+	if (obj_read_use_lock)
+		pthread_mutex_unlock(&shard->mutex);
+}
+
+/* Account for entries added to and removed from a shard. */
+static size_t delta_base_cache_update_total(size_t added, size_t removed)
+{
+	size_t total;
+
+	if (obj_read_use_lock)
+		pthread_mutex_lock(&delta_base_cache_total_mutex);
+	delta_base_cache_total = delta_base_cache_total + added - removed;
+	total = delta_base_cache_total;
+	if (obj_read_use_lock)
+		pthread_mutex_unlock(&delta_base_cache_total_mutex);
+	return total;
+}
+
 static struct delta_base_cache_entry *
-get_delta_base_cache_entry(struct packed_git *p, off_t base_offset)
+get_delta_base_cache_entry(struct delta_base_cache_shard *shard,
+			   struct packed_git *p, off_t base_offset)
 {
 	struct hashmap_entry entry, *e;
 	struct delta_base_cache_key key;
 
-	if (!delta_base_cache.cmpfn)
+	if (!shard->map.cmpfn)
 		return NULL;
 
 	hashmap_entry_init(&entry, pack_entry_hash(p, base_offset));
 	key.p = p;
 	key.base_offset = base_offset;
-	e = hashmap_get(&delta_base_cache, &entry, &key);
+	e = hashmap_get(&shard->map, &entry, &key);
 	return e ? container_of(e, struct delta_base_cache_entry, ent) : NULL;
 }
 
@@ -1429,7 +1568,44 @@ static int delta_base_cache_hash_cmp(const void *cmp_data UNUSED,
 
 static int in_delta_base_cache(struct packed_git *p, off_t base_offset)
 {
-	return !!get_delta_base_cache_entry(p, base_offset);
+	struct delta_base_cache_shard *shard =
+		delta_base_cache_shard(pack_entry_hash(p, base_offset));
+	int ret;
+
+	delta_base_cache_lock(shard);
+	ret = !!get_delta_base_cache_entry(shard, p, base_offset);
+	delta_base_cache_unlock(shard);
+	return ret;
+}
+
+/*
+ * Move an entry that has just been used to the hot end of the protected
+ * list, demoting the coldest protected entries back to probation if the
+ * protected list grew too large.
+ */
+static void protect_delta_base_cache_entry(struct delta_base_cache_shard *shard,
+					   struct delta_base_cache_entry *ent)
+{
+	size_t limit = delta_base_cache_limit / 2;
+
+	if (!ent->is_protected) {
+		ent->is_protected = 1;
+		shard->protected_cached += ent->size;
+	}
+	list_del(&ent->lru);
+	list_add_tail(&ent->lru, &shard->protected_lru);
+
+	while (shard->protected_cached > limit) {
+		struct delta_base_cache_entry *f =
+			list_first_entry(&shard->protected_lru,
+					 struct delta_base_cache_entry, lru);
+		if (f == ent)
+			break;
+		f->is_protected = 0;
+		shard->protected_cached -= f->size;
+		list_del(&f->lru);
+		list_add_tail(&f->lru, &shard->probation);
+	}
 }
 
 /*
@@ -1437,11 +1613,15 @@ static int in_delta_base_cache(struct packed_git *p, off_t base_offset)
  * entry data. The caller takes ownership of the "data" buffer, and
  * should copy out any fields it wants before detaching.
  */
-static void detach_delta_base_cache_entry(struct delta_base_cache_entry *ent)
+static void detach_delta_base_cache_entry(struct delta_base_cache_shard *shard,
+					  struct delta_base_cache_entry *ent)
 {
-	hashmap_remove(&delta_base_cache, &ent->ent, &ent->key);
+	hashmap_remove(&shard->map, &ent->ent, &ent->key);
 	list_del(&ent->lru);
-	delta_base_cached -= ent->size;
+	shard->cached -= ent->size;
+	if (ent->is_protected)
+		shard->protected_cached -= ent->size;
+	delta_base_cache_update_total(0, ent->size);
 	free(ent);
 }
 
@@ -1449,59 +1629,157 @@ static void *cache_or_unpack_entry(struct repository *r, struct packed_git *p,
 				   off_t base_offset, unsigned long *base_size,
 				   enum object_type *type)
 {
+	struct delta_base_cache_shard *shard =
+		delta_base_cache_shard(pack_entry_hash(p, base_offset));
 	struct delta_base_cache_entry *ent;
+	void *ret;
 
-	ent = get_delta_base_cache_entry(p, base_offset);
-	if (!ent)
+	delta_base_cache_lock(shard);
+	ent = get_delta_base_cache_entry(shard, p, base_offset);
+	if (!ent) {
+		delta_base_cache_unlock(shard);
 		return unpack_entry(r, p, base_offset, type, base_size);
+	}
 
 	if (type)
 		*type = ent->type;
 	if (base_size)
 		*base_size = ent->size;
-	return xmemdupz(ent->data, ent->size);
+	ret = xmemdupz(ent->data, ent->size);
+	protect_delta_base_cache_entry(shard, ent);
+	delta_base_cache_unlock(shard);
+
+	trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HIT, 1);
+	return ret;
 }
 
-static inline void release_delta_base_cache(struct delta_base_cache_entry *ent)
+static inline void release_delta_base_cache(struct delta_base_cache_shard *shard,
+					    struct delta_base_cache_entry *ent)
 {
 	free(ent->data);
-	detach_delta_base_cache_entry(ent);
+	detach_delta_base_cache_entry(shard, ent);
 }
 
-void clear_delta_base_cache(void)
+static void clear_delta_base_cache_shard(struct delta_base_cache_shard *shard)
 {
 	struct list_head *lru, *tmp;
-	list_for_each_safe(lru, tmp, &delta_base_cache_lru) {
+
+	if (!shard->map.cmpfn)
+		return;
+
+	list_for_each_safe(lru, tmp, &shard->probation) {
+		struct delta_base_cache_entry *entry =
+			list_entry(lru, struct delta_base_cache_entry, lru);
+		release_delta_base_cache(shard, entry);
+	}
+	list_for_each_safe(lru, tmp, &shard->protected_lru) {
 		struct delta_base_cache_entry *entry =
 			list_entry(lru, struct delta_base_cache_entry, lru);
-		release_delta_base_cache(entry);
+		release_delta_base_cache(shard, entry);
 	}
 }
 
+void clear_delta_base_cache(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < delta_base_cache_nr_shards; i++) {
+		struct delta_base_cache_shard *shard = &delta_base_cache[i];
+
+		delta_base_cache_lock(shard);
+		clear_delta_base_cache_shard(shard);
+		delta_base_cache_unlock(shard);
+	}
+}
+
+/*
+ * Entries are placed in a shard according to the number of shards, so
+ * the cache is emptied whenever that changes.  These are only called by
+ * {enable,disable}_obj_read_lock(), before any reader threads start or
+ * after they have all finished.
+ */
+static void init_delta_base_cache_shards(void)
+{
+	unsigned int i;
+
+	pthread_mutex_init(&delta_base_cache_total_mutex, NULL);
+	clear_delta_base_cache_shard(&delta_base_cache[0]);
+	for (i = 0; i < DELTA_BASE_CACHE_SHARDS; i++)
+		pthread_mutex_init(&delta_base_cache[i].mutex, NULL);
+	delta_base_cache_nr_shards = DELTA_BASE_CACHE_SHARDS;
+}
+
+static void destroy_delta_base_cache_shards(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < DELTA_BASE_CACHE_SHARDS; i++) {
+		clear_delta_base_cache_shard(&delta_base_cache[i]);
+		pthread_mutex_destroy(&delta_base_cache[i].mutex);
+	}
+	pthread_mutex_destroy(&delta_base_cache_total_mutex);
+	delta_base_cache_nr_shards = 1;
+}
+
+/*
+ * Add "base" to the cache, taking ownership of it.  If it was found in
+ * the cache by the caller (and detached to be used while patching),
+ * "reused" should be set so that it is put back in the protected list.
+ */
 static void add_delta_base_cache(struct packed_git *p, off_t base_offset,
-	void *base, unsigned long base_size, enum object_type type)
+	void *base, unsigned long base_size, enum object_type type,
+	int reused)
 {
+	unsigned int hash = pack_entry_hash(p, base_offset);
+	struct delta_base_cache_shard *shard = delta_base_cache_shard(hash);
 	struct delta_base_cache_entry *ent;
 	struct list_head *lru, *tmp;
+	uint64_t evicted = 0;
+	size_t total;
+
+	delta_base_cache_lock(shard);
+
+	if (!shard->map.cmpfn) {
+		hashmap_init(&shard->map, delta_base_cache_hash_cmp, NULL, 0);
+		INIT_LIST_HEAD(&shard->probation);
+		INIT_LIST_HEAD(&shard->protected_lru);
+	}
 
 	/*
 	 * Check required to avoid redundant entries when more than one thread
 	 * is unpacking the same object, in unpack_entry() (since its phases I
 	 * and III might run concurrently across multiple threads).
 	 */
-	if (in_delta_base_cache(p, base_offset)) {
+	if (get_delta_base_cache_entry(shard, p, base_offset)) {
+		delta_base_cache_unlock(shard);
 		free(base);
 		return;
 	}
 
-	delta_base_cached += base_size;
+	shard->cached += base_size;
+	total = delta_base_cache_update_total(base_size, 0);
 
-	list_for_each_safe(lru, tmp, &delta_base_cache_lru) {
+	/*
+	 * Only this shard's entries can be evicted with its lock held; the
+	 * other shards get back under the limit when they next add one.
+	 */
+	list_for_each_safe(lru, tmp, &shard->probation) {
+		struct delta_base_cache_entry *f =
+			list_entry(lru, struct delta_base_cache_entry, lru);
+		if (total <= delta_base_cache_limit)
+			break;
+		total -= f->size;
+		release_delta_base_cache(shard, f);
+		evicted++;
+	}
+	list_for_each_safe(lru, tmp, &shard->protected_lru) {
 		struct delta_base_cache_entry *f =
 			list_entry(lru, struct delta_base_cache_entry, lru);
-		if (delta_base_cached <= delta_base_cache_limit)
+		if (total <= delta_base_cache_limit)
 			break;
-		release_delta_base_cache(f);
+		total -= f->size;
+		release_delta_base_cache(shard, f);
+		evicted++;
 	}
 
 	ent = xmalloc(sizeof(*ent));
@@ -1510,12 +1788,19 @@ static void add_delta_base_cache(struct packed_git *p, off_t base_offset,
 	ent->type = type;
 	ent->data = base;
 	ent->size = base_size;
-	list_add_tail(&ent->lru, &delta_base_cache_lru);
+	ent->is_protected = 0;
+	list_add_tail(&ent->lru, &shard->probation);
+	if (reused)
+		protect_delta_base_cache_entry(shard, ent);
+
+	hashmap_entry_init(&ent->ent, hash);
+	hashmap_add(&shard->map, &ent->ent);
+
+	delta_base_cache_unlock(shard);
 
-	if (!delta_base_cache.cmpfn)
-		hashmap_init(&delta_base_cache, delta_base_cache_hash_cmp, NULL, 0);
-	hashmap_entry_init(&ent->ent, pack_entry_hash(p, base_offset));
-	hashmap_add(&delta_base_cache, &ent->ent);
+	if (evicted)
+		trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_EVICT,
+				   evicted);
 }
 
 int packed_object_info(struct repository *r, struct packed_git *p,
@@ -1633,9 +1918,7 @@ static void *unpack_compressed_entry(struct packed_git *p,
 		 * unlocked execution. Please refer to the comment at
 		 * get_size_from_delta() to see how this is done.
 		 */
-		obj_read_unlock();
 		st = git_inflate(&stream, Z_FINISH);
-		obj_read_lock();
 		if (!stream.avail_out)
 			break; /* the payload is larger than it should be */
 		curpos += stream.next_in - in;
@@ -1687,17 +1970,25 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 	for (;;) {
 		off_t base_offset;
 		int i;
+		struct delta_base_cache_shard *shard =
+			delta_base_cache_shard(pack_entry_hash(p, curpos));
 		struct delta_base_cache_entry *ent;
 
-		ent = get_delta_base_cache_entry(p, curpos);
+		delta_base_cache_lock(shard);
+		ent = get_delta_base_cache_entry(shard, p, curpos);
 		if (ent) {
 			type = ent->type;
 			data = ent->data;
 			size = ent->size;
-			detach_delta_base_cache_entry(ent);
+			detach_delta_base_cache_entry(shard, ent);
 			base_from_cache = 1;
+		}
+		delta_base_cache_unlock(shard);
+		if (base_from_cache) {
+			trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HIT, 1);
 			break;
 		}
+		trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_MISS, 1);
 
 		if (do_check_packed_object_crc && p->index_version > 1) {
 			uint32_t pack_pos, index_pos;
@@ -1854,14 +2145,15 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 
 		/*
 		 * We delay adding `base` to the cache until the end of the loop
-		 * because unpack_compressed_entry() momentarily releases the
-		 * obj_read_mutex, giving another thread the chance to access
-		 * the cache. Therefore, if `base` was already there, this other
-		 * thread could free() it (e.g. to make space for another entry)
-		 * before we are done using it.
+		 * because other threads may be accessing the cache while we
+		 * inflate and patch. Therefore, if `base` was already there,
+		 * another thread could free() it (e.g. to make space for
+		 * another entry) before we are done using it.
 		 */
 		if (!external_base)
-			add_delta_base_cache(p, base_obj_offset, base, base_size, type);
+			add_delta_base_cache(p, base_obj_offset, base, base_size,
+					     type, base_from_cache);
+		base_from_cache = 0;
 
 		free(delta_data);
 		free(external_base);
@@ -1909,13 +2201,11 @@ int nth_packed_object_id(struct object_id *oid,
 			 struct packed_git *p,
 			 uint32_t n)
 {
-	const unsigned char *index = p->index_data;
+	const unsigned char *index;
 	const unsigned int hashsz = the_hash_algo->rawsz;
-	if (!index) {
-		if (open_pack_index(p))
-			return -1;
-		index = p->index_data;
-	}
+	if (open_pack_index(p))
+		return -1;
+	index = p->index_data;
 	if (n >= p->num_objects)
 		return -1;
 	index += 4 * 256;
@@ -1964,14 +2254,11 @@ off_t nth_packed_object_offset(const struct packed_git *p, uint32_t n)
 off_t find_pack_entry_one(const unsigned char *sha1,
 				  struct packed_git *p)
 {
-	const unsigned char *index = p->index_data;
 	struct object_id oid;
 	uint32_t result;
 
-	if (!index) {
-		if (open_pack_index(p))
-			return 0;
-	}
+	if (open_pack_index(p))
+		return 0;
 
 	hashcpy(oid.hash, sha1);
 	if (bsearch_pack(&oid, p, &result))
@@ -1981,9 +2268,13 @@ off_t find_pack_entry_one(const unsigned char *sha1,
 
 int is_pack_valid(struct packed_git *p)
 {
+	int ret = 1;
+
+	packed_git_lock();
+
 	/* An already open pack is known to be valid. */
 	if (p->pack_fd != -1)
-		return 1;
+		goto out;
 
 	/* If the pack has one window completely covering the
 	 * file size, the pack is known to be valid even if
@@ -1993,11 +2284,15 @@ int is_pack_valid(struct packed_git *p)
 		struct pack_window *w = p->windows;
 
 		if (!w->offset && w->len == p->pack_size)
-			return 1;
+			goto out;
 	}
 
 	/* Force the pack to open to prove its valid. */
-	return !open_packed_git(p);
+	ret = !open_packed_git(p);
+
+out:
+	packed_git_unlock();
+	return ret;
 }
 
 struct packed_git *find_sha1_pack(const unsigned char *sha1,
@@ -2055,13 +2350,16 @@ int find_pack_entry(struct repository *r, const struct object_id *oid, struct pa
 			return 1;
 	}
 
+	packed_git_lock();
 	list_for_each(pos, &r->objects->packed_git_mru) {
 		struct packed_git *p = list_entry(pos, struct packed_git, mru);
 		if (!p->multi_pack_index && fill_pack_entry(oid, e, p)) {
 			list_move(&p->mru, &r->objects->packed_git_mru);
+			packed_git_unlock();
 			return 1;
 		}
 	}
+	packed_git_unlock();
 	return 0;
 }
 
@@ -95,6 +95,23 @@ void close_pack(struct packed_git *);
 void close_object_store(struct raw_object_store *o);
 void unuse_pack(struct pack_window **);
 void clear_delta_base_cache(void);
+
+/*
+ * Pack-level locking used when the object read lock is enabled; see
+ * enable_obj_read_lock().  init_pack_locks() and destroy_pack_locks()
+ * are called when the object read lock is enabled or disabled.
+ *
+ * packed_git_lock() protects the lazily initialized state of packs
+ * (index, reverse index, fd and windows) and the packed_git_mru list.
+ * It is recursive and may be taken while holding obj_read_lock(), but
+ * not the other way around. Whether the index or reverse index is
+ * loaded is only checked with the lock held, so use open_pack_index()
+ * and load_pack_revindex() before reading them.
+ */
+void init_pack_locks(void);
+void destroy_pack_locks(void);
+void packed_git_lock(void);
+void packed_git_unlock(void);
 struct packed_git *add_packed_git(const char *path, size_t path_len, int local);
 
 /*
@@ -4,6 +4,7 @@
 #include "entry.h"
 #include "gettext.h"
 #include "hex.h"
+#include "object-store.h"
 #include "parallel-checkout.h"
 #include "pkt-line.h"
 #include "progress.h"
@@ -327,8 +328,12 @@ static int close_and_clear(int *fd)
 	return ret;
 }
 
-void write_pc_item(struct parallel_checkout_item *pc_item,
-		   struct checkout *state)
+/*
+ * Write the item, checking its leading directories with "cache", or with
+ * the default lstat cache if it is NULL.
+ */
+static void write_pc_item_1(struct parallel_checkout_item *pc_item,
+			    struct checkout *state, struct cache_def *cache)
 {
 	unsigned int mode = (pc_item->ce->ce_mode & 0100) ? 0777 : 0666;
 	int fd = -1, fstat_done = 0;
@@ -346,8 +351,12 @@ void write_pc_item(struct parallel_checkout_item *pc_item,
 	 * a symlink (checked out after we enqueued this entry for parallel
 	 * checkout). Thus, we must check the leading dirs again.
 	 */
-	if (dir_sep && !has_dirs_only_path(path.buf, dir_sep - path.buf,
-					   state->base_dir_len)) {
+	if (dir_sep &&
+	    !(cache ?
+	      threaded_has_dirs_only_path(cache, path.buf, dir_sep - path.buf,
+					  state->base_dir_len) :
+	      has_dirs_only_path(path.buf, dir_sep - path.buf,
+				 state->base_dir_len))) {
 		pc_item->status = PC_ITEM_COLLIDED;
 		trace2_data_string("pcheckout", NULL, "collision/dirname", path.buf);
 		goto out;
@@ -402,6 +411,12 @@ void write_pc_item(struct parallel_checkout_item *pc_item,
 	strbuf_release(&path);
 }
 
+void write_pc_item(struct parallel_checkout_item *pc_item,
+		   struct checkout *state)
+{
+	write_pc_item_1(pc_item, state, NULL);
+}
+
 static void send_one_item(int fd, struct parallel_checkout_item *pc_item)
 {
 	size_t len_data;
@@ -637,6 +652,76 @@ static void gather_results_from_workers(struct pc_worker *workers,
 	free(pfds);
 }
 
+struct pc_threads {
+	struct checkout *state;
+	size_t next_item;
+	pthread_mutex_t mutex;
+};
+
+static void *write_items_thread(void *data)
+{
+	struct pc_threads *pt = data;
+	struct parallel_checkout_item *done = NULL;
+	struct cache_def cache = CACHE_DEF_INIT;
+
+	trace2_thread_start("pcheckout_worker");
+
+	for (;;) {
+		struct parallel_checkout_item *pc_item = NULL;
+
+		pthread_mutex_lock(&pt->mutex);
+		if (done && done->status != PC_ITEM_COLLIDED)
+			advance_progress_meter();
+		if (pt->next_item < parallel_checkout.nr)
+			pc_item = &parallel_checkout.items[pt->next_item++];
+		pthread_mutex_unlock(&pt->mutex);
+
+		if (!pc_item)
+			break;
+		write_pc_item_1(pc_item, pt->state, &cache);
+		done = pc_item;
+	}
+
+	cache_def_clear(&cache);
+	trace2_thread_exit();
+	return NULL;
+}
+
+/*
+ * Write the items from "num_workers" threads of this process, which take
+ * the next item in the queue as they become free. Unlike with
+ * checkout--worker processes, there is no need to ship the items and the
+ * results through pipes, or for each worker to set up its own repository
+ * and object store.
+ */
+static void write_items_in_threads(struct checkout *state, int num_workers)
+{
+	struct pc_threads pt = { .state = state };
+	pthread_t *threads;
+	int i, err;
+
+	ALLOC_ARRAY(threads, num_workers);
+	pthread_mutex_init(&pt.mutex, NULL);
+	enable_obj_read_lock();
+
+	for (i = 0; i < num_workers; i++) {
+		err = pthread_create(&threads[i], NULL, write_items_thread, &pt);
+		if (err)
+			die(_("unable to create checkout worker thread: %s"),
+			    strerror(err));
+	}
+	for (i = 0; i < num_workers; i++) {
+		err = pthread_join(threads[i], NULL);
+		if (err)
+			die(_("unable to join checkout worker thread: %s"),
+			    strerror(err));
+	}
+
+	disable_obj_read_lock();
+	pthread_mutex_destroy(&pt.mutex);
+	free(threads);
+}
+
 static void write_items_sequentially(struct checkout *state)
 {
 	size_t i;
@@ -649,6 +734,16 @@ static void write_items_sequentially(struct checkout *state)
 	}
 }
 
+static int use_worker_threads(void)
+{
+	int threaded = 0;
+
+	if (!HAVE_THREADS)
+		return 0;
+	git_config_get_bool("checkout.threadedworkers", &threaded);
+	return threaded;
+}
+
 int run_parallel_checkout(struct checkout *state, int num_workers, int threshold,
 			  struct progress *progress, unsigned int *progress_cnt)
 {
@@ -666,6 +761,8 @@ int run_parallel_checkout(struct checkout *state, int num_workers, int threshold
 
 	if (num_workers <= 1 || parallel_checkout.nr < threshold) {
 		write_items_sequentially(state);
+	} else if (use_worker_threads()) {
+		write_items_in_threads(state, num_workers);
 	} else {
 		struct pc_worker *workers = setup_workers(state, num_workers);
 		gather_results_from_workers(workers, num_workers);
@@ -8,6 +8,7 @@
 #include "fsmonitor.h"
 #include "gettext.h"
 #include "config.h"
+#include "lstat-ring.h"
 #include "progress.h"
 #include "thread-utils.h"
 #include "repository.h"
@@ -22,6 +23,12 @@
 #define MAX_PARALLEL (20)
 #define THREAD_COST (500)
 
+/*
+ * How many lstat's each thread keeps in flight at a time when it can
+ * batch them with an lstat_ring.
+ */
+#define RING_DEPTH (256)
+
 struct progress_data {
 	unsigned long n;
 	struct progress *progress;
@@ -34,9 +41,54 @@ struct thread_data {
 	struct pathspec pathspec;
 	struct progress_data *progress;
 	int offset, nr;
+	int use_ring;
 	int t2_nr_lstat;
+	int t2_nr_ring_lstat;
 };
 
+struct lstat_batch {
+	struct lstat_ring *ring;
+	unsigned int nr;
+	struct cache_entry *ce[RING_DEPTH];
+	const char *path[RING_DEPTH];
+	struct stat st[RING_DEPTH];
+	int ret[RING_DEPTH];
+};
+
+static void mark_uptodate_if_unchanged(struct index_state *index,
+				       struct cache_entry *ce,
+				       struct stat *st)
+{
+	if (ie_match_stat(index, ce, st, CE_MATCH_RACY_IS_DIRTY|CE_MATCH_IGNORE_FSMONITOR))
+		return;
+	ce_mark_uptodate(ce);
+	mark_fsmonitor_valid(index, ce);
+}
+
+static void flush_lstat_batch(struct thread_data *p, struct lstat_batch *batch)
+{
+	unsigned int i;
+
+	if (!batch->nr)
+		return;
+	if (lstat_ring_run(batch->ring, batch->nr, batch->path,
+			   batch->st, batch->ret)) {
+		/* give up on the ring, and lstat() one at a time */
+		lstat_ring_free(batch->ring);
+		batch->ring = NULL;
+		for (i = 0; i < batch->nr; i++)
+			batch->ret[i] = lstat(batch->path[i], &batch->st[i]);
+	} else {
+		p->t2_nr_ring_lstat += batch->nr;
+	}
+
+	for (i = 0; i < batch->nr; i++)
+		if (!batch->ret[i])
+			mark_uptodate_if_unchanged(p->index, batch->ce[i],
+						   &batch->st[i]);
+	batch->nr = 0;
+}
+
 static void *preload_thread(void *_data)
 {
 	int nr, last_nr;
@@ -44,12 +96,22 @@ static void *preload_thread(void *_data)
 	struct index_state *index = p->index;
 	struct cache_entry **cep = index->cache + p->offset;
 	struct cache_def cache = CACHE_DEF_INIT;
+	struct lstat_batch *batch = NULL;
 
 	nr = p->nr;
 	if (nr + p->offset > index->cache_nr)
 		nr = index->cache_nr - p->offset;
 	last_nr = nr;
 
+	if (p->use_ring) {
+		struct lstat_ring *ring = lstat_ring_new(RING_DEPTH);
+
+		if (ring) {
+			CALLOC_ARRAY(batch, 1);
+			batch->ring = ring;
+		}
+	}
+
 	do {
 		struct cache_entry *ce = *cep++;
 		struct stat st;
@@ -78,13 +140,22 @@ static void *preload_thread(void *_data)
 		if (threaded_has_symlink_leading_path(&cache, ce->name, ce_namelen(ce)))
 			continue;
 		p->t2_nr_lstat++;
-		if (lstat(ce->name, &st))
+		if (batch && batch->ring) {
+			batch->ce[batch->nr] = ce;
+			batch->path[batch->nr] = ce->name;
+			if (++batch->nr == RING_DEPTH)
+				flush_lstat_batch(p, batch);
 			continue;
-		if (ie_match_stat(index, ce, &st, CE_MATCH_RACY_IS_DIRTY|CE_MATCH_IGNORE_FSMONITOR))
+		}
+		if (lstat(ce->name, &st))
 			continue;
-		ce_mark_uptodate(ce);
-		mark_fsmonitor_valid(index, ce);
+		mark_uptodate_if_unchanged(index, ce, &st);
 	} while (--nr > 0);
+	if (batch) {
+		flush_lstat_batch(p, batch);
+		lstat_ring_free(batch->ring);
+		free(batch);
+	}
 	if (p->progress) {
 		struct progress_data *pd = p->progress;
 
@@ -103,7 +174,8 @@ void preload_index(struct index_state *index,
 	int threads, i, work, offset;
 	struct thread_data data[MAX_PARALLEL];
 	struct progress_data pd;
-	int t2_sum_lstat = 0;
+	int t2_sum_lstat = 0, t2_sum_ring_lstat = 0;
+	int use_ring = 0;
 
 	if (!HAVE_THREADS || !core_preload_index)
 		return;
@@ -114,6 +186,9 @@ void preload_index(struct index_state *index,
 	if (threads < 2)
 		return;
 
+	repo_config_get_bool(index->repo ? index->repo : the_repository,
+			     "core.preloadindexiouring", &use_ring);
+
 	trace2_region_enter("index", "preload", NULL);
 
 	trace_performance_enter();
@@ -138,6 +213,7 @@ void preload_index(struct index_state *index,
 			copy_pathspec(&p->pathspec, pathspec);
 		p->offset = offset;
 		p->nr = work;
+		p->use_ring = use_ring;
 		if (pd.progress)
 			p->progress = &pd;
 		offset += work;
@@ -151,6 +227,7 @@ void preload_index(struct index_state *index,
 		if (pthread_join(p->pthread, NULL))
 			die("unable to join threaded lstat");
 		t2_sum_lstat += p->t2_nr_lstat;
+		t2_sum_ring_lstat += p->t2_nr_ring_lstat;
 	}
 	stop_progress(&pd.progress);
 
@@ -163,6 +240,9 @@ void preload_index(struct index_state *index,
 	trace_performance_leave("preload index");
 
 	trace2_data_intmax("index", NULL, "preload/sum_lstat", t2_sum_lstat);
+	if (t2_sum_ring_lstat)
+		trace2_data_intmax("index", NULL, "preload/sum_ring_lstat",
+				   t2_sum_ring_lstat);
 	trace2_region_leave("index", "preload", NULL);
 }
 
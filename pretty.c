@@ -5,6 +5,7 @@
 #include "environment.h"
 #include "gettext.h"
 #include "hex.h"
+#include "object-store.h"
 #include "utf8.h"
 #include "diff.h"
 #include "pager.h"
@@ -425,8 +426,8 @@ static void add_rfc2047(struct strbuf *sb, const char *line, size_t len,
 	strbuf_addstr(sb, "?=");
 }
 
-const char *show_ident_date(const struct ident_split *ident,
-			    const struct date_mode *mode)
+static void ident_date(const struct ident_split *ident,
+		       timestamp_t *date_out, int *tz_out)
 {
 	timestamp_t date = 0;
 	long tz = 0;
@@ -441,9 +442,34 @@ const char *show_ident_date(const struct ident_split *ident,
 		if (tz >= INT_MAX || tz <= INT_MIN)
 			tz = 0;
 	}
+	*date_out = date;
+	*tz_out = tz;
+}
+
+const char *show_ident_date(const struct ident_split *ident,
+			    const struct date_mode *mode)
+{
+	timestamp_t date;
+	int tz;
+
+	ident_date(ident, &date, &tz);
 	return show_date(date, tz, mode);
 }
 
+/*
+ * Like show_ident_date(), but append to "sb"; the pretty-printers use
+ * this so that they may run in several threads at once.
+ */
+static void add_ident_date(struct strbuf *sb, const struct ident_split *ident,
+			   const struct date_mode *mode)
+{
+	timestamp_t date;
+	int tz;
+
+	ident_date(ident, &date, &tz);
+	show_date_buf(sb, date, tz, mode);
+}
+
 static inline void strbuf_add_with_color(struct strbuf *sb, const char *color,
 					 const char *buf, size_t buflen)
 {
@@ -589,17 +615,20 @@ void pp_user_info(struct pretty_print_context *pp,
 
 	switch (pp->fmt) {
 	case CMIT_FMT_MEDIUM:
-		strbuf_addf(sb, "Date:   %s\n",
-			    show_ident_date(&ident, &pp->date_mode));
+		strbuf_addstr(sb, "Date:   ");
+		add_ident_date(sb, &ident, &pp->date_mode);
+		strbuf_addch(sb, '\n');
 		break;
 	case CMIT_FMT_EMAIL:
 	case CMIT_FMT_MBOXRD:
-		strbuf_addf(sb, "Date: %s\n",
-			    show_ident_date(&ident, DATE_MODE(RFC2822)));
+		strbuf_addstr(sb, "Date: ");
+		add_ident_date(sb, &ident, DATE_MODE(RFC2822));
+		strbuf_addch(sb, '\n');
 		break;
 	case CMIT_FMT_FULLER:
-		strbuf_addf(sb, "%sDate: %s\n", what,
-			    show_ident_date(&ident, &pp->date_mode));
+		strbuf_addf(sb, "%sDate: ", what);
+		add_ident_date(sb, &ident, &pp->date_mode);
+		strbuf_addch(sb, '\n');
 		break;
 	default:
 		/* notin' */
@@ -630,6 +659,38 @@ const char *skip_blank_lines(const char *msg)
 	return msg;
 }
 
+/*
+ * The pretty-printers may run in several threads at once (see
+ * log_tree_format_message()), so avoid oid_to_hex()'s static buffers,
+ * and hold the object read lock while abbreviating, which fills the
+ * loose object cache, and while loading the tree of a commit that came
+ * from the commit-graph, which adds it to the object hash.
+ */
+static void add_oid_hex(struct strbuf *sb, const struct object_id *oid)
+{
+	char hex[GIT_MAX_HEXSZ + 1];
+
+	strbuf_addstr(sb, oid_to_hex_r(hex, oid));
+}
+
+static void add_unique_abbrev(struct strbuf *sb, const struct object_id *oid,
+			      int abbrev)
+{
+	obj_read_lock();
+	strbuf_add_unique_abbrev(sb, oid, abbrev);
+	obj_read_unlock();
+}
+
+static const struct object_id *commit_tree_oid(const struct commit *commit)
+{
+	const struct object_id *oid;
+
+	obj_read_lock();
+	oid = get_commit_tree_oid(commit);
+	obj_read_unlock();
+	return oid;
+}
+
 static void add_merge_info(const struct pretty_print_context *pp,
 			   struct strbuf *sb, const struct commit *commit)
 {
@@ -645,9 +706,9 @@ static void add_merge_info(const struct pretty_print_context *pp,
 		struct object_id *oidp = &parent->item->object.oid;
 		strbuf_addch(sb, ' ');
 		if (pp->abbrev)
-			strbuf_add_unique_abbrev(sb, oidp, pp->abbrev);
+			add_unique_abbrev(sb, oidp, pp->abbrev);
 		else
-			strbuf_addstr(sb, oid_to_hex(oidp));
+			add_oid_hex(sb, oidp);
 		parent = parent->next;
 	}
 	strbuf_addch(sb, '\n');
@@ -817,25 +878,25 @@ static size_t format_person_part(struct strbuf *sb, char part,
 
 	switch (part) {
 	case 'd':	/* date */
-		strbuf_addstr(sb, show_ident_date(&s, dmode));
+		add_ident_date(sb, &s, dmode);
 		return placeholder_len;
 	case 'D':	/* date, RFC2822 style */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(RFC2822)));
+		add_ident_date(sb, &s, DATE_MODE(RFC2822));
 		return placeholder_len;
 	case 'r':	/* date, relative */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(RELATIVE)));
+		add_ident_date(sb, &s, DATE_MODE(RELATIVE));
 		return placeholder_len;
 	case 'i':	/* date, ISO 8601-like */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(ISO8601)));
+		add_ident_date(sb, &s, DATE_MODE(ISO8601));
 		return placeholder_len;
 	case 'I':	/* date, ISO 8601 strict */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(ISO8601_STRICT)));
+		add_ident_date(sb, &s, DATE_MODE(ISO8601_STRICT));
 		return placeholder_len;
 	case 'h':	/* date, human */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(HUMAN)));
+		add_ident_date(sb, &s, DATE_MODE(HUMAN));
 		return placeholder_len;
 	case 's':
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(SHORT)));
+		add_ident_date(sb, &s, DATE_MODE(SHORT));
 		return placeholder_len;
 	}
 
@@ -1490,36 +1551,35 @@ static size_t format_commit_one(struct strbuf *sb, /* in UTF-8 */
 	switch (placeholder[0]) {
 	case 'H':		/* commit hash */
 		strbuf_addstr(sb, diff_get_color(c->auto_color, DIFF_COMMIT));
-		strbuf_addstr(sb, oid_to_hex(&commit->object.oid));
+		add_oid_hex(sb, &commit->object.oid);
 		strbuf_addstr(sb, diff_get_color(c->auto_color, DIFF_RESET));
 		return 1;
 	case 'h':		/* abbreviated commit hash */
 		strbuf_addstr(sb, diff_get_color(c->auto_color, DIFF_COMMIT));
-		strbuf_add_unique_abbrev(sb, &commit->object.oid,
-					 c->pretty_ctx->abbrev);
+		add_unique_abbrev(sb, &commit->object.oid,
+				  c->pretty_ctx->abbrev);
 		strbuf_addstr(sb, diff_get_color(c->auto_color, DIFF_RESET));
 		return 1;
 	case 'T':		/* tree hash */
-		strbuf_addstr(sb, oid_to_hex(get_commit_tree_oid(commit)));
+		add_oid_hex(sb, commit_tree_oid(commit));
 		return 1;
 	case 't':		/* abbreviated tree hash */
-		strbuf_add_unique_abbrev(sb,
-					 get_commit_tree_oid(commit),
-					 c->pretty_ctx->abbrev);
+		add_unique_abbrev(sb, commit_tree_oid(commit),
+				  c->pretty_ctx->abbrev);
 		return 1;
 	case 'P':		/* parent hashes */
 		for (p = commit->parents; p; p = p->next) {
 			if (p != commit->parents)
 				strbuf_addch(sb, ' ');
-			strbuf_addstr(sb, oid_to_hex(&p->item->object.oid));
+			add_oid_hex(sb, &p->item->object.oid);
 		}
 		return 1;
 	case 'p':		/* abbreviated parent hashes */
 		for (p = commit->parents; p; p = p->next) {
 			if (p != commit->parents)
 				strbuf_addch(sb, ' ');
-			strbuf_add_unique_abbrev(sb, &p->item->object.oid,
-						 c->pretty_ctx->abbrev);
+			add_unique_abbrev(sb, &p->item->object.oid,
+					  c->pretty_ctx->abbrev);
 		}
 		return 1;
 	case 'm':		/* left/right/bottom */
@@ -1882,6 +1942,13 @@ static size_t userformat_want_item(struct strbuf *sb UNUSED,
 	case 'D':
 		w->decorate = 1;
 		break;
+	case 'G':
+		w->serial = 1;
+		break;
+	case '(':
+		if (starts_with(placeholder + 1, "describe"))
+			w->serial = 1;
+		break;
 	}
 	return 0;
 }
@@ -75,6 +75,7 @@ struct userformat_want {
 	unsigned notes:1;
 	unsigned source:1;
 	unsigned decorate:1;
+	unsigned serial:1; /* placeholders that cannot be expanded in threads */
 };
 void userformat_find_requirements(const char *fmt, struct userformat_want *w);
 
@@ -1893,8 +1893,23 @@ static int read_index_extension(struct index_state *istate,
 }
 
 /*
- * Parses the contents of the cache entry contained within the 'ondisk' buffer
- * into a new incore 'cache_entry'.
+ * The flags and name of an on-disk cache entry, as parsed by
+ * parse_ondisk_name().
+ */
+struct ondisk_name {
+	unsigned int flags;
+	size_t len;		/* of the full name */
+	size_t copy_len;	/* bytes taken from the previous name (v4) */
+	const char *name;	/* the bytes stored after the flags */
+};
+
+/*
+ * Parses the flags and the name length of the cache entry contained
+ * within the 'ondisk' buffer; see create_from_disk().
+ *
+ * Without 'end', the entry is trusted to be within the buffer, and a
+ * malformed entry is fatal. With 'end', the entry is checked not to run
+ * past it, and -1 is returned if it is malformed.
  *
  * Note that 'char *ondisk' may not be aligned to a 4-byte address interval in
  * index v4, so we cannot cast it to 'struct ondisk_cache_entry *' and access
@@ -1903,19 +1918,14 @@ static int read_index_extension(struct index_state *istate,
  * read from an unaligned memory buffer) should read from the 'ondisk' buffer
  * into the corresponding incore 'cache_entry' members.
  */
-static struct cache_entry *create_from_disk(struct mem_pool *ce_mem_pool,
-					    unsigned int version,
-					    const char *ondisk,
-					    unsigned long *ent_size,
-					    const struct cache_entry *previous_ce)
+static int parse_ondisk_name(unsigned int version, const char *ondisk,
+			     const char *end,
+			     const struct cache_entry *previous_ce,
+			     struct ondisk_name *on)
 {
-	struct cache_entry *ce;
-	size_t len;
-	const char *name;
 	const unsigned hashsz = the_hash_algo->rawsz;
 	const char *flagsp = ondisk + offsetof(struct ondisk_cache_entry, data) + hashsz;
-	unsigned int flags;
-	size_t copy_len = 0;
+	const char *nul = NULL;
 	/*
 	 * Adjacent cache entries tend to share the leading paths, so it makes
 	 * sense to only store the differences in later entries.  In the v4
@@ -1925,46 +1935,83 @@ static struct cache_entry *create_from_disk(struct mem_pool *ce_mem_pool,
 	 */
 	int expand_name_field = version == 4;
 
+	if (end && (flagsp > end || end - flagsp < 2 * sizeof(uint16_t)))
+		return -1;
+
 	/* On-disk flags are just 16 bits */
-	flags = get_be16(flagsp);
-	len = flags & CE_NAMEMASK;
+	on->flags = get_be16(flagsp);
+	on->len = on->flags & CE_NAMEMASK;
+	on->copy_len = 0;
 
-	if (flags & CE_EXTENDED) {
+	if (on->flags & CE_EXTENDED) {
 		int extended_flags;
 		extended_flags = get_be16(flagsp + sizeof(uint16_t)) << 16;
 		/* We do not yet understand any bit out of CE_EXTENDED_FLAGS */
-		if (extended_flags & ~CE_EXTENDED_FLAGS)
+		if (extended_flags & ~CE_EXTENDED_FLAGS) {
+			if (end)
+				return -1;
 			die(_("unknown index entry format 0x%08x"), extended_flags);
-		flags |= extended_flags;
-		name = (const char *)(flagsp + 2 * sizeof(uint16_t));
+		}
+		on->flags |= extended_flags;
+		on->name = (const char *)(flagsp + 2 * sizeof(uint16_t));
 	}
 	else
-		name = (const char *)(flagsp + sizeof(uint16_t));
+		on->name = (const char *)(flagsp + sizeof(uint16_t));
+
+	/*
+	 * The name ends with a NUL in all versions, and in v4 the varint
+	 * before it stops at that NUL at the latest.
+	 */
+	if (end) {
+		nul = on->name < end ? memchr(on->name, '\0', end - on->name) : NULL;
+		if (!nul)
+			return -1;
+	}
 
 	if (expand_name_field) {
-		const unsigned char *cp = (const unsigned char *)name;
+		const unsigned char *cp = (const unsigned char *)on->name;
 		size_t strip_len, previous_len;
 
 		/* If we're at the beginning of a block, ignore the previous name */
 		strip_len = decode_varint(&cp);
 		if (previous_ce) {
 			previous_len = previous_ce->ce_namelen;
-			if (previous_len < strip_len)
+			if (previous_len < strip_len) {
+				if (end)
+					return -1;
 				die(_("malformed name field in the index, near path '%s'"),
 					previous_ce->name);
-			copy_len = previous_len - strip_len;
+			}
+			on->copy_len = previous_len - strip_len;
 		}
-		name = (const char *)cp;
+		on->name = (const char *)cp;
+		if (end && on->name > nul)
+			return -1;
 	}
 
-	if (len == CE_NAMEMASK) {
-		len = strlen(name);
+	if (on->len == CE_NAMEMASK) {
+		on->len = strlen(on->name);
 		if (expand_name_field)
-			len += copy_len;
+			on->len += on->copy_len;
+	} else if (end) {
+		/* the name is copied up to and including its NUL */
+		if (on->len < on->copy_len ||
+		    on->len - on->copy_len > nul - on->name)
+			return -1;
 	}
+	return 0;
+}
 
-	ce = mem_pool__ce_alloc(ce_mem_pool, len);
-
+/*
+ * Fills 'ce', which has room for the name, from the cache entry
+ * contained within the 'ondisk' buffer. In index v4, 'ce' may be
+ * 'previous_ce' itself, whose name then still holds the previous name.
+ */
+static void fill_from_disk(struct cache_entry *ce, unsigned int version,
+			   const char *ondisk, const struct ondisk_name *on,
+			   unsigned long *ent_size,
+			   const struct cache_entry *previous_ce)
+{
 	/*
 	 * NEEDSWORK: using 'offsetof()' is cumbersome and should be replaced
 	 * with something more akin to 'load_bitmap_entries_v1()'s use of
@@ -1987,20 +2034,39 @@ static struct cache_entry *create_from_disk(struct mem_pool *ce_mem_pool,
 	ce->ce_stat_data.sd_uid   = get_be32(ondisk + offsetof(struct ondisk_cache_entry, uid));
 	ce->ce_stat_data.sd_gid   = get_be32(ondisk + offsetof(struct ondisk_cache_entry, gid));
 	ce->ce_stat_data.sd_size  = get_be32(ondisk + offsetof(struct ondisk_cache_entry, size));
-	ce->ce_flags = flags & ~CE_NAMEMASK;
-	ce->ce_namelen = len;
+	ce->ce_flags = on->flags & ~CE_NAMEMASK;
+	ce->ce_namelen = on->len;
 	ce->index = 0;
 	oidread(&ce->oid, (const unsigned char *)ondisk + offsetof(struct ondisk_cache_entry, data));
 
-	if (expand_name_field) {
-		if (copy_len)
-			memcpy(ce->name, previous_ce->name, copy_len);
-		memcpy(ce->name + copy_len, name, len + 1 - copy_len);
-		*ent_size = (name - ((char *)ondisk)) + len + 1 - copy_len;
+	if (version == 4) {
+		if (on->copy_len && ce != previous_ce)
+			memcpy(ce->name, previous_ce->name, on->copy_len);
+		memcpy(ce->name + on->copy_len, on->name,
+		       on->len + 1 - on->copy_len);
+		*ent_size = (on->name - ((char *)ondisk)) + on->len + 1 - on->copy_len;
 	} else {
-		memcpy(ce->name, name, len + 1);
+		memcpy(ce->name, on->name, on->len + 1);
 		*ent_size = ondisk_ce_size(ce);
 	}
+}
+
+/*
+ * Parses the contents of the cache entry contained within the 'ondisk' buffer
+ * into a new incore 'cache_entry'.
+ */
+static struct cache_entry *create_from_disk(struct mem_pool *ce_mem_pool,
+					    unsigned int version,
+					    const char *ondisk,
+					    unsigned long *ent_size,
+					    const struct cache_entry *previous_ce)
+{
+	struct cache_entry *ce;
+	struct ondisk_name on;
+
+	parse_ondisk_name(version, ondisk, NULL, previous_ce, &on);
+	ce = mem_pool__ce_alloc(ce_mem_pool, on.len);
+	fill_from_disk(ce, version, ondisk, &on, ent_size, previous_ce);
 	return ce;
 }
 
@@ -2458,6 +2524,29 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 	die(_("index file corrupt"));
 }
 
+static unsigned long get_shared_index_expire_date(void);
+
+/*
+ * Shared index files are only deleted once they have not been
+ * freshened for splitIndex.sharedIndexExpire, so there is no need to
+ * touch one on every read and write: only do so when it is over half
+ * that age, as seen when "base" was read from it.
+ */
+static int shared_index_needs_freshening(const struct index_state *base)
+{
+	unsigned long expiration = get_shared_index_expire_date();
+	time_t now;
+
+	if (!expiration)
+		return 0; /* never expires */
+	if (!base->timestamp.sec)
+		return 1;
+	now = time(NULL);
+	if (now <= expiration)
+		return 1;
+	return base->timestamp.sec <= expiration + (now - expiration) / 2;
+}
+
 /*
  * Signal that the shared index is used by updating its mtime.
  *
@@ -2531,7 +2620,8 @@ int read_index_from(struct index_state *istate, const char *path,
 		    base_oid_hex, base_path,
 		    oid_to_hex(&split_index->base->oid));
 
-	freshen_shared_index(base_path, 0);
+	if (shared_index_needs_freshening(split_index->base))
+		freshen_shared_index(base_path, 0);
 	merge_base_index(istate);
 	post_read_index_from(istate);
 	trace_performance_leave("read cache %s", base_path);
@@ -2539,6 +2629,164 @@ int read_index_from(struct index_state *istate, const char *path,
 	return ret;
 }
 
+/*
+ * Find where the extensions of a mapped index start, by walking over
+ * its entries. Returns 0 if they run past the end of the file.
+ */
+static size_t find_index_extensions(const char *mmap, size_t mmap_size,
+				    unsigned int version, unsigned int nr)
+{
+	size_t offset = sizeof(struct cache_header);
+	size_t end = mmap_size - the_hash_algo->rawsz;
+	size_t min_size = offsetof(struct ondisk_cache_entry, data) +
+			  the_hash_algo->rawsz + sizeof(uint16_t);
+	struct ondisk_name on;
+	size_t previous_len = 0;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		const char *ondisk = mmap + offset;
+		size_t ent_size;
+
+		if (end - offset < min_size ||
+		    !memchr(ondisk + min_size, '\0', end - offset - min_size))
+			return 0;
+		on.flags = get_be16(ondisk + min_size - sizeof(uint16_t));
+		if (version == 4) {
+			const unsigned char *cp;
+			size_t strip_len;
+
+			cp = (const unsigned char *)ondisk + min_size;
+			if (on.flags & CE_EXTENDED)
+				cp += sizeof(uint16_t);
+			strip_len = decode_varint(&cp);
+			if (strip_len > previous_len)
+				return 0;
+			on.name = (const char *)cp;
+			on.len = previous_len - strip_len + strlen(on.name);
+			ent_size = on.name - ondisk + strlen(on.name) + 1;
+			previous_len = on.len;
+		} else {
+			on.len = strlen(ondisk + min_size +
+					((on.flags & CE_EXTENDED) ?
+					 sizeof(uint16_t) : 0));
+			ent_size = ondisk_cache_entry_size(
+				ondisk_data_size(on.flags, on.len));
+		}
+		if (ent_size > end - offset)
+			return 0;
+		offset += ent_size;
+	}
+	return offset;
+}
+
+int index_entry_iter_init(struct index_entry_iter *iter, const char *path)
+{
+	int fd;
+	struct stat st;
+	const struct cache_header *hdr;
+	size_t offset;
+
+	memset(iter, 0, sizeof(*iter));
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) ||
+	    xsize_t(st.st_size) < sizeof(struct cache_header) + the_hash_algo->rawsz) {
+		close(fd);
+		return -1;
+	}
+	iter->mmap_size = xsize_t(st.st_size);
+	iter->mmap = xmmap_gently(NULL, iter->mmap_size, PROT_READ,
+				  MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (iter->mmap == MAP_FAILED) {
+		iter->mmap = NULL;
+		return -1;
+	}
+
+	hdr = (const struct cache_header *)iter->mmap;
+	if (verify_hdr(hdr, iter->mmap_size) < 0)
+		goto fail;
+	iter->version = ntohl(hdr->hdr_version);
+	iter->nr = ntohl(hdr->hdr_entries);
+
+	/*
+	 * The entries of a split index only make sense together with
+	 * its shared index, and those of a sparse index may need to be
+	 * expanded; leave these, and any other extension that must be
+	 * understood, to read_index_from().
+	 */
+	offset = read_eoie_extension(iter->mmap, iter->mmap_size);
+	if (!offset)
+		offset = find_index_extensions(iter->mmap, iter->mmap_size,
+					       iter->version, iter->nr);
+	if (!offset)
+		goto fail;
+	while (offset <= iter->mmap_size - the_hash_algo->rawsz - 8) {
+		const char *ext = iter->mmap + offset;
+
+		if (*ext < 'A' || 'Z' < *ext)
+			goto fail;
+		offset += 8 + get_be32(ext + 4);
+	}
+
+	iter->offset = sizeof(*hdr);
+	return 0;
+
+fail:
+	munmap((void *)iter->mmap, iter->mmap_size);
+	iter->mmap = NULL;
+	return -1;
+}
+
+const struct cache_entry *index_entry_iter_next(struct index_entry_iter *iter)
+{
+	const char *ondisk, *end;
+	struct ondisk_name on;
+	unsigned long consumed;
+	const struct cache_entry *previous_ce = NULL;
+
+	if (iter->pos >= iter->nr || iter->malformed)
+		return NULL;
+
+	ondisk = iter->mmap + iter->offset;
+	end = iter->mmap + iter->mmap_size - the_hash_algo->rawsz;
+	if (iter->pos && iter->version == 4)
+		previous_ce = iter->ce;
+	if (ondisk > end ||
+	    parse_ondisk_name(iter->version, ondisk, end, previous_ce, &on)) {
+		iter->malformed = 1;
+		return NULL;
+	}
+
+	if (cache_entry_size(on.len) > iter->ce_alloc) {
+		iter->ce_alloc = cache_entry_size(on.len);
+		iter->ce = xrealloc(iter->ce, iter->ce_alloc);
+		iter->ce->mem_pool_allocated = 0;
+		if (previous_ce)
+			previous_ce = iter->ce;
+	}
+	fill_from_disk(iter->ce, iter->version, ondisk, &on, &consumed,
+		       previous_ce);
+	if (consumed > end - ondisk) {
+		iter->malformed = 1;
+		return NULL;
+	}
+
+	iter->offset += consumed;
+	iter->pos++;
+	return iter->ce;
+}
+
+void index_entry_iter_release(struct index_entry_iter *iter)
+{
+	if (iter->mmap)
+		munmap((void *)iter->mmap, iter->mmap_size);
+	free(iter->ce);
+	memset(iter, 0, sizeof(*iter));
+}
+
 int is_index_unborn(struct index_state *istate)
 {
 	return (!istate->cache_nr && !istate->timestamp.sec);
@@ -3474,7 +3722,8 @@ int write_locked_index(struct index_state *istate, struct lock_file *lock,
 	ret = write_split_index(istate, lock, flags);
 
 	/* Freshen the shared index only if the split-index was written */
-	if (!ret && !new_shared_index && !is_null_oid(&si->base_oid)) {
+	if (!ret && !new_shared_index && !is_null_oid(&si->base_oid) &&
+	    (!si->base || shared_index_needs_freshening(si->base))) {
 		const char *shared_index = git_path("sharedindex.%s",
 						    oid_to_hex(&si->base_oid));
 		freshen_shared_index(shared_index, 1);
@@ -2300,8 +2300,6 @@ static int filter_ref_kind(struct ref_filter *filter, const char *refname)
 struct ref_filter_cbdata {
 	struct ref_array *array;
 	struct ref_filter *filter;
-	struct contains_cache contains_cache;
-	struct contains_cache no_contains_cache;
 };
 
 /*
@@ -2338,23 +2336,16 @@ static int ref_filter_handler(const char *refname, const struct object_id *oid,
 		return 0;
 
 	/*
-	 * A merge filter is applied on refs pointing to commits. Hence
-	 * obtain the commit using the 'oid' available and discard all
-	 * non-commits early. The actual filtering is done later.
+	 * A merge or contains filter is applied on refs pointing to
+	 * commits. Hence obtain the commit using the 'oid' available and
+	 * discard all non-commits early. The actual filtering is done
+	 * later.
 	 */
 	if (filter->reachable_from || filter->unreachable_from ||
 	    filter->with_commit || filter->no_commit || filter->verbose) {
 		commit = lookup_commit_reference_gently(the_repository, oid, 1);
 		if (!commit)
 			return 0;
-		/* We perform the filtering for the '--contains' option... */
-		if (filter->with_commit &&
-		    !commit_contains(filter, commit, filter->with_commit, &ref_cbdata->contains_cache))
-			return 0;
-		/* ...or for the `--no-contains' option */
-		if (filter->no_commit &&
-		    commit_contains(filter, commit, filter->no_commit, &ref_cbdata->no_contains_cache))
-			return 0;
 	}
 
 	/*
@@ -2461,6 +2452,46 @@ static void reach_filter(struct ref_array *array,
 	free(to_clear);
 }
 
+/*
+ * Keep the refs that contain any commit in "list" if "include" is
+ * set, or those that contain none of them otherwise.  All refs are
+ * looked at together, so that reachability bitmaps can answer for
+ * many of them at once.
+ */
+static void contains_filter(struct ref_array *array,
+			    struct ref_filter *filter,
+			    struct commit_list *list, int include)
+{
+	struct commit **tips;
+	unsigned char *contains;
+	int i, old_nr;
+
+	if (!list || !array->nr)
+		return;
+
+	ALLOC_ARRAY(tips, array->nr);
+	ALLOC_ARRAY(contains, array->nr);
+	for (i = 0; i < array->nr; i++)
+		tips[i] = array->items[i]->commit;
+
+	commit_contains_many(filter, tips, array->nr, list, contains);
+
+	old_nr = array->nr;
+	array->nr = 0;
+
+	for (i = 0; i < old_nr; i++) {
+		struct ref_array_item *item = array->items[i];
+
+		if (!!contains[i] == include)
+			array->items[array->nr++] = item;
+		else
+			free_array_item(item);
+	}
+
+	free(tips);
+	free(contains);
+}
+
 void filter_ahead_behind(struct repository *r,
 			 struct ref_format *format,
 			 struct ref_array *array)
@@ -2522,9 +2553,6 @@ int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int
 	save_commit_buffer_orig = save_commit_buffer;
 	save_commit_buffer = 0;
 
-	init_contains_cache(&ref_cbdata.contains_cache);
-	init_contains_cache(&ref_cbdata.no_contains_cache);
-
 	/*  Simple per-ref filtering */
 	if (!filter->kind)
 		die("filter_refs: invalid type");
@@ -2547,10 +2575,9 @@ int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int
 			head_ref(ref_filter_handler, &ref_cbdata);
 	}
 
-	clear_contains_cache(&ref_cbdata.contains_cache);
-	clear_contains_cache(&ref_cbdata.no_contains_cache);
-
 	/*  Filters that need revision walking */
+	contains_filter(array, filter, filter->with_commit, 1);
+	contains_filter(array, filter, filter->no_commit, 0);
 	reach_filter(array, filter->reachable_from, INCLUDE_REACHED);
 	reach_filter(array, filter->unreachable_from, EXCLUDE_REACHED);
 
@@ -34,6 +34,7 @@ struct repo_settings {
 	int commit_graph_read_changed_paths;
 	int gc_write_commit_graph;
 	int fetch_write_commit_graph;
+	int commit_graph_max_layers;
 	int command_requires_full_index;
 	int sparse_index;
 	int pack_read_reverse_index;
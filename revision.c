@@ -37,9 +37,12 @@
 #include "commit-reach.h"
 #include "commit-graph.h"
 #include "prio-queue.h"
+#include "commit-queue.h"
+#include "ewah/ewok.h"
 #include "hashmap.h"
 #include "utf8.h"
 #include "bloom.h"
+#include "strmap.h"
 #include "json-writer.h"
 #include "list-objects-filter-options.h"
 #include "resolve-undo.h"
@@ -664,8 +667,6 @@ static void trace2_bloom_filter_statistics_atexit(void)
 
 static int forbid_bloom_filters(struct pathspec *spec)
 {
-	if (spec->has_wildcard)
-		return 1;
 	if (spec->nr > 1)
 		return 1;
 	if (spec->magic & ~PATHSPEC_LITERAL)
@@ -679,10 +680,7 @@ static int forbid_bloom_filters(struct pathspec *spec)
 static void prepare_to_use_bloom_filter(struct rev_info *revs)
 {
 	struct pathspec_item *pi;
-	char *path_alloc = NULL;
-	const char *path, *p;
 	size_t len;
-	int path_component_nr = 1;
 
 	if (!revs->commits)
 		return;
@@ -701,61 +699,46 @@ static void prepare_to_use_bloom_filter(struct rev_info *revs)
 
 	pi = &revs->pruning.pathspec.items[0];
 
+	/*
+	 * A wildcard can only match below the directory that its literal
+	 * part names, and any change there adds that directory to the
+	 * filter; use it as the key.
+	 */
+	len = pi->len;
+	if (pi->nowildcard_len < pi->len) {
+		len = pi->nowildcard_len;
+		while (len && pi->match[len - 1] != '/')
+			len--;
+	}
+
 	/* remove single trailing slash from path, if needed */
-	if (pi->len > 0 && pi->match[pi->len - 1] == '/') {
-		path_alloc = xmemdupz(pi->match, pi->len - 1);
-		path = path_alloc;
-	} else
-		path = pi->match;
+	if (len > 0 && pi->match[len - 1] == '/')
+		len--;
 
-	len = strlen(path);
 	if (!len) {
 		revs->bloom_filter_settings = NULL;
-		free(path_alloc);
 		return;
 	}
 
-	p = path;
-	while (*p) {
-		/*
-		 * At this point, the path is normalized to use Unix-style
-		 * path separators. This is required due to how the
-		 * changed-path Bloom filters store the paths.
-		 */
-		if (*p == '/')
-			path_component_nr++;
-		p++;
-	}
-
-	revs->bloom_keys_nr = path_component_nr;
-	ALLOC_ARRAY(revs->bloom_keys, revs->bloom_keys_nr);
-
-	fill_bloom_key(path, len, &revs->bloom_keys[0],
-		       revs->bloom_filter_settings);
-	path_component_nr = 1;
-
-	p = path + len - 1;
-	while (p > path) {
-		if (*p == '/')
-			fill_bloom_key(path, p - path,
-				       &revs->bloom_keys[path_component_nr++],
-				       revs->bloom_filter_settings);
-		p--;
-	}
+	/*
+	 * At this point, the path is normalized to use Unix-style path
+	 * separators. This is required due to how the changed-path
+	 * Bloom filters store the paths.
+	 */
+	revs->bloom_keyvec = bloom_keyvec_new(pi->match, len,
+					      revs->bloom_filter_settings);
 
 	if (trace2_is_enabled() && !bloom_filter_atexit_registered) {
 		atexit(trace2_bloom_filter_statistics_atexit);
 		bloom_filter_atexit_registered = 1;
 	}
-
-	free(path_alloc);
 }
 
 static int check_maybe_different_in_bloom_filter(struct rev_info *revs,
 						 struct commit *commit)
 {
 	struct bloom_filter *filter;
-	int result = 1, j;
+	int result;
 
 	if (!revs->repo->objects->commit_graph)
 		return -1;
@@ -770,11 +753,8 @@ static int check_maybe_different_in_bloom_filter(struct rev_info *revs,
 		return -1;
 	}
 
-	for (j = 0; result && j < revs->bloom_keys_nr; j++) {
-		result = bloom_filter_contains(filter,
-					       &revs->bloom_keys[j],
-					       revs->bloom_filter_settings);
-	}
+	result = bloom_filter_contains_vec(filter, revs->bloom_keyvec,
+					   revs->bloom_filter_settings);
 
 	if (result)
 		count_bloom_filter_maybe++;
@@ -814,7 +794,7 @@ static int rev_compare_tree(struct rev_info *revs,
 			return REV_TREE_SAME;
 	}
 
-	if (revs->bloom_keys_nr && !nth_parent) {
+	if (revs->bloom_keyvec && !nth_parent) {
 		bloom_ret = check_maybe_different_in_bloom_filter(revs, commit);
 
 		if (bloom_ret == 0)
@@ -3075,6 +3055,18 @@ void release_revisions(struct rev_info *revs)
 	diff_free(&revs->pruning);
 	reflog_walk_info_release(revs->reflog_info);
 	release_revisions_topo_walk_info(revs->topo_walk_info);
+	bloom_keyvec_free(revs->bloom_keyvec);
+	bloom_keyvec_free(revs->follow_bloom_keyvec);
+	free(revs->follow_bloom_path);
+	if (revs->line_log_bloom_keys) {
+		struct hashmap_iter iter;
+		struct strmap_entry *e;
+
+		strmap_for_each_entry(revs->line_log_bloom_keys, &iter, e)
+			bloom_keyvec_free(e->value);
+		strmap_clear(revs->line_log_bloom_keys, 0);
+		FREE_AND_NULL(revs->line_log_bloom_keys);
+	}
 }
 
 static void add_child(struct rev_info *revs, struct commit *parent, struct commit *child)
@@ -3466,8 +3458,9 @@ define_commit_slab(author_date_slab, timestamp_t);
 
 struct topo_walk_info {
 	timestamp_t min_generation;
-	struct prio_queue explore_queue;
-	struct prio_queue indegree_queue;
+	unsigned lazy_tips:1;
+	struct commit_queue explore_queue;
+	struct commit_queue indegree_queue;
 	struct prio_queue topo_queue;
 	struct indegree_slab indegree;
 	struct author_date_slab author_date;
@@ -3493,20 +3486,20 @@ static void trace2_topo_walk_statistics_atexit(void)
 	jw_release(&jw);
 }
 
-static inline void test_flag_and_insert(struct prio_queue *q, struct commit *c, int flag)
+static inline void test_flag_and_insert(struct commit_queue *q, struct commit *c, int flag)
 {
 	if (c->object.flags & flag)
 		return;
 
 	c->object.flags |= flag;
-	prio_queue_put(q, c);
+	commit_queue_put(q, c);
 }
 
 static void explore_walk_step(struct rev_info *revs)
 {
 	struct topo_walk_info *info = revs->topo_walk_info;
 	struct commit_list *p;
-	struct commit *c = prio_queue_get(&info->explore_queue);
+	struct commit *c = commit_queue_get(&info->explore_queue);
 
 	if (!c)
 		return;
@@ -3536,9 +3529,8 @@ static void explore_to_depth(struct rev_info *revs,
 			     timestamp_t gen_cutoff)
 {
 	struct topo_walk_info *info = revs->topo_walk_info;
-	struct commit *c;
-	while ((c = prio_queue_peek(&info->explore_queue)) &&
-	       commit_graph_generation(c) >= gen_cutoff)
+	while (info->explore_queue.nr &&
+	       commit_queue_peek_generation(&info->explore_queue) >= gen_cutoff)
 		explore_walk_step(revs);
 }
 
@@ -3546,7 +3538,7 @@ static void indegree_walk_step(struct rev_info *revs)
 {
 	struct commit_list *p;
 	struct topo_walk_info *info = revs->topo_walk_info;
-	struct commit *c = prio_queue_get(&info->indegree_queue);
+	struct commit *c = commit_queue_get(&info->indegree_queue);
 
 	if (!c)
 		return;
@@ -3581,18 +3573,31 @@ static void compute_indegrees_to_depth(struct rev_info *revs,
 				       timestamp_t gen_cutoff)
 {
 	struct topo_walk_info *info = revs->topo_walk_info;
-	struct commit *c;
-	while ((c = prio_queue_peek(&info->indegree_queue)) &&
-	       commit_graph_generation(c) >= gen_cutoff)
+	while (info->indegree_queue.nr &&
+	       commit_queue_peek_generation(&info->indegree_queue) >= gen_cutoff)
 		indegree_walk_step(revs);
 }
 
+/*
+ * Make sure that the indegrees of the commits of the given generation
+ * and above are final, walking further down if needed.
+ */
+static void walk_indegrees_to(struct rev_info *revs, timestamp_t generation)
+{
+	struct topo_walk_info *info = revs->topo_walk_info;
+
+	if (generation < info->min_generation) {
+		info->min_generation = generation;
+		compute_indegrees_to_depth(revs, info->min_generation);
+	}
+}
+
 static void release_revisions_topo_walk_info(struct topo_walk_info *info)
 {
 	if (!info)
 		return;
-	clear_prio_queue(&info->explore_queue);
-	clear_prio_queue(&info->indegree_queue);
+	clear_commit_queue(&info->explore_queue);
+	clear_commit_queue(&info->indegree_queue);
 	clear_prio_queue(&info->topo_queue);
 	clear_indegree_slab(&info->indegree);
 	clear_author_date_slab(&info->author_date);
@@ -3635,13 +3640,12 @@ static void init_topo_walk(struct rev_info *revs)
 		break;
 	}
 
-	info->explore_queue.compare = compare_commits_by_gen_then_commit_date;
-	info->indegree_queue.compare = compare_commits_by_gen_then_commit_date;
+	info->explore_queue.by_generation = 1;
+	info->indegree_queue.by_generation = 1;
 
 	info->min_generation = GENERATION_NUMBER_INFINITY;
 	for (list = revs->commits; list; list = list->next) {
 		struct commit *c = list->item;
-		timestamp_t generation;
 
 		if (repo_parse_commit_gently(revs->repo, c, 1))
 			continue;
@@ -3649,22 +3653,63 @@ static void init_topo_walk(struct rev_info *revs)
 		test_flag_and_insert(&info->explore_queue, c, TOPO_WALK_EXPLORED);
 		test_flag_and_insert(&info->indegree_queue, c, TOPO_WALK_INDEGREE);
 
-		generation = commit_graph_generation(c);
-		if (generation < info->min_generation)
-			info->min_generation = generation;
-
 		*(indegree_slab_at(&info->indegree, c)) = 1;
 
 		if (revs->sort_order == REV_SORT_BY_AUTHOR_DATE)
 			record_author_date(&info->author_date, c);
 	}
-	compute_indegrees_to_depth(revs, info->min_generation);
 
-	for (list = revs->commits; list; list = list->next) {
-		struct commit *c = list->item;
+	if (revs->sort_order == REV_SORT_IN_GRAPH_ORDER) {
+		/*
+		 * A tip must not be shown while it is reachable from
+		 * another tip that has not been shown yet, which is only
+		 * known once the indegree walk has gone down to its
+		 * generation. Rather than walking down to the oldest tip
+		 * before showing anything, queue all the tips and let
+		 * next_topo_commit() skip those that are not ready yet;
+		 * they are queued again by expand_topo_walk() once all
+		 * of their children are shown.
+		 *
+		 * As the stack only grows on top of the tips, this shows
+		 * the same commits in the same order.
+		 */
+		for (list = revs->commits; list; list = list->next)
+			prio_queue_put(&info->topo_queue, list->item);
+		info->lazy_tips = 1;
+
+		/*
+		 * Commits that are not in the commit-graph all have the
+		 * same infinite generation, so walk_indegrees_to() cannot
+		 * tell how far down they have been walked. There are few
+		 * of them, and nothing in the commit-graph leads back to
+		 * them, so walk them all now.
+		 */
+		compute_indegrees_to_depth(revs, GENERATION_NUMBER_INFINITY);
+	} else {
+		/*
+		 * A tip skipped by a date-ordered queue could later be
+		 * queued again among commits of the same date and come
+		 * out in a different order, so check all the tips first.
+		 */
+		for (list = revs->commits; list; list = list->next) {
+			struct commit *c = list->item;
+			timestamp_t generation;
+
+			if (!*(indegree_slab_at(&info->indegree, c)))
+				continue;
+
+			generation = commit_graph_generation(c);
+			if (generation < info->min_generation)
+				info->min_generation = generation;
+		}
+		compute_indegrees_to_depth(revs, info->min_generation);
+
+		for (list = revs->commits; list; list = list->next) {
+			struct commit *c = list->item;
 
-		if (*(indegree_slab_at(&info->indegree, c)) == 1)
-			prio_queue_put(&info->topo_queue, c);
+			if (*(indegree_slab_at(&info->indegree, c)) == 1)
+				prio_queue_put(&info->topo_queue, c);
+		}
 	}
 
 	/*
@@ -3686,10 +3731,21 @@ static struct commit *next_topo_commit(struct rev_info *revs)
 	struct topo_walk_info *info = revs->topo_walk_info;
 
 	/* pop next off of topo_queue */
-	c = prio_queue_get(&info->topo_queue);
+	while ((c = prio_queue_get(&info->topo_queue))) {
+		int *pi = indegree_slab_at(&info->indegree, c);
 
-	if (c)
-		*(indegree_slab_at(&info->indegree, c)) = 0;
+		if (info->lazy_tips) {
+			/* only the tips can come up before they are ready */
+			if (!*pi)
+				continue;
+			walk_indegrees_to(revs, commit_graph_generation(c));
+			if (*pi != 1)
+				continue;
+		}
+
+		*pi = 0;
+		break;
+	}
 
 	return c;
 }
@@ -3709,7 +3765,6 @@ static void expand_topo_walk(struct rev_info *revs, struct commit *commit)
 	for (p = commit->parents; p; p = p->next) {
 		struct commit *parent = p->item;
 		int *pi;
-		timestamp_t generation;
 
 		if (parent->object.flags & UNINTERESTING)
 			continue;
@@ -3717,11 +3772,7 @@ static void expand_topo_walk(struct rev_info *revs, struct commit *commit)
 		if (repo_parse_commit_gently(revs->repo, parent, 1) < 0)
 			continue;
 
-		generation = commit_graph_generation(parent);
-		if (generation < info->min_generation) {
-			info->min_generation = generation;
-			compute_indegrees_to_depth(revs, info->min_generation);
-		}
+		walk_indegrees_to(revs, commit_graph_generation(parent));
 
 		pi = indegree_slab_at(&info->indegree, parent);
 
@@ -4310,6 +4361,128 @@ static struct commit *get_revision_internal(struct rev_info *revs)
 	return c;
 }
 
+static int graph_walk_compatible(struct rev_info *revs)
+{
+	return !revs->limited && !revs->prune && !revs->no_walk &&
+		!revs->unsorted_input && !revs->topo_order && !revs->reverse &&
+		!revs->reflog_info && !revs->line_level_traverse &&
+		!revs->boundary && !revs->left_right && !revs->cherry_mark &&
+		!revs->cherry_pick && !revs->bisect && !revs->ancestry_path &&
+		!revs->simplify_merges && !revs->simplify_by_decoration &&
+		!revs->unpacked && !revs->no_kept_objects &&
+		!revs->tag_objects && !revs->tree_objects && !revs->blob_objects &&
+		!revs->exclude_promisor_objects && !revs->track_linear &&
+		!revs->graph && !revs->sources && !revs->children.name &&
+		!revs->include_check && !revs->commits && !revs->early_output &&
+		!revs->filter.choice &&
+		!revs->grep_filter.pattern_list && !revs->grep_filter.header_list &&
+		revs->max_age == -1 && revs->min_age == -1 &&
+		revs->max_age_as_filter == -1 &&
+		!revs->min_parents && revs->max_parents < 0;
+}
+
+/*
+ * Newest first, like commit_list_insert_by_date(); the queue keeps
+ * commits with equal dates in the order they were found, as the list
+ * does. Positions are stored off by one, so that position 0 is not
+ * mistaken for an empty queue.
+ */
+static int compare_graph_pos_by_date(const void *a, const void *b, void *g)
+{
+	timestamp_t date_a = commit_graph_pos_date(g, (uintptr_t)a - 1);
+	timestamp_t date_b = commit_graph_pos_date(g, (uintptr_t)b - 1);
+
+	if (date_a < date_b)
+		return 1;
+	if (date_a > date_b)
+		return -1;
+	return 0;
+}
+
+int walk_revisions_in_graph(struct rev_info *revs, graph_walk_show_fn show,
+			    void *data)
+{
+	struct commit_graph *g;
+	struct prio_queue queue = { compare_graph_pos_by_date };
+	struct bitmap *seen;
+	uint32_t *tips = NULL, *parents = NULL;
+	size_t tips_nr = 0, tips_alloc = 0, parents_alloc = 0;
+	size_t i, walked = 0;
+	void *item;
+
+	if (!graph_walk_compatible(revs))
+		return -1;
+	g = repo_commit_graph(revs->repo);
+	if (!g)
+		return -1;
+
+	for (i = 0; i < revs->pending.nr; i++) {
+		struct object *obj = revs->pending.objects[i].item;
+		uint32_t pos;
+
+		if (obj->flags & UNINTERESTING)
+			goto fail;
+		obj = deref_tag(revs->repo, obj, NULL, 0);
+		if (!obj)
+			goto fail;
+		/* handle_commit() ignores trees and blobs without --objects */
+		if (obj->type != OBJ_COMMIT)
+			continue;
+		if (!commit_graph_find_pos(g, &obj->oid, &pos))
+			goto fail;
+		ALLOC_GROW(tips, tips_nr + 1, tips_alloc);
+		tips[tips_nr++] = pos;
+	}
+
+	trace2_region_enter("revision", "graph-walk", revs->repo);
+	seen = bitmap_word_alloc(DIV_ROUND_UP(commit_graph_nr_commits(g),
+					      BITS_IN_EWORD));
+	queue.cb_data = g;
+	for (i = 0; i < tips_nr; i++) {
+		if (bitmap_get(seen, tips[i]))
+			continue;
+		bitmap_set(seen, tips[i]);
+		prio_queue_put(&queue, (void *)((uintptr_t)tips[i] + 1));
+	}
+
+	while (revs->max_count && (item = prio_queue_get(&queue))) {
+		uint32_t pos = (uintptr_t)item - 1;
+		size_t nr = commit_graph_pos_parents(g, pos, &parents,
+						     &parents_alloc);
+
+		walked++;
+		for (i = 0; i < nr; i++) {
+			if (!bitmap_get(seen, parents[i])) {
+				bitmap_set(seen, parents[i]);
+				prio_queue_put(&queue,
+					       (void *)((uintptr_t)parents[i] + 1));
+			}
+			if (revs->first_parent_only)
+				break;
+		}
+
+		if (revs->skip_count > 0) {
+			revs->skip_count--;
+			continue;
+		}
+		if (revs->max_count > 0)
+			revs->max_count--;
+		show(g, pos, data);
+	}
+	trace2_data_intmax("revision", revs->repo, "graph-walk/commits", walked);
+	trace2_region_leave("revision", "graph-walk", revs->repo);
+
+	bitmap_free(seen);
+	clear_prio_queue(&queue);
+	free(parents);
+	free(tips);
+	return 0;
+
+fail:
+	free(tips);
+	return -1;
+}
+
 struct commit *get_revision(struct rev_info *revs)
 {
 	struct commit *c;
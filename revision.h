@@ -59,8 +59,9 @@ struct repository;
 struct rev_info;
 struct string_list;
 struct saved_parents;
-struct bloom_key;
+struct bloom_keyvec;
 struct bloom_filter_settings;
+struct strmap;
 struct option;
 struct parse_opt_ctx_t;
 define_shared_commit_slab(revision_sources, char *);
@@ -293,6 +294,13 @@ struct rev_info {
 	int		show_log_size;
 	struct string_list *mailmap;
 
+	/*
+	 * If set, show_log() uses this message for the commit being
+	 * shown instead of pretty-printing it; see
+	 * log_tree_format_message().
+	 */
+	const struct strbuf *preformatted_msg;
+
 	/* Filter by commit log message */
 	struct grep_opt	grep_filter;
 
@@ -311,6 +319,13 @@ struct rev_info {
 	int (*include_check_obj)(struct object *obj, void *);
 	void *include_check_data;
 
+	/*
+	 * The number of threads traverse_commit_list() may use to read
+	 * trees ahead of the traversal. The traversal itself, and thus
+	 * the order of the objects it shows, is not affected.
+	 */
+	int traverse_threads;
+
 	/* diff info for patches and for paths limiting */
 	struct diff_options diffopt;
 	struct diff_options pruning;
@@ -355,8 +370,14 @@ struct rev_info {
 
 	/* Commit graph bloom filter fields */
 	/* The bloom filter key(s) for the pathspec */
-	struct bloom_key *bloom_keys;
-	int bloom_keys_nr;
+	struct bloom_keyvec *bloom_keyvec;
+
+	/* The bloom filter keys for the path that --follow is at */
+	struct bloom_keyvec *follow_bloom_keyvec;
+	char *follow_bloom_path;
+
+	/* The bloom filter keys for each path that -L has tracked */
+	struct strmap *line_log_bloom_keys;
 
 	/*
 	 * The bloom filter settings used to generate the key.
@@ -471,6 +492,28 @@ int prepare_revision_walk(struct rev_info *revs);
  */
 struct commit *get_revision(struct rev_info *revs);
 
+struct commit_graph;
+typedef void (*graph_walk_show_fn)(struct commit_graph *g, uint32_t pos,
+				   void *data);
+
+/**
+ * Instead of prepare_revision_walk() and get_revision(), walk the
+ * commits of `revs` using only the commit-graph, calling `show` with
+ * the commit-graph position of each commit that get_revision() would
+ * return, in the same order. No `struct commit` is created for the
+ * commits walked, and only a bit per commit in the graph is allocated
+ * to mark them.
+ *
+ * This only handles plain walks from positive starting points: it
+ * returns -1 without calling `show` when `revs` needs anything else
+ * (negative refs, pathspecs, sorting, filtering, object listing...),
+ * or when there is no commit-graph or a starting point is not in it,
+ * in which case the caller should do a regular walk. `--max-count`,
+ * `--skip` and `--first-parent` are honored.
+ */
+int walk_revisions_in_graph(struct rev_info *revs, graph_walk_show_fn show,
+			    void *data);
+
 const char *get_revision_mark(const struct rev_info *revs,
 			      const struct commit *commit);
 void put_revision_mark(const struct rev_info *revs,
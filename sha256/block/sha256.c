@@ -6,20 +6,6 @@
 
 #define BLKSIZE blk_SHA256_BLKSIZE
 
-void blk_SHA256_Init(blk_SHA256_CTX *ctx)
-{
-	ctx->offset = 0;
-	ctx->size = 0;
-	ctx->state[0] = 0x6a09e667ul;
-	ctx->state[1] = 0xbb67ae85ul;
-	ctx->state[2] = 0x3c6ef372ul;
-	ctx->state[3] = 0xa54ff53aul;
-	ctx->state[4] = 0x510e527ful;
-	ctx->state[5] = 0x9b05688cul;
-	ctx->state[6] = 0x1f83d9abul;
-	ctx->state[7] = 0x5be0cd19ul;
-}
-
 static inline uint32_t ror(uint32_t x, unsigned n)
 {
 	return (x >> n) | (x << (32 - n));
@@ -55,7 +41,7 @@ static inline uint32_t gamma1(uint32_t x)
 	return ror(x, 17) ^ ror(x, 19) ^ (x >> 10);
 }
 
-static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
+static void blk_SHA256_Transform(uint32_t *state, const unsigned char *buf)
 {
 
 	uint32_t S[8], W[64], t0, t1;
@@ -63,7 +49,7 @@ static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
 
 	/* copy state into S */
 	for (i = 0; i < 8; i++)
-		S[i] = ctx->state[i];
+		S[i] = state[i];
 
 	/* copy the state into 512-bits into W[0..15] */
 	for (i = 0; i < 16; i++, buf += sizeof(uint32_t))
@@ -145,7 +131,296 @@ static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
 	RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],63,0xc67178f2);
 
 	for (i = 0; i < 8; i++)
-		ctx->state[i] += S[i];
+		state[i] += S[i];
+}
+
+static void sha256_blocks_generic(uint32_t *state, const unsigned char *data,
+				  size_t nr)
+{
+	while (nr--) {
+		blk_SHA256_Transform(state, data);
+		data += BLKSIZE;
+	}
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define SHA256_X86_SHANI
+#endif
+
+#if defined(__aarch64__) && defined(__linux__) && \
+	(defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 6))
+#define SHA256_ARMV8
+#endif
+
+#if defined(SHA256_X86_SHANI) || defined(SHA256_ARMV8)
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+#endif
+
+#ifdef SHA256_X86_SHANI
+#include <cpuid.h>
+#include <immintrin.h>
+
+static int sha256_shani_supported(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid(1, eax, ebx, ecx, edx);
+	if (!(ecx & bit_SSE4_1))
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return !!(ebx & (1 << 29)); /* SHA */
+}
+
+/*
+ * Four rounds using message words "cur".  While they run, extend the
+ * message schedule: "next" gets the words for four rounds later, and
+ * "prev" is prepared for the following group.
+ */
+#define SHANI_RNDS4(g, cur, prev, next) do { \
+	msg = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i *)&sha256_k[4 * (g)])); \
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+	if ((g) >= 3 && (g) <= 14) { \
+		tmp = _mm_alignr_epi8(cur, prev, 4); \
+		next = _mm_add_epi32(next, tmp); \
+		next = _mm_sha256msg2_epu32(next, cur); \
+	} \
+	msg = _mm_shuffle_epi32(msg, 0x0e); \
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg); \
+	if ((g) >= 1 && (g) <= 12) \
+		prev = _mm_sha256msg1_epu32(prev, cur); \
+} while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(uint32_t *state, const unsigned char *data,
+				size_t nr)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, msg, tmp;
+	__m128i m0, m1, m2, m3;
+
+	/* The SHA instructions want the state as ABEF and CDGH. */
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xb1);
+	state1 = _mm_shuffle_epi32(state1, 0x1b);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	while (nr--) {
+		abef = state0;
+		cdgh = state1;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), bswap);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), bswap);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), bswap);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), bswap);
+
+		SHANI_RNDS4(0, m0, m3, m1);
+		SHANI_RNDS4(1, m1, m0, m2);
+		SHANI_RNDS4(2, m2, m1, m3);
+		SHANI_RNDS4(3, m3, m2, m0);
+		SHANI_RNDS4(4, m0, m3, m1);
+		SHANI_RNDS4(5, m1, m0, m2);
+		SHANI_RNDS4(6, m2, m1, m3);
+		SHANI_RNDS4(7, m3, m2, m0);
+		SHANI_RNDS4(8, m0, m3, m1);
+		SHANI_RNDS4(9, m1, m0, m2);
+		SHANI_RNDS4(10, m2, m1, m3);
+		SHANI_RNDS4(11, m3, m2, m0);
+		SHANI_RNDS4(12, m0, m3, m1);
+		SHANI_RNDS4(13, m1, m0, m2);
+		SHANI_RNDS4(14, m2, m1, m3);
+		SHANI_RNDS4(15, m3, m2, m0);
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+		data += BLKSIZE;
+	}
+
+	/* Back to ABCD and EFGH. */
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *)&state[0], state0);
+	_mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+#undef SHANI_RNDS4
+#endif /* SHA256_X86_SHANI */
+
+#ifdef SHA256_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+
+#ifdef __clang__
+#define SHA256_ARMV8_TARGET __attribute__((target("crypto")))
+#else
+#define SHA256_ARMV8_TARGET __attribute__((target("+crypto")))
+#endif
+
+static int sha256_armv8_supported(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA2);
+}
+
+/*
+ * Four rounds using message words "m0", then replace "m0" with the
+ * words for the rounds 16 later (unless we are near the end).
+ */
+#define ARMV8_RNDS4(g, m0, m1, m2, m3) do { \
+	tmp = vaddq_u32(m0, vld1q_u32(&sha256_k[4 * (g)])); \
+	if ((g) < 12) \
+		m0 = vsha256su1q_u32(vsha256su0q_u32(m0, m1), m2, m3); \
+	abcd = state0; \
+	state0 = vsha256hq_u32(state0, state1, tmp); \
+	state1 = vsha256h2q_u32(state1, abcd, tmp); \
+} while (0)
+
+SHA256_ARMV8_TARGET
+static void sha256_blocks_armv8(uint32_t *state, const unsigned char *data,
+				size_t nr)
+{
+	uint32x4_t state0, state1, abcd_save, efgh_save, abcd, tmp;
+	uint32x4_t m0, m1, m2, m3;
+
+	state0 = vld1q_u32(&state[0]);
+	state1 = vld1q_u32(&state[4]);
+
+	while (nr--) {
+		abcd_save = state0;
+		efgh_save = state1;
+
+		m0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 0)));
+		m1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+		m2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+		m3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+		ARMV8_RNDS4(0, m0, m1, m2, m3);
+		ARMV8_RNDS4(1, m1, m2, m3, m0);
+		ARMV8_RNDS4(2, m2, m3, m0, m1);
+		ARMV8_RNDS4(3, m3, m0, m1, m2);
+		ARMV8_RNDS4(4, m0, m1, m2, m3);
+		ARMV8_RNDS4(5, m1, m2, m3, m0);
+		ARMV8_RNDS4(6, m2, m3, m0, m1);
+		ARMV8_RNDS4(7, m3, m0, m1, m2);
+		ARMV8_RNDS4(8, m0, m1, m2, m3);
+		ARMV8_RNDS4(9, m1, m2, m3, m0);
+		ARMV8_RNDS4(10, m2, m3, m0, m1);
+		ARMV8_RNDS4(11, m3, m0, m1, m2);
+		ARMV8_RNDS4(12, m0, m1, m2, m3);
+		ARMV8_RNDS4(13, m1, m2, m3, m0);
+		ARMV8_RNDS4(14, m2, m3, m0, m1);
+		ARMV8_RNDS4(15, m3, m0, m1, m2);
+
+		state0 = vaddq_u32(state0, abcd_save);
+		state1 = vaddq_u32(state1, efgh_save);
+		data += BLKSIZE;
+	}
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+
+#undef ARMV8_RNDS4
+#endif /* SHA256_ARMV8 */
+
+typedef void (*sha256_blocks_fn)(uint32_t *state, const unsigned char *data,
+				 size_t nr);
+
+/*
+ * Implementations of the compression function, most preferred first.
+ * The first one supported by the CPU we run on is picked the first
+ * time a context is initialized.
+ */
+static const struct {
+	const char *name;
+	int (*supported)(void);
+	sha256_blocks_fn blocks;
+} sha256_impls[] = {
+#ifdef SHA256_X86_SHANI
+	{ "shani", sha256_shani_supported, sha256_blocks_shani },
+#endif
+#ifdef SHA256_ARMV8
+	{ "armv8", sha256_armv8_supported, sha256_blocks_armv8 },
+#endif
+	{ "generic", NULL, sha256_blocks_generic },
+};
+
+static sha256_blocks_fn sha256_blocks;
+
+static void sha256_select_impl(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha256_impls); i++) {
+		if (!sha256_impls[i].supported || sha256_impls[i].supported()) {
+			sha256_blocks = sha256_impls[i].blocks;
+			return;
+		}
+	}
+}
+
+const char *blk_SHA256_impl_name(unsigned int n)
+{
+	return n < ARRAY_SIZE(sha256_impls) ? sha256_impls[n].name : NULL;
+}
+
+int blk_SHA256_use_impl(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha256_impls); i++) {
+		if (strcmp(sha256_impls[i].name, name))
+			continue;
+		if (sha256_impls[i].supported && !sha256_impls[i].supported())
+			return -1;
+		sha256_blocks = sha256_impls[i].blocks;
+		return 0;
+	}
+	return -1;
+}
+
+void blk_SHA256_Init(blk_SHA256_CTX *ctx)
+{
+	if (!sha256_blocks)
+		sha256_select_impl();
+
+	ctx->offset = 0;
+	ctx->size = 0;
+	ctx->state[0] = 0x6a09e667ul;
+	ctx->state[1] = 0xbb67ae85ul;
+	ctx->state[2] = 0x3c6ef372ul;
+	ctx->state[3] = 0xa54ff53aul;
+	ctx->state[4] = 0x510e527ful;
+	ctx->state[5] = 0x9b05688cul;
+	ctx->state[6] = 0x1f83d9abul;
+	ctx->state[7] = 0x5be0cd19ul;
 }
 
 void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len)
@@ -165,12 +440,12 @@ void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len)
 		data = ((const char *)data + left);
 		if (len_buf)
 			return;
-		blk_SHA256_Transform(ctx, ctx->buf);
+		sha256_blocks(ctx->state, ctx->buf, 1);
 	}
-	while (len >= 64) {
-		blk_SHA256_Transform(ctx, data);
-		data = ((const char *)data + 64);
-		len -= 64;
+	if (len >= 64) {
+		sha256_blocks(ctx->state, data, len / 64);
+		data = ((const char *)data + (len & ~(size_t)63));
+		len &= 63;
 	}
 	if (len)
 		memcpy(ctx->buf, data, len);
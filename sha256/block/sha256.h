@@ -16,6 +16,17 @@ void blk_SHA256_Init(blk_SHA256_CTX *ctx);
 void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len);
 void blk_SHA256_Final(unsigned char *digest, blk_SHA256_CTX *ctx);
 
+/*
+ * The block function is picked at runtime among the implementations
+ * that the CPU supports (e.g. using the x86 SHA extensions).  These
+ * are meant for tests and benchmarks: blk_SHA256_impl_name() returns
+ * the name of the n-th implementation built in, or NULL past the last
+ * one, and blk_SHA256_use_impl() switches to the named implementation,
+ * returning -1 if it is unknown or not supported by this CPU.
+ */
+const char *blk_SHA256_impl_name(unsigned int n);
+int blk_SHA256_use_impl(const char *name);
+
 #define platform_SHA256_CTX blk_SHA256_CTX
 #define platform_SHA256_Init blk_SHA256_Init
 #define platform_SHA256_Update blk_SHA256_Update
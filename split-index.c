@@ -227,6 +227,8 @@ void prepare_to_write_split_index(struct index_state *istate)
 	struct split_index *si = init_split_index(istate);
 	struct cache_entry **entries = NULL, *ce;
 	int i, nr_entries = 0, nr_alloc = 0;
+	struct cache_entry **added = NULL;
+	int nr_added = 0, added_alloc = 0;
 
 	si->delete_bitmap = ewah_new();
 	si->replace_bitmap = ewah_new();
@@ -238,6 +240,10 @@ void prepare_to_write_split_index(struct index_state *istate)
 		 * that are not marked with either CE_MATCHED or
 		 * CE_UPDATE_IN_BASE. If istate->cache[i] is a
 		 * duplicate, deduplicate it.
+		 *
+		 * Entries that are not shared are collected on the
+		 * way, so that the whole index is only gone through
+		 * once: they are written after the replacements.
 		 */
 		for (i = 0; i < istate->cache_nr; i++) {
 			struct cache_entry *base;
@@ -261,6 +267,11 @@ void prepare_to_write_split_index(struct index_state *istate)
 				 * marked as deleted, and this entry will be
 				 * added to the split index.
 				 */
+				ce->ce_flags &= ~CE_MATCHED;
+				if (!(ce->ce_flags & CE_REMOVE)) {
+					ALLOC_GROW(added, nr_added+1, added_alloc);
+					added[nr_added++] = ce;
+				}
 				continue;
 			}
 			if (ce->index > si->base->cache_nr) {
@@ -305,6 +316,11 @@ void prepare_to_write_split_index(struct index_state *istate)
 			if (ce->ce_namelen != base->ce_namelen ||
 			    strcmp(ce->name, base->name)) {
 				ce->index = 0;
+				ce->ce_flags &= ~CE_MATCHED;
+				if (!(ce->ce_flags & CE_REMOVE)) {
+					ALLOC_GROW(added, nr_added+1, added_alloc);
+					added[nr_added++] = ce;
+				}
 				continue;
 			}
 			/*
@@ -347,6 +363,10 @@ void prepare_to_write_split_index(struct index_state *istate)
 			discard_cache_entry(base);
 			si->base->cache[ce->index - 1] = ce;
 		}
+		/*
+		 * Every entry marked CE_MATCHED above is now in
+		 * base->cache[], so this is where the mark is cleared.
+		 */
 		for (i = 0; i < si->base->cache_nr; i++) {
 			ce = si->base->cache[i];
 			if ((ce->ce_flags & CE_REMOVE) ||
@@ -358,20 +378,28 @@ void prepare_to_write_split_index(struct index_state *istate)
 				ALLOC_GROW(entries, nr_entries+1, nr_alloc);
 				entries[nr_entries++] = ce;
 			}
+			ce->ce_flags &= ~CE_MATCHED;
 			if (is_null_oid(&ce->oid))
 				istate->drop_cache_tree = 1;
 		}
+	} else {
+		for (i = 0; i < istate->cache_nr; i++) {
+			ce = istate->cache[i];
+			ce->ce_flags &= ~CE_MATCHED;
+			if (!(ce->ce_flags & CE_REMOVE)) {
+				assert(!(ce->ce_flags & CE_STRIP_NAME));
+				ALLOC_GROW(entries, nr_entries+1, nr_alloc);
+				entries[nr_entries++] = ce;
+			}
+		}
 	}
 
-	for (i = 0; i < istate->cache_nr; i++) {
-		ce = istate->cache[i];
-		if ((!si->base || !ce->index) && !(ce->ce_flags & CE_REMOVE)) {
-			assert(!(ce->ce_flags & CE_STRIP_NAME));
-			ALLOC_GROW(entries, nr_entries+1, nr_alloc);
-			entries[nr_entries++] = ce;
-		}
-		ce->ce_flags &= ~CE_MATCHED;
+	ALLOC_GROW(entries, nr_entries + nr_added, nr_alloc);
+	for (i = 0; i < nr_added; i++) {
+		assert(!(added[i]->ce_flags & CE_STRIP_NAME));
+		entries[nr_entries++] = added[i];
 	}
+	free(added);
 
 	/*
 	 * take cache[] out temporarily, put entries[] in its place
@@ -228,15 +228,26 @@ static int open_istream_loose(struct git_istream *st, struct repository *r,
 			      enum object_type *type)
 {
 	struct object_info oi = OBJECT_INFO_INIT;
+	enum unpack_loose_header_result status;
 	oi.sizep = &st->size;
 	oi.typep = type;
 
+	/*
+	 * Finding the loose object is not thread-safe, and
+	 * unpack_loose_header() expects the lock to be held, but
+	 * reading the rest of the stream is fine without it.
+	 */
+	obj_read_lock();
 	st->u.loose.mapped = map_loose_object(r, oid, &st->u.loose.mapsize);
-	if (!st->u.loose.mapped)
+	if (!st->u.loose.mapped) {
+		obj_read_unlock();
 		return -1;
-	switch (unpack_loose_header(&st->z, st->u.loose.mapped,
-				    st->u.loose.mapsize, st->u.loose.hdr,
-				    sizeof(st->u.loose.hdr), NULL)) {
+	}
+	status = unpack_loose_header(&st->z, st->u.loose.mapped,
+				     st->u.loose.mapsize, st->u.loose.hdr,
+				     sizeof(st->u.loose.hdr), NULL);
+	obj_read_unlock();
+	switch (status) {
 	case ULHR_OK:
 		break;
 	case ULHR_BAD:
@@ -290,8 +301,15 @@ static ssize_t read_istream_pack_non_delta(struct git_istream *st, char *buf,
 		struct pack_window *window = NULL;
 		unsigned char *mapped;
 
+		/*
+		 * Like unpack_compressed_entry(), only let go of the object
+		 * read lock while inflating: the window stays in use until
+		 * unuse_pack(), so it cannot be unmapped meanwhile.
+		 */
+		obj_read_lock();
 		mapped = use_pack(st->u.in_pack.pack, &window,
 				  st->u.in_pack.pos, &st->z.avail_in);
+		obj_read_unlock();
 
 		st->z.next_out = (unsigned char *)buf + total_read;
 		st->z.avail_out = sz - total_read;
@@ -300,7 +318,9 @@ static ssize_t read_istream_pack_non_delta(struct git_istream *st, char *buf,
 
 		st->u.in_pack.pos += st->z.next_in - mapped;
 		total_read = st->z.next_out - (unsigned char *)buf;
+		obj_read_lock();
 		unuse_pack(&window);
+		obj_read_unlock();
 
 		if (status == Z_STREAM_END) {
 			git_inflate_end(&st->z);
@@ -334,18 +354,20 @@ static int close_istream_pack_non_delta(struct git_istream *st)
 static int open_istream_pack_non_delta(struct git_istream *st,
 				       struct repository *r UNUSED,
 				       const struct object_id *oid UNUSED,
-				       enum object_type *type UNUSED)
+				       enum object_type *type)
 {
 	struct pack_window *window;
 	enum object_type in_pack_type;
 
 	window = NULL;
 
+	obj_read_lock();
 	in_pack_type = unpack_object_header(st->u.in_pack.pack,
 					    &window,
 					    &st->u.in_pack.pos,
 					    &st->size);
 	unuse_pack(&window);
+	obj_read_unlock();
 	switch (in_pack_type) {
 	default:
 		return -1; /* we do not do deltas for now */
@@ -355,6 +377,8 @@ static int open_istream_pack_non_delta(struct git_istream *st,
 	case OBJ_TAG:
 		break;
 	}
+	if (type)
+		*type = in_pack_type;
 	st->z_state = z_unused;
 	st->close = close_istream_pack_non_delta;
 	st->read = read_istream_pack_non_delta;
@@ -493,6 +517,23 @@ struct git_istream *open_istream(struct repository *r,
 	return st;
 }
 
+struct git_istream *open_istream_pack_entry(struct packed_git *pack,
+					    off_t offset,
+					    enum object_type *type,
+					    unsigned long *size)
+{
+	struct git_istream *st = xmalloc(sizeof(*st));
+
+	st->u.in_pack.pack = pack;
+	st->u.in_pack.pos = offset;
+	if (open_istream_pack_non_delta(st, NULL, NULL, type)) {
+		free(st);
+		return NULL;
+	}
+	*size = st->size;
+	return st;
+}
+
 int stream_blob_to_fd(int fd, const struct object_id *oid, struct stream_filter *filter,
 		      int can_seek)
 {
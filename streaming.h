@@ -9,10 +9,19 @@
 /* opaque */
 struct git_istream;
 struct stream_filter;
+struct packed_git;
 
 struct git_istream *open_istream(struct repository *, const struct object_id *,
 				 enum object_type *, unsigned long *,
 				 struct stream_filter *);
+/*
+ * Open the object stored at "offset" in "pack" for reading, inflating
+ * it straight out of the pack's mmap'd windows. Only undeltified
+ * objects can be read this way; NULL is returned for deltas.
+ */
+struct git_istream *open_istream_pack_entry(struct packed_git *, off_t,
+					    enum object_type *,
+					    unsigned long *);
 int close_istream(struct git_istream *);
 ssize_t read_istream(struct git_istream *, void *, size_t);
 
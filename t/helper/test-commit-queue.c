@@ -0,0 +1,72 @@
+#include "test-tool.h"
+#include "commit.h"
+#include "commit-queue.h"
+#include "pretty.h"
+#include "repository.h"
+#include "setup.h"
+#include "strbuf.h"
+
+static void show(struct commit *commit)
+{
+	struct pretty_print_context ctx = { 0 };
+	struct strbuf sb = STRBUF_INIT;
+
+	if (!commit) {
+		printf("NULL\n");
+		return;
+	}
+	repo_format_commit_message(the_repository, commit, "%s", &sb, &ctx);
+	printf("%s\n", sb.buf);
+	strbuf_release(&sb);
+}
+
+static struct commit *get(struct commit_queue *queue)
+{
+	struct commit *peek = commit_queue_peek(queue);
+	struct commit *get = commit_queue_get(queue);
+
+	if (peek != get)
+		BUG("peek and get results do not match");
+	return get;
+}
+
+/*
+ * Usage: test-tool commit-queue [--generation] <arg>...
+ *
+ * Each <arg> is "get" to extract and show the newest commit, "dump" to
+ * extract and show all of them, or the name of a commit to put in the
+ * queue. Commits are shown by their subject, or "NULL" when the queue
+ * is empty.
+ */
+int cmd__commit_queue(int argc UNUSED, const char **argv)
+{
+	struct commit_queue queue = COMMIT_QUEUE_INIT;
+	struct commit *commit;
+
+	setup_git_directory();
+
+	if (argv[1] && !strcmp(argv[1], "--generation")) {
+		queue.by_generation = 1;
+		argv++;
+	}
+
+	while (*++argv) {
+		if (!strcmp(*argv, "get")) {
+			show(get(&queue));
+		} else if (!strcmp(*argv, "dump")) {
+			while ((commit = get(&queue)))
+				show(commit);
+		} else {
+			commit = lookup_commit_reference_by_name(*argv);
+			if (!commit)
+				die("not a commit: %s", *argv);
+			if (repo_parse_commit(the_repository, commit))
+				die("could not parse commit: %s", *argv);
+			commit_queue_put(&queue, commit);
+		}
+	}
+
+	clear_commit_queue(&queue);
+
+	return 0;
+}
@@ -0,0 +1,410 @@
+#include "test-tool.h"
+#include "git-compat-util.h"
+#include "ewah/ewok.h"
+
+#define NUM_SECONDS 1
+
+static uint64_t rand_state = 1;
+
+static uint64_t next_rand(void)
+{
+	/* xorshift64; the sequence only has to be reproducible */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+/*
+ * Fill a bitmap of "nr" words with a mix of empty words, full words
+ * and random words, so that its EWAH form has runs of both kinds and
+ * literal words.
+ */
+static struct bitmap *random_bitmap(size_t nr)
+{
+	struct bitmap *b = bitmap_word_alloc(nr);
+	size_t i;
+
+	for (i = 0; i < nr; i++) {
+		switch (next_rand() % 4) {
+		case 0:
+			b->words[i] = 0;
+			break;
+		case 1:
+			b->words[i] = ~(eword_t)0;
+			break;
+		default:
+			b->words[i] = next_rand();
+		}
+	}
+	return b;
+}
+
+static void impl_or_die(const char *impl)
+{
+	if (bitmap_use_impl(impl) < 0)
+		die("unsupported bitmap implementation: %s", impl);
+}
+
+static int ewah_list_impls(void)
+{
+	const char *impl;
+	unsigned int i;
+
+	for (i = 0; (impl = bitmap_impl_name(i)); i++)
+		if (!bitmap_use_impl(impl))
+			puts(impl);
+	return 0;
+}
+
+struct op_results {
+	struct bitmap *or, *and_not, *or_ewah, *or_ewah_many;
+	size_t popcount;
+	int is_subset, is_subset_of_or;
+};
+
+static void run_ops(struct bitmap *a, struct bitmap *b,
+		    struct ewah_bitmap **ewah, struct op_results *r)
+{
+	r->or = bitmap_dup(a);
+	bitmap_or(r->or, b);
+	r->and_not = bitmap_dup(a);
+	bitmap_and_not(r->and_not, b);
+	r->or_ewah = bitmap_dup(a);
+	bitmap_or_ewah(r->or_ewah, ewah[0]);
+	r->or_ewah_many = bitmap_new();
+	bitmap_or_ewah_many(r->or_ewah_many, ewah, 2);
+	r->popcount = bitmap_popcount(a);
+	r->is_subset = bitmap_is_subset(a, b);
+	r->is_subset_of_or = bitmap_is_subset(a, r->or);
+}
+
+static void free_results(struct op_results *r)
+{
+	bitmap_free(r->or);
+	bitmap_free(r->and_not);
+	bitmap_free(r->or_ewah);
+	bitmap_free(r->or_ewah_many);
+}
+
+/*
+ * Check that looking up single bits in the compressed forms of "b"
+ * agrees with the uncompressed bitmap, including past its end.
+ */
+static void check_get(struct bitmap *b, struct ewah_bitmap *ewah,
+		      size_t trial)
+{
+	struct roaring_bitmap *roaring = ewah_to_roaring(ewah);
+	size_t pos, end = (b->word_alloc + 2) * BITS_IN_EWORD;
+
+	for (pos = 0; pos < end; pos++) {
+		int expect = pos < b->word_alloc * BITS_IN_EWORD &&
+			     bitmap_get(b, pos);
+
+		if (ewah_get(ewah, pos) != expect ||
+		    roaring_get(roaring, pos) != expect)
+			die("trial %"PRIuMAX": wrong bit %"PRIuMAX,
+			    (uintmax_t)trial, (uintmax_t)pos);
+	}
+	roaring_free(roaring);
+}
+
+/*
+ * Check that "impl" computes the same results as the generic code on
+ * bitmaps of many different sizes, and that OR-ing an EWAH bitmap
+ * gives the same result as OR-ing its uncompressed form.
+ */
+static int ewah_verify(const char *impl)
+{
+	size_t trial;
+
+	for (trial = 0; trial < 2000; trial++) {
+		struct bitmap *a = random_bitmap(next_rand() % 300);
+		struct bitmap *b = random_bitmap(next_rand() % 300);
+		struct ewah_bitmap *ewah[2];
+		struct bitmap *expect_or = bitmap_dup(a);
+		struct op_results generic, actual;
+
+		ewah[0] = bitmap_to_ewah(b);
+		ewah[1] = bitmap_to_ewah(a);
+
+		impl_or_die("generic");
+		run_ops(a, b, ewah, &generic);
+		impl_or_die(impl);
+		run_ops(a, b, ewah, &actual);
+
+		check_get(b, ewah[0], trial);
+
+		bitmap_or(expect_or, b);
+		if (!bitmap_equals(expect_or, generic.or_ewah) ||
+		    !bitmap_equals(expect_or, generic.or_ewah_many))
+			die("trial %"PRIuMAX": bitmap_or_ewah() differs from bitmap_or()",
+			    (uintmax_t)trial);
+		if (!bitmap_equals(generic.or, actual.or) ||
+		    !bitmap_equals(generic.and_not, actual.and_not) ||
+		    !bitmap_equals(generic.or_ewah, actual.or_ewah) ||
+		    !bitmap_equals(generic.or_ewah_many, actual.or_ewah_many) ||
+		    generic.popcount != actual.popcount ||
+		    generic.is_subset != actual.is_subset ||
+		    generic.is_subset_of_or != actual.is_subset_of_or)
+			die("trial %"PRIuMAX": %s differs from generic",
+			    (uintmax_t)trial, impl);
+
+		free_results(&generic);
+		free_results(&actual);
+		bitmap_free(expect_or);
+		ewah_free(ewah[0]);
+		ewah_free(ewah[1]);
+		bitmap_free(a);
+		bitmap_free(b);
+	}
+	return 0;
+}
+
+/*
+ * Fill a bitmap spanning a few roaring chunks, each of them empty,
+ * sparse, made of long runs or dense, so that the roaring form has
+ * containers of every type.
+ */
+static struct bitmap *random_chunked_bitmap(void)
+{
+	size_t chunk_words = ROARING_CHUNK_BITS / BITS_IN_EWORD;
+	size_t nr_chunks = 1 + next_rand() % 4, chunk, i;
+	struct bitmap *b = bitmap_word_alloc(nr_chunks * chunk_words -
+					     next_rand() % chunk_words);
+
+	for (chunk = 0; chunk < nr_chunks; chunk++) {
+		size_t start = chunk * ROARING_CHUNK_BITS;
+		size_t end = st_add(start, ROARING_CHUNK_BITS);
+
+		if (end > b->word_alloc * BITS_IN_EWORD)
+			end = b->word_alloc * BITS_IN_EWORD;
+
+		switch (next_rand() % 4) {
+		case 0:
+			break;
+		case 1:
+			for (i = 0; i < 1 + next_rand() % 200; i++)
+				bitmap_set(b, start + next_rand() % (end - start));
+			break;
+		case 2:
+			for (i = 0; i < 1 + next_rand() % 20; i++) {
+				size_t pos = start + next_rand() % (end - start);
+				size_t len = next_rand() % 5000;
+
+				for (; len-- && pos < end; pos++)
+					bitmap_set(b, pos);
+			}
+			break;
+		default:
+			for (i = start / BITS_IN_EWORD; i < end / BITS_IN_EWORD; i++)
+				b->words[i] = next_rand();
+		}
+	}
+	return b;
+}
+
+static struct bitmap *roaring_to_bitmap(const struct roaring_bitmap *roaring)
+{
+	struct bitmap *b = bitmap_new();
+
+	bitmap_or_roaring(b, roaring);
+	return b;
+}
+
+/*
+ * Check that AND, AND-NOT and XOR of roaring bitmaps agree with the
+ * same operations on their uncompressed forms, for every combination
+ * of container types.
+ */
+static int ewah_roaring(void)
+{
+	int seen[4][4] = { { 0 } };
+	size_t trial, i, j;
+
+	for (trial = 0; trial < 300; trial++) {
+		struct bitmap *a = random_chunked_bitmap();
+		struct bitmap *b = random_chunked_bitmap();
+		struct ewah_bitmap *ewah_a = bitmap_to_ewah(a);
+		struct ewah_bitmap *ewah_b = bitmap_to_ewah(b);
+		struct roaring_bitmap *ra = ewah_to_roaring(ewah_a);
+		struct roaring_bitmap *rb = ewah_to_roaring(ewah_b);
+		struct roaring_bitmap *and = roaring_new();
+		struct roaring_bitmap *and_not = roaring_new();
+		struct roaring_bitmap *xor = roaring_new();
+		struct bitmap *expect_and = bitmap_dup(a);
+		struct bitmap *expect_and_not = bitmap_dup(a);
+		struct bitmap *expect_xor = bitmap_dup(a);
+		struct bitmap *actual_and, *actual_and_not, *actual_xor;
+
+		for (i = 0; i < ra->nr; i++)
+			for (j = 0; j < rb->nr; j++)
+				if (ra->containers[i].key == rb->containers[j].key)
+					seen[ra->containers[i].type][rb->containers[j].type] = 1;
+
+		roaring_and(ra, rb, and);
+		roaring_and_not(ra, rb, and_not);
+		roaring_xor(ra, rb, xor);
+
+		for (i = 0; i < a->word_alloc; i++)
+			expect_and->words[i] &= i < b->word_alloc ? b->words[i] : 0;
+		bitmap_and_not(expect_and_not, b);
+		/* grow to the larger of the two, then fix up the overlap */
+		bitmap_or(expect_xor, b);
+		for (i = 0; i < a->word_alloc && i < b->word_alloc; i++)
+			expect_xor->words[i] = a->words[i] ^ b->words[i];
+
+		actual_and = roaring_to_bitmap(and);
+		actual_and_not = roaring_to_bitmap(and_not);
+		actual_xor = roaring_to_bitmap(xor);
+		if (!bitmap_equals(expect_and, actual_and))
+			die("trial %"PRIuMAX": roaring_and() is wrong", (uintmax_t)trial);
+		if (!bitmap_equals(expect_and_not, actual_and_not))
+			die("trial %"PRIuMAX": roaring_and_not() is wrong", (uintmax_t)trial);
+		if (!bitmap_equals(expect_xor, actual_xor))
+			die("trial %"PRIuMAX": roaring_xor() is wrong", (uintmax_t)trial);
+
+		bitmap_free(actual_and);
+		bitmap_free(actual_and_not);
+		bitmap_free(actual_xor);
+		bitmap_free(expect_and);
+		bitmap_free(expect_and_not);
+		bitmap_free(expect_xor);
+		roaring_free(and);
+		roaring_free(and_not);
+		roaring_free(xor);
+		roaring_free(ra);
+		roaring_free(rb);
+		ewah_free(ewah_a);
+		ewah_free(ewah_b);
+		bitmap_free(a);
+		bitmap_free(b);
+	}
+
+	for (i = ROARING_ARRAY; i <= ROARING_RUN; i++)
+		for (j = ROARING_ARRAY; j <= ROARING_RUN; j++)
+			if (!seen[i][j])
+				die("containers of types %d and %d never met",
+				    (int)i, (int)j);
+	return 0;
+}
+
+enum speed_op {
+	SPEED_OR,
+	SPEED_AND_NOT,
+	SPEED_POPCOUNT,
+	SPEED_IS_SUBSET,
+	SPEED_OR_EWAH,
+};
+
+static const char *speed_op_names[] = {
+	"or", "and-not", "popcount", "is-subset", "or-ewah"
+};
+
+static void run_speed_test(const char *impl, size_t nr)
+{
+	struct bitmap *a = random_bitmap(nr);
+	struct bitmap *b = bitmap_dup(a);
+	struct ewah_bitmap *ewah = bitmap_to_ewah(a);
+	clock_t initial, start, end;
+	size_t sink = 0;
+	int op;
+
+	impl_or_die(impl);
+	printf("impl: %s (%"PRIuMAX" words)\n", impl, (uintmax_t)nr);
+
+	/* Use this as an offset to make overflow less likely. */
+	initial = clock();
+
+	for (op = 0; op < ARRAY_SIZE(speed_op_names); op++) {
+		unsigned long j;
+		double gb_per_sec;
+
+		start = end = clock() - initial;
+		for (j = 0; ((end - start) / CLOCKS_PER_SEC) < NUM_SECONDS; j++) {
+			switch (op) {
+			case SPEED_OR:
+				bitmap_or(b, a);
+				break;
+			case SPEED_AND_NOT:
+				bitmap_and_not(b, a);
+				break;
+			case SPEED_POPCOUNT:
+				sink += bitmap_popcount(a);
+				break;
+			case SPEED_IS_SUBSET:
+				sink += bitmap_is_subset(a, a);
+				break;
+			case SPEED_OR_EWAH:
+				bitmap_or_ewah(b, ewah);
+				break;
+			}
+
+			/*
+			 * Only check elapsed time every 16 iterations to avoid
+			 * dominating the runtime with system calls.
+			 */
+			if (!(j & 15))
+				end = clock() - initial;
+		}
+		gb_per_sec = (double)j * nr * sizeof(eword_t) /
+			(1e9 * ((double)end - start) / CLOCKS_PER_SEC);
+		printf("%s: %lu iters; %0.2f GB/s\n", speed_op_names[op], j,
+		       gb_per_sec);
+	}
+
+	if (!sink)
+		printf("(no bits set)\n");
+	ewah_free(ewah);
+	bitmap_free(a);
+	bitmap_free(b);
+}
+
+static int ewah_speed(const char *impl, size_t nr)
+{
+	unsigned int i;
+
+	if (impl) {
+		run_speed_test(impl, nr);
+		return 0;
+	}
+	for (i = 0; (impl = bitmap_impl_name(i)); i++)
+		if (!bitmap_use_impl(impl))
+			run_speed_test(impl, nr);
+	return 0;
+}
+
+static const char *ewah_usage =
+	"\ttest-tool ewah list-impls\n"
+	"\ttest-tool ewah verify <impl>\n"
+	"\ttest-tool ewah roaring\n"
+	"\ttest-tool ewah speed [--impl=<name>] [<words>]";
+
+int cmd__ewah(int argc, const char **argv)
+{
+	if (argc == 2 && !strcmp(argv[1], "list-impls"))
+		return ewah_list_impls();
+	if (argc == 3 && !strcmp(argv[1], "verify"))
+		return ewah_verify(argv[2]);
+	if (argc == 2 && !strcmp(argv[1], "roaring"))
+		return ewah_roaring();
+	if (argc >= 2 && !strcmp(argv[1], "speed")) {
+		const char *impl = NULL;
+		size_t nr = 1 << 16;
+
+		argv += 2;
+		argc -= 2;
+		if (argc && skip_prefix(argv[0], "--impl=", &impl)) {
+			argv++;
+			argc--;
+		}
+		if (argc == 1)
+			nr = strtoul(argv[0], NULL, 10);
+		else if (argc)
+			usage(ewah_usage);
+		return ewah_speed(impl, nr);
+	}
+
+	usage(ewah_usage);
+	return -1;
+}
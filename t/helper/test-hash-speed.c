@@ -10,31 +10,22 @@ static inline void compute_hash(const struct git_hash_algo *algo, git_hash_ctx *
 	algo->final_fn(final, ctx);
 }
 
-int cmd__hash_speed(int ac, const char **av)
+static void run_speed_test(const struct git_hash_algo *algo, const char *impl)
 {
 	git_hash_ctx ctx;
 	unsigned char hash[GIT_MAX_RAWSZ];
 	clock_t initial, start, end;
-	unsigned bufsizes[] = { 64, 256, 1024, 8192, 16384 };
+	unsigned bufsizes[] = { 64, 256, 1024, 8192, 16384, 1048576 };
 	int i;
 	void *p;
-	const struct git_hash_algo *algo = NULL;
-
-	if (ac == 2) {
-		for (i = 1; i < GIT_HASH_NALGOS; i++) {
-			if (!strcmp(av[1], hash_algos[i].name)) {
-				algo = &hash_algos[i];
-				break;
-			}
-		}
-	}
-	if (!algo)
-		die("usage: test-tool hash-speed algo_name");
 
 	/* Use this as an offset to make overflow less likely. */
 	initial = clock();
 
-	printf("algo: %s\n", algo->name);
+	if (impl)
+		printf("algo: %s (%s)\n", algo->name, impl);
+	else
+		printf("algo: %s\n", algo->name);
 
 	for (i = 0; i < ARRAY_SIZE(bufsizes); i++) {
 		unsigned long j, kb;
@@ -56,6 +47,52 @@ int cmd__hash_speed(int ac, const char **av)
 		printf("size %u: %lu iters; %lu KiB; %0.2f KiB/s\n", bufsizes[i], j, kb, kb_per_sec);
 		free(p);
 	}
+}
+
+int cmd__hash_speed(int ac, const char **av)
+{
+	const struct git_hash_algo *algo = NULL;
+	const char *impl = NULL;
+	int i;
+
+	if (ac == 3 && skip_prefix(av[1], "--impl=", &impl)) {
+		ac--;
+		av++;
+	}
+	if (ac == 2) {
+		for (i = 1; i < GIT_HASH_NALGOS; i++) {
+			if (!strcmp(av[1], hash_algos[i].name)) {
+				algo = &hash_algos[i];
+				break;
+			}
+		}
+	}
+	if (!algo)
+		die("usage: test-tool hash-speed [--impl=<name>] algo_name");
+
+#ifdef SHA256_BLK
+	/*
+	 * Without --impl, measure each implementation of the block
+	 * function that this CPU supports, one after the other.
+	 */
+	if (hash_algo_by_ptr(algo) == GIT_HASH_SHA256) {
+		const char *name;
+
+		if (impl) {
+			if (blk_SHA256_use_impl(impl) < 0)
+				die("unsupported SHA-256 implementation: %s", impl);
+			run_speed_test(algo, impl);
+			return 0;
+		}
+		for (i = 0; (name = blk_SHA256_impl_name(i)); i++)
+			if (!blk_SHA256_use_impl(name))
+				run_speed_test(algo, name);
+		return 0;
+	}
+#endif
+	if (impl)
+		die("cannot select an implementation of %s", algo->name);
 
+	run_speed_test(algo, NULL);
 	return 0;
 }
@@ -3,5 +3,26 @@
 
 int cmd__sha256(int ac, const char **av)
 {
+	const char *impl;
+
+	if (ac == 2 && !strcmp(av[1], "--list-impls")) {
+#ifdef SHA256_BLK
+		unsigned int i;
+
+		for (i = 0; (impl = blk_SHA256_impl_name(i)); i++)
+			if (!blk_SHA256_use_impl(impl))
+				puts(impl);
+#endif
+		return 0;
+	}
+	if (ac > 1 && skip_prefix(av[1], "--impl=", &impl)) {
+#ifdef SHA256_BLK
+		if (blk_SHA256_use_impl(impl) < 0)
+#endif
+			die("unsupported SHA-256 implementation: %s", impl);
+		av[1] = av[0];
+		av++;
+		ac--;
+	}
 	return cmd_hash_impl(ac, av, GIT_HASH_SHA256);
 }
@@ -24,6 +24,9 @@ graph_git_behavior() {
 		graph_git_two_modes "log --oneline $BRANCH" &&
 		graph_git_two_modes "log --topo-order $BRANCH" &&
 		graph_git_two_modes "log --graph $COMPARE..$BRANCH" &&
+		graph_git_two_modes "rev-list --parents --timestamp $BRANCH" &&
+		graph_git_two_modes "rev-list --first-parent --skip=1 -n 3 $BRANCH" &&
+		graph_git_two_modes "rev-list --count --all" &&
 		graph_git_two_modes "branch -vv" &&
 		graph_git_two_modes "merge-base -a $BRANCH $COMPARE"
 	'
@@ -13,7 +13,8 @@ set_checkout_config () {
 	test_config_global checkout.thresholdForParallelism $2
 }
 
-# Run "${@:2}" and check that $1 checkout workers were used
+# Run "${@:2}" and check that $1 checkout workers were used, be they
+# checkout--worker processes or threads
 test_checkout_workers () {
 	if test $# -lt 2
 	then
@@ -24,16 +25,18 @@ test_checkout_workers () {
 	shift &&
 
 	local trace_file=trace-test-checkout-workers &&
-	rm -f "$trace_file" &&
+	rm -f "$trace_file" "$trace_file.event" &&
 	(
 		GIT_TRACE2="$(pwd)/$trace_file" &&
-		export GIT_TRACE2 &&
+		GIT_TRACE2_EVENT="$(pwd)/$trace_file.event" &&
+		export GIT_TRACE2 GIT_TRACE2_EVENT &&
 		"$@" 2>&8
 	) &&
 
-	local workers="$(grep "child_start\[..*\] git checkout--worker" "$trace_file" | wc -l)" &&
-	test $workers -eq $expected_workers &&
-	rm "$trace_file"
+	local processes="$(grep "child_start\[..*\] git checkout--worker" "$trace_file" | wc -l)" &&
+	local threads="$(grep "\"event\":\"thread_start\".*:pcheckout_worker\"" "$trace_file.event" | wc -l)" &&
+	test $(($processes + $threads)) -eq $expected_workers &&
+	rm "$trace_file" "$trace_file.event"
 } 8>&2 2>&4
 
 # Verify that both the working tree and the index were created correctly
@@ -45,4 +45,36 @@ test_perf 'rev-list --objects $commit --not --all' '
 	git rev-list --objects $commit --not --all >/dev/null
 '
 
+test_expect_success 'write commit-graph' '
+	git commit-graph write --reachable
+'
+
+# A plain rev-list walks the commit-graph by position; asking for a
+# format makes it fall back to the walk over "struct commit".
+for walk in graph regular
+do
+	case $walk in
+	graph)
+		format=
+		;;
+	regular)
+		format=--format=%H
+		;;
+	esac
+
+	test_perf "rev-list --all ($walk walk)" "
+		git rev-list --all $format >/dev/null
+	"
+
+	# GNU time reports the peak RSS in KiB
+	test_size "rev-list --all peak RSS ($walk walk)" "
+		\"\$GTIME\" -f %M -o rss git rev-list --all $format >/dev/null &&
+		echo \$((\$(cat rss) * 1024))
+	"
+
+	test_perf "rev-list --count --all ($walk walk)" "
+		git rev-list --count --all $format >/dev/null
+	"
+done
+
 test_done
@@ -14,6 +14,10 @@ depth of 50.
 The setting of core.deltaBaseCacheLimit in the source repository is also
 relevant (depending on the size of your test repo), so be sure it is consistent
 between runs.
+
+The tests after the "deep delta chains" repack exercise chains of up to 250
+deltas. Running them with GIT_TRACE2_PERF set shows the "delta_base_cache"
+hit, miss and evict counters for each command.
 '
 . ./perf-lib.sh
 
@@ -28,4 +32,37 @@ test_perf 'log -S' '
 	git log --raw -Sfoo >/dev/null
 '
 
+# reconstructing blobs of older commits walks their delta chains
+test_perf 'log -p' '
+	git log -p -1000 >/dev/null
+'
+
+# cache pressure: the eviction policy matters more than its size here
+test_perf 'log -p (small cache)' '
+	git -c core.deltaBaseCacheLimit=8m log -p -1000 >/dev/null
+'
+
+# many threads looking up bases at once
+test_perf 'grep --threads=8 (100 commits)' '
+	git grep --threads=8 -c foo $(git rev-list -100 HEAD) >/dev/null ||
+	test $? = 1
+'
+
+test_expect_success 'repack with deep delta chains' '
+	git repack -adf --depth=250
+'
+
+test_perf 'log -p (deep chains)' '
+	git log -p -1000 >/dev/null
+'
+
+test_perf 'log -p (deep chains, small cache)' '
+	git -c core.deltaBaseCacheLimit=8m log -p -1000 >/dev/null
+'
+
+test_perf 'grep --threads=8 (deep chains, 100 commits)' '
+	git grep --threads=8 -c foo $(git rev-list -100 HEAD) >/dev/null ||
+	test $? = 1
+'
+
 test_done
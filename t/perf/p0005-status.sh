@@ -46,4 +46,9 @@ test_perf "read-tree status br_ballast ($nr_files)" '
 	git status
 '
 
+test_perf "read-tree status br_ballast, preloading with io_uring ($nr_files)" '
+	git read-tree HEAD &&
+	git -c core.preloadIndexIOUring=true status
+'
+
 test_done
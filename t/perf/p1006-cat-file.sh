@@ -5,8 +5,34 @@ test_description='Tests listing object info performance'
 
 test_perf_large_repo
 
+test_expect_success 'setup' '
+	git cat-file --batch-all-objects --batch-check="%(objectname)" >oids &&
+	git cat-file --batch-all-objects --batch-check="%(objectname) %(objecttype)" |
+	sed -n "s/ blob\$//p" >blobs
+'
+
 test_perf 'cat-file --batch-check' '
 	git cat-file --batch-all-objects --batch-check
 '
 
+test_perf 'cat-file --batch' '
+	git cat-file --batch-all-objects --batch >/dev/null
+'
+
+test_perf 'cat-file --batch --unordered' '
+	git cat-file --batch-all-objects --batch --unordered >/dev/null
+'
+
+test_perf 'cat-file --batch --buffer <oids' '
+	git cat-file --batch --buffer <oids >/dev/null
+'
+
+test_perf 'cat-file --batch --no-buffer <oids' '
+	git cat-file --batch <oids >/dev/null
+'
+
+test_perf 'cat-file --batch --buffer <blobs' '
+	git cat-file --batch --buffer <blobs >/dev/null
+'
+
 test_done
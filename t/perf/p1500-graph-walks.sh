@@ -47,4 +47,12 @@ test_perf 'contains: git tag --merged' '
 	xargs git tag --merged=HEAD <tags
 '
 
+test_perf 'merge-base: git merge-base --all' '
+	xargs git merge-base --all HEAD <refs
+'
+
+test_perf 'topo-order: git log --topo-order -n 100' '
+	git log --topo-order -n 100 --format=%H --all >/dev/null
+'
+
 test_done
@@ -31,10 +31,16 @@ test_lookup_pack_bitmap () {
 		git config pack.writeBitmapLookupTable '"$1"'
 	'
 
+	test_perf "enable roaring bitmaps: $2" '
+		git config pack.writeBitmapRoaring '"$2"'
+	'
+
 	test_pack_bitmap
 }
 
-test_lookup_pack_bitmap false
-test_lookup_pack_bitmap true
+test_lookup_pack_bitmap false false
+test_lookup_pack_bitmap true false
+test_lookup_pack_bitmap false true
+test_lookup_pack_bitmap true true
 
 test_done
@@ -179,6 +179,10 @@ test_fsmonitor_suite () {
 	else
 		DESC="fsmonitor=disabled"
 	fi
+	if test -n "$USE_PRELOAD_RING"
+	then
+		DESC="$DESC, preloadIndexIOUring"
+	fi
 
 	test_expect_success "test_initialization" '
 		git reset --hard &&
@@ -285,6 +289,25 @@ test_expect_success "setup without fsmonitor" '
 test_fsmonitor_suite
 trace_stop
 
+#
+# Run them again with the lstat() calls of the index preloading batched
+# in an io_uring. This only matters when fsmonitor is disabled, as Git
+# then lstat()s every file in the index.
+#
+trace_start fsmonitor-disabled-preload-ring
+test_expect_success "setup for core.preloadIndexIOUring" '
+	git config core.preloadIndexIOUring true
+'
+
+USE_PRELOAD_RING=t
+test_fsmonitor_suite
+unset USE_PRELOAD_RING
+
+test_expect_success "teardown for core.preloadIndexIOUring" '
+	git config --unset core.preloadIndexIOUring
+'
+trace_stop
+
 #
 # Run a full set of perf tests using the built-in fsmonitor--daemon.
 # It does not use the Hook API, so it has a different setup.
@@ -0,0 +1,119 @@
+#!/bin/sh
+
+test_description='basic tests for the commit queue'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+# The commits have the following dates and topological levels:
+#
+#  c1 (100, 1) -- c2 (200, 2) -- c3 (300, 3) -- t1 -- t2 -- t3 (1000, 4-6)
+#    \
+#     s1 (500, 2)
+#
+test_expect_success 'setup' '
+	test_commit --date "@100 +0000" c1 &&
+	test_commit --date "@200 +0000" c2 &&
+	test_commit --date "@300 +0000" c3 &&
+	test_commit --date "@1000 +0000" t1 &&
+	test_commit --date "@1000 +0000" t2 &&
+	test_commit --date "@1000 +0000" t3 &&
+	git checkout -b side c1 &&
+	test_commit --date "@500 +0000" s1
+'
+
+cat >expect <<'EOF'
+s1
+c3
+c2
+c1
+EOF
+test_expect_success 'basic ordering' '
+	test-tool commit-queue c2 s1 c1 c3 dump >actual &&
+	test_cmp expect actual
+'
+
+cat >expect <<'EOF'
+c3
+s1
+c2
+c1
+NULL
+EOF
+test_expect_success 'mixed put and get' '
+	test-tool commit-queue c1 c3 get s1 c2 get get get get >actual &&
+	test_cmp expect actual
+'
+
+cat >expect <<'EOF'
+NULL
+NULL
+EOF
+test_expect_success 'notice empty queue' '
+	test-tool commit-queue get get dump >actual &&
+	test_cmp expect actual
+'
+
+cat >expect <<'EOF'
+t2
+t3
+t1
+EOF
+test_expect_success 'ties are returned in insertion order' '
+	test-tool commit-queue t2 t3 t1 dump >actual &&
+	test_cmp expect actual
+'
+
+cat >expect <<'EOF'
+t3
+t2
+t1
+c3
+c1
+EOF
+test_expect_success 'ties are not returned in reverse insertion order' '
+	test-tool commit-queue c1 t3 t2 c3 t1 dump >actual &&
+	test_cmp expect actual
+'
+
+cat >expect <<'EOF'
+t3
+t1
+t2
+c2
+EOF
+test_expect_success 'ties put after a get come after the older ones' '
+	test-tool commit-queue t3 c2 get t1 t2 dump >actual &&
+	test_cmp expect actual
+'
+
+cat >expect <<'EOF'
+t3
+t2
+t1
+c3
+s1
+c2
+c1
+EOF
+test_expect_success 'order by generation, then by date' '
+	git -c commitGraph.generationVersion=1 commit-graph write --reachable &&
+	test-tool commit-queue --generation c1 t1 s1 t3 c2 t2 c3 dump >actual &&
+	test_cmp expect actual
+'
+
+cat >expect <<'EOF'
+t1
+t3
+t2
+s1
+c3
+c2
+c1
+EOF
+test_expect_success 'only order by date without --generation' '
+	test-tool commit-queue c1 t1 s1 t3 c2 t2 c3 dump >actual &&
+	test_cmp expect actual
+'
+
+test_done
@@ -404,6 +404,23 @@ test_expect_success 'check splitIndex.sharedIndexExpire set to "never" and "now"
 	test $(ls .git/sharedindex.* | wc -l) -le 2
 '
 
+test_expect_success 'shared index is only freshened when getting old' '
+	git config splitIndex.sharedIndexExpire "2.weeks.ago" &&
+	git update-index --split-index &&
+	shared=.git/sharedindex.$(test-tool dump-split-index .git/index |
+				 sed -n "s/^base //p") &&
+	test-tool chmtime =-86400 $shared &&
+	test-tool chmtime --get $shared >expect &&
+	git ls-files >/dev/null &&
+	test-tool chmtime --get $shared >actual &&
+	test_cmp expect actual &&
+	test-tool chmtime =$((-8*86400)) $shared &&
+	test-tool chmtime --get $shared >old &&
+	git ls-files >/dev/null &&
+	test-tool chmtime --get $shared >actual &&
+	test $(cat actual) -gt $(cat old)
+'
+
 test_expect_success POSIXPERM 'same mode for index & split index' '
 	git init same-mode &&
 	(
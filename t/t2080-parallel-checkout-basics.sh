@@ -229,6 +229,38 @@ test_expect_success SYMLINKS 'parallel checkout checks for symlinks in leading d
 	)
 '
 
+test_expect_success 'checkout.threadedWorkers selects threads or processes' '
+	set_checkout_config 2 0 &&
+	git init backends &&
+	(
+		cd backends &&
+		test_commit A &&
+		test_commit B &&
+
+		rm A.t B.t &&
+		GIT_TRACE2="$(pwd)/trace-processes" \
+			git -c checkout.threadedWorkers=false checkout . &&
+		test_stdout_line_count = 2 grep "child_start\[..*\] git checkout--worker" trace-processes &&
+		grep A A.t &&
+		grep B B.t &&
+
+		rm A.t B.t &&
+		GIT_TRACE2_EVENT="$(pwd)/trace-threads" \
+			git -c checkout.threadedWorkers=true checkout . &&
+		test_stdout_line_count = 2 grep "\"event\":\"thread_start\".*:pcheckout_worker\"" trace-threads &&
+		! grep "checkout--worker" trace-threads &&
+		grep A A.t &&
+		grep B B.t &&
+
+		# and stream the blobs from a pack too
+		git repack -adq &&
+		rm A.t B.t &&
+		git -c checkout.threadedWorkers=true checkout . &&
+		grep A A.t &&
+		grep B B.t
+	)
+'
+
 # This test is here (and not in e.g. t2022-checkout-paths.sh), because we
 # check the final report including sequential, parallel, and delayed entries
 # all at the same time. So we must have finer control of the parallel checkout
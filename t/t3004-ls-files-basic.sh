@@ -52,4 +52,65 @@ test_expect_success SYMLINKS 'ls-files with absolute paths to symlinks' '
 	test_cmp expect actual
 '
 
+test_expect_success 'ls-files lists the same entries from every index format' '
+	test_create_repo formats &&
+	(
+		cd formats &&
+		mkdir -p dir/sub other &&
+		for f in a dir/b dir/sub/c dir/sub/d other/e
+		do
+			echo $f >$f || return 1
+		done &&
+		git add . &&
+		git update-index --split-index &&
+		git ls-files -s >expect.split &&
+		git ls-files -s dir/ >expect.split.dir &&
+		git -C dir ls-files -s >expect.split.sub &&
+		git update-index --no-split-index &&
+		for v in 2 3 4
+		do
+			git update-index --index-version $v &&
+			git ls-files -s >actual &&
+			test_cmp expect.split actual &&
+			git ls-files -s dir/ >actual &&
+			test_cmp expect.split.dir actual &&
+			git -C dir ls-files -s >actual &&
+			test_cmp expect.split.sub actual || return 1
+		done
+	)
+'
+
+test_expect_success 'ls-files falls back to reading a malformed index' '
+	test_create_repo malformed &&
+	(
+		cd malformed &&
+		echo a >a &&
+		echo b >b &&
+		git add b &&
+		git add -N a &&
+		git -c index.recordEndOfIndexEntries=true \
+			update-index --force-write-index &&
+
+		# give the first entry, "a", an unknown extended flag
+		hashsz=$(test_oid rawsz) &&
+		perl -e "
+			my \$hashsz = shift;
+			local \$/;
+			binmode STDIN;
+			binmode STDOUT;
+			my \$index = <STDIN>;
+			substr(\$index, 12 + 40 + \$hashsz + 2, 2) = pack(\"n\", 0x2001);
+			print substr(\$index, 0, length(\$index) - \$hashsz);
+		" $hashsz <.git/index >index.tmp &&
+		test-tool $(test_oid algo) -b <index.tmp >trailer &&
+		cat index.tmp trailer >.git/index &&
+
+		test_must_fail env GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git ls-files >out 2>err &&
+		grep "\"region_enter\".*\"label\":\"do_read_index\"" trace &&
+		test_i18ngrep "unknown index entry format" err &&
+		test_must_be_empty out
+	)
+'
+
 test_done
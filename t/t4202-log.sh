@@ -2368,4 +2368,21 @@ test_expect_success 'log --invert-grep --grep --author' '
 	test_cmp expect actual
 '
 
+test_expect_success 'log --topo-order shows a tip before walking to older tips' '
+	git init topo-tips &&
+	test_commit_bulk -C topo-tips 50 &&
+	git -C topo-tips branch old HEAD~40 &&
+	test_commit_bulk -C topo-tips --start=51 10 &&
+	git -C topo-tips commit-graph write --reachable &&
+
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git -C topo-tips log --topo-order -n 1 --all >actual &&
+	grep "\"count_indegree_walked\":[0-9]," trace.txt &&
+
+	git -C topo-tips log --topo-order --all >actual &&
+	git -C topo-tips -c core.commitGraph=false \
+		log --topo-order --all >expect &&
+	test_cmp expect actual
+'
+
 test_done
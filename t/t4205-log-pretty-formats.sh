@@ -1094,6 +1094,27 @@ test_expect_success EXPENSIVE,SIZE_T_IS_64BIT 'log --pretty with huge commit mes
 	test_cmp expect error
 '
 
+test_expect_success 'log.formatThreads does not change the output' '
+	git init format-threads &&
+	for i in $(test_seq 1 40)
+	do
+		test_commit -C format-threads --no-tag "threaded $i" || return 1
+	done &&
+	test_commit_bulk -C format-threads --message="bulk %s" 1100 &&
+	for fmt in medium fuller oneline "format:%h %H %t %p %an %aN %ad %cr %s%n%b" \
+		"tformat:%C(auto)%h %<(20,trunc)%s %aI"
+	do
+		git -C format-threads log --pretty="$fmt" >expect &&
+		git -C format-threads -c log.formatThreads=4 log \
+			--pretty="$fmt" >actual &&
+		test_cmp expect actual &&
+		git -C format-threads log --pretty="$fmt" --stat -n 1030 >expect &&
+		git -C format-threads -c log.formatThreads=3 log \
+			--pretty="$fmt" --stat -n 1030 >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
 # pretty-formats note wide char limitations, and add tests
 test_expect_failure 'wide and decomposed characters column counting' '
 
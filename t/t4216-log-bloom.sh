@@ -139,6 +139,26 @@ test_expect_success 'git log with wildcard that resolves to a multiple paths doe
 	test_bloom_filters_not_used "-- file*"
 '
 
+test_expect_success 'git log with wildcard uses Bloom filters for its leading directory' '
+	(
+		# keep the shell from expanding the pathspecs in setup()
+		set -f &&
+		test_bloom_filters_used "-- A/*" &&
+		test_bloom_filters_used "-- A/B/*2" &&
+		test_bloom_filters_used "-- A/B/fi*" &&
+		test_bloom_filters_not_used "-- *4"
+	)
+'
+
+test_expect_success 'git log -L gives the same result with Bloom filters' '
+	for path in A/file1 A/B/file2 A/B/C/file3
+	do
+		git -c core.commitGraph=false log --format=%s -L1,1:$path >expect &&
+		git -c core.commitGraph=true log --format=%s -L1,1:$path >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
 test_expect_success 'setup - add commit-graph to the chain without Bloom filters' '
 	test_commit c14 A/anotherFile2 &&
 	test_commit c15 A/B/anotherFile2 &&
@@ -404,4 +424,33 @@ test_expect_success 'Bloom generation backfills empty commits' '
 	)
 '
 
+test_expect_success 'Bloom filters do not depend on commitGraph.threads' '
+	git init threads &&
+	test_when_finished "rm -fr threads" &&
+	(
+		cd threads &&
+		for i in $(test_seq 1 20)
+		do
+			mkdir -p dir$((i % 3)) &&
+			echo $i >dir$((i % 3))/file$i &&
+			git add . &&
+			git commit -q -m "$i" || return 1
+		done &&
+		git commit --allow-empty -m empty &&
+
+		graph=.git/objects/info/commit-graph &&
+		git -c commitGraph.threads=1 commit-graph write --reachable \
+			--changed-paths &&
+		mv $graph expect &&
+
+		rm -f trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git -c commitGraph.threads=4 commit-graph write \
+				--reachable --changed-paths &&
+		test_filter_computed 21 trace.event &&
+		test_filter_trunc_empty 1 trace.event &&
+		cmp expect $graph
+	)
+'
+
 test_done
@@ -594,4 +594,32 @@ test_expect_success 'negative window clamps to 0' '
 	check_deltas stderr = 0
 '
 
+test_expect_success 'pack.enumerationThreads does not change the pack' '
+	git pack-objects --revs --all --stdout </dev/null >expect.pack &&
+	git -c pack.enumerationThreads=4 \
+		pack-objects --revs --all --stdout </dev/null >actual.pack &&
+	test_cmp_bin expect.pack actual.pack
+'
+
+test_expect_success 'pack.enumerationThreads with objects in many packs' '
+	git init enumeration-packs &&
+	(
+		cd enumeration-packs &&
+		for i in 1 2 3 4 5 6
+		do
+			mkdir dir$i &&
+			echo $i >dir$i/file &&
+			git add dir$i &&
+			git commit -m $i &&
+			git repack -dq || return 1
+		done &&
+		ls .git/objects/pack/*.pack >packs &&
+		test_line_count = 6 packs &&
+		git pack-objects --revs --all --stdout </dev/null >expect.pack &&
+		git -c pack.enumerationThreads=4 \
+			pack-objects --revs --all --stdout </dev/null >actual.pack &&
+		test_cmp_bin expect.pack actual.pack
+	)
+'
+
 test_done
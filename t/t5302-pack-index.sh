@@ -68,6 +68,28 @@ test_expect_success 'index-pack results should match pack-objects ones' '
 	cmp "test-2-${pack2}.idx" "2.idx"
 '
 
+test_expect_success 'index-pack resolves deltas while streaming' '
+	test_when_finished "rm -f trace.event streaming.*" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c pack.streamingIndex=true -c pack.threads=4 \
+		index-pack --index-version=2 --stdin streaming.pack \
+		<"test-1-${pack1}.pack" &&
+	cmp "test-2-${pack2}.idx" streaming.idx &&
+	grep "\"early-resolved-deltas\",\"value\":\"[1-9]" trace.event &&
+	grep "\"region_enter\".*\"resolve-deltas\"" trace.event
+'
+
+test_expect_success 'index-pack bounds the deltas queued while streaming' '
+	test_when_finished "rm -f trace.event streaming.*" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c pack.streamingIndex=true -c pack.threads=4 \
+		-c core.deltaBaseCacheLimit=1 \
+		index-pack --index-version=2 --stdin streaming.pack \
+		<"test-1-${pack1}.pack" &&
+	cmp "test-2-${pack2}.idx" streaming.idx &&
+	grep "\"early-resolved-deltas\",\"value\":\"0\"" trace.event
+'
+
 test_expect_success 'index-pack --verify on index version 1' '
 	git index-pack --verify "test-1-${pack1}.pack"
 '
@@ -28,17 +28,20 @@ has_any () {
 
 test_bitmap_cases () {
 	writeLookupTable=false
+	writeRoaring=false
 	for i in "$@"
 	do
 		case "$i" in
 		"pack.writeBitmapLookupTable") writeLookupTable=true;;
+		"pack.writeBitmapRoaring") writeRoaring=true;;
 		esac
 	done
 
 	test_expect_success 'setup test repository' '
 		rm -fr * .git &&
 		git init &&
-		git config pack.writeBitmapLookupTable '"$writeLookupTable"'
+		git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+		git config pack.writeBitmapRoaring '"$writeRoaring"'
 	'
 	setup_bitmap_history
 
@@ -199,16 +202,21 @@ test_bitmap_cases () {
 		)
 	'
 
-	test_expect_success JGIT,SHA1 'jgit can read our bitmaps' '
-		git clone --bare . compat-us.git &&
-		(
-			cd compat-us.git &&
-			git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
-			git repack -adb &&
-			# jgit gc will barf if it does not like our bitmaps
-			jgit gc
-		)
-	'
+	# jgit does not know about roaring bitmaps
+	if test "$writeRoaring" = false
+	then
+		test_expect_success JGIT,SHA1 'jgit can read our bitmaps' '
+			git clone --bare . compat-us.git &&
+			(
+				cd compat-us.git &&
+				git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+				git config pack.writeBitmapRoaring '"$writeRoaring"' &&
+				git repack -adb &&
+				# jgit gc will barf if it does not like our bitmaps
+				jgit gc
+			)
+		'
+	fi
 
 	test_expect_success 'splitting packs does not generate bogus bitmaps' '
 		test-tool genrandom foo $((1024 * 1024)) >rand &&
@@ -267,11 +275,12 @@ test_bitmap_cases () {
 		mv -f $bitmap.tmp $bitmap &&
 		git rev-list --use-bitmap-index --count --all >actual 2>stderr &&
 		test_cmp expect actual &&
-		test_i18ngrep corrupt.ewah.bitmap stderr
+		test_i18ngrep -E "corrupt.(ewah|roaring).bitmap" stderr
 	'
 
 	test_expect_success 'truncated bitmap fails gracefully (cache)' '
 		git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+		git config pack.writeBitmapRoaring '"$writeRoaring"' &&
 		git repack -ad &&
 		git rev-list --use-bitmap-index --count --all >expect &&
 		bitmap=$(ls .git/objects/pack/*.bitmap) &&
@@ -371,6 +380,7 @@ test_bitmap_cases () {
 		(
 			cd repo &&
 			git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+			git config pack.writeBitmapRoaring '"$writeRoaring"' &&
 
 			# create enough commits that not all are receive bitmap
 			# coverage even if they are all at the tip of some reference.
@@ -410,6 +420,7 @@ test_bitmap_cases () {
 		(
 			cd repo &&
 			git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+			git config pack.writeBitmapRoaring '"$writeRoaring"' &&
 			test_commit_bulk --message="%s" 103 &&
 
 			cat >>.git/config <<-\EOF &&
@@ -431,6 +442,7 @@ test_bitmap_cases () {
 		(
 			cd repo &&
 			git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+			git config pack.writeBitmapRoaring '"$writeRoaring"' &&
 
 			test_commit base &&
 
@@ -455,6 +467,17 @@ test_bitmap_cases () {
 	'
 }
 
+for impl in $(test-tool ewah list-impls)
+do
+	test_expect_success "bitmap operations agree with generic ($impl)" "
+		test-tool ewah verify $impl
+	"
+done
+
+test_expect_success 'roaring AND, AND-NOT and XOR agree with uncompressed bitmaps' '
+	test-tool ewah roaring
+'
+
 test_bitmap_cases
 
 test_expect_success 'incremental repack fails when bitmaps are requested' '
@@ -489,4 +512,26 @@ test_expect_success 'truncated bitmap fails gracefully (lookup table)' '
 	test_i18ngrep corrupted.bitmap.index stderr
 '
 
+test_bitmap_cases "pack.writeBitmapRoaring"
+
+test_expect_success 'roaring bitmaps are written as version 2' '
+	git repack -adb &&
+	git rev-list --test-bitmap HEAD 2>err &&
+	grep "Bitmap v2 test" err &&
+	test_config pack.writeBitmapRoaring false &&
+	git repack -adb &&
+	git rev-list --test-bitmap HEAD 2>err &&
+	grep "Bitmap v1 test" err
+'
+
+test_bitmap_cases "pack.writeBitmapLookupTable" "pack.writeBitmapRoaring"
+
+test_expect_success 'roaring bitmaps with lookup table round-trip' '
+	git rev-list --use-bitmap-index --objects --all >actual.raw &&
+	git rev-list --objects --all >expect.raw &&
+	cut -d" " -f1 <actual.raw | sort >actual &&
+	cut -d" " -f1 <expect.raw | sort >expect &&
+	test_cmp expect actual
+'
+
 test_done
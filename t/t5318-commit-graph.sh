@@ -812,6 +812,22 @@ test_expect_success 'set up and verify repo with generation data overflow chunk'
 
 graph_git_behavior 'generation data overflow chunk repo' repo left right
 
+test_expect_success 'rev-list walks plain traversals in the commit-graph' '
+	cd "$TRASH_DIRECTORY/repo" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git rev-list --parents --all >output &&
+	grep "\"key\":\"graph-walk/commits\",\"value\":\"10\"" trace.txt &&
+	git -c core.commitGraph=false rev-list --parents --all >expect &&
+	test_cmp expect output &&
+
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git rev-list left ^right >output &&
+	! grep graph-walk trace.txt &&
+	git -c core.commitGraph=false rev-list left ^right >expect &&
+	test_cmp expect output
+'
+
 test_expect_success 'overflow during generation version upgrade' '
 	git init overflow-v2-upgrade &&
 	(
@@ -404,6 +404,71 @@ test_expect_success '--split=replace replaces the chain' '
 	graph_read_expect 2
 '
 
+test_expect_success '--max-layers and commitGraph.maxLayers bound the chain' '
+	git init max-layers &&
+	(
+		cd max-layers &&
+		test_commit_bulk 40 &&
+		git commit-graph write --split=no-merge --reachable &&
+		test_commit_bulk 12 &&
+		git commit-graph write --split=no-merge --reachable &&
+		test_commit_bulk 4 &&
+		git commit-graph write --split=no-merge --reachable &&
+		test_line_count = 3 $graphdir/commit-graph-chain &&
+		test_commit_bulk 1 &&
+		git commit-graph write --split --reachable --max-layers=3 &&
+		test_line_count = 3 $graphdir/commit-graph-chain &&
+		test_commit_bulk 1 &&
+		git -c commitGraph.maxLayers=2 commit-graph write --split --reachable &&
+		test_line_count = 2 $graphdir/commit-graph-chain &&
+		git commit-graph verify
+	)
+'
+
+test_expect_success '--max-layers=0 overrides commitGraph.maxLayers' '
+	(
+		cd max-layers &&
+		test_line_count = 2 $graphdir/commit-graph-chain &&
+		test_commit_bulk 1 &&
+		git -c commitGraph.maxLayers=2 commit-graph write --split \
+			--reachable --max-layers=0 &&
+		test_line_count = 3 $graphdir/commit-graph-chain &&
+		git commit-graph verify
+	)
+'
+
+test_expect_success 'receive.writeCommitGraph adds a layer for pushed commits' '
+	git init --bare push-target &&
+	git -C push-target config receive.writeCommitGraph true &&
+	git init push-source &&
+	test_commit_bulk -C push-source 10 &&
+	git -C push-source push ../push-target HEAD:refs/heads/main &&
+	chain=push-target/objects/info/commit-graphs/commit-graph-chain &&
+	test_line_count = 1 $chain &&
+	test_commit -C push-source two &&
+	test_commit -C push-source three &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git -C push-source push ../push-target HEAD:refs/heads/main &&
+	grep "\"key\":\"split/new-commits\",\"value\":\"2\"" trace.txt &&
+	test_line_count = 2 $chain &&
+	git -C push-target commit-graph verify &&
+	git -C push-source push ../push-target :refs/heads/main &&
+	test_line_count = 2 $chain &&
+	git -C push-target commit-graph verify
+'
+
+test_expect_success 'receive.writeCommitGraph peels pushed annotated tags' '
+	git -C push-source checkout --detach &&
+	test_commit -C push-source --no-tag tagged &&
+	git -C push-source tag -a -m tagged v1.0 &&
+	git -C push-source checkout - &&
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git -C push-source push ../push-target refs/tags/v1.0 &&
+	grep "\"key\":\"split/new-commits\",\"value\":\"1\"" trace.txt &&
+	git -C push-target commit-graph verify
+'
+
 test_expect_success ULIMIT_FILE_DESCRIPTORS 'handles file descriptor exhaustion' '
 	git init ulimit &&
 	(
@@ -0,0 +1,125 @@
+#!/bin/sh
+
+test_description='upload-pack response cache'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_commit one &&
+	test_commit two &&
+	test_commit three &&
+	git config uploadpack.responseCache true &&
+	git config uploadpack.allowFilter true
+'
+
+clone_with_trace () {
+	rm -rf dst.git trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git clone --bare --no-local "$@" . dst.git &&
+	git -C dst.git fsck
+}
+
+test_expect_success 'first clone fills the cache' '
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace &&
+	ls .git/upload-pack-cache >entries &&
+	test_line_count = 1 entries
+'
+
+test_expect_success 'identical clone is served from the cache' '
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"hit\"" trace &&
+	ls .git/upload-pack-cache >entries &&
+	test_line_count = 1 entries &&
+	git -C dst.git rev-parse HEAD >actual &&
+	git rev-parse HEAD >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'cached response is shared with protocol v0' '
+	clone_with_trace -c protocol.version=0 &&
+	grep "\"response-cache\",\"value\":\"hit\"" trace
+'
+
+test_expect_success 'different requests use different entries' '
+	clone_with_trace --filter=blob:none &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace &&
+	clone_with_trace --depth=1 &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace &&
+	git -C dst.git rev-list --all >revs &&
+	test_line_count = 1 revs &&
+	clone_with_trace --depth=1 &&
+	grep "\"response-cache\",\"value\":\"hit\"" trace
+'
+
+test_expect_success 'repacking invalidates the cache' '
+	git repack -ad &&
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace
+'
+
+test_expect_success 'new loose objects invalidate the cache' '
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"hit\"" trace &&
+	echo loose | git hash-object -w --stdin &&
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace
+'
+
+test_expect_success 'upload-pack configuration is part of the key' '
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"hit\"" trace &&
+	test_config uploadpack.allowAnySHA1InWant true &&
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace &&
+	test_config uploadpack.hideRefs refs/tags/one &&
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace
+'
+
+test_expect_success 'deleting a tag invalidates responses that include tags' '
+	git tag -a -m first annotated one &&
+	clone_with_trace --single-branch &&
+	git -C dst.git rev-parse --verify refs/tags/annotated &&
+	clone_with_trace --single-branch &&
+	grep "\"response-cache\",\"value\":\"hit\"" trace &&
+	git tag -d annotated &&
+	clone_with_trace --single-branch &&
+	test_must_fail git -C dst.git rev-parse --verify refs/tags/annotated &&
+	grep "\"response-cache\",\"value\":\"miss\"" trace
+'
+
+test_expect_success 'cache is not used with grafts' '
+	test_when_finished "rm -f .git/info/grafts" &&
+	mkdir -p .git/info &&
+	git rev-parse HEAD >.git/info/grafts &&
+	clone_with_trace &&
+	grep "\"response-cache\",\"value\":\"skipped\"" trace
+'
+
+test_expect_success 'least recently used entries are evicted' '
+	rm -rf .git/upload-pack-cache &&
+	clone_with_trace &&
+	ls .git/upload-pack-cache >old &&
+	test-tool chmtime =-60 .git/upload-pack-cache/* &&
+
+	# room for the full clone, but not for both
+	size=$(wc -c <.git/upload-pack-cache/$(cat old)) &&
+	test_config uploadpack.responseCacheMaxSize $size &&
+	clone_with_trace --depth=1 &&
+	grep "\"response-cache/evicted\",\"value\":\"1\"" trace &&
+	ls .git/upload-pack-cache >entries &&
+	test_line_count = 1 entries &&
+	! test_cmp old entries
+'
+
+test_expect_success 'no cache unless enabled' '
+	rm -rf .git/upload-pack-cache &&
+	test_config uploadpack.responseCache false &&
+	clone_with_trace &&
+	! grep "\"response-cache\"" trace &&
+	test_path_is_missing .git/upload-pack-cache
+'
+
+test_done
@@ -61,8 +61,31 @@ test_expect_success 'setup' '
 	git config core.commitGraph true
 '
 
+# Keep two reachability bitmaps aside: one covering every commit, and
+# one covering only the history of commit-5-5, so that commits outside
+# of it have to be walked.
+test_expect_success 'setup bitmaps' '
+	git repack -adb &&
+	for f in .git/objects/pack/pack-*.bitmap
+	do
+		mv "$f" bitmap-full &&
+		basename "$f" >bitmap-full-name || return 1
+	done &&
+	git init half &&
+	git -C half fetch --no-tags .. commit-5-5:refs/heads/main &&
+	git -C half repack -adb &&
+	for f in half/.git/objects/pack/pack-*.bitmap
+	do
+		mv "$f" bitmap-half &&
+		basename "$f" >bitmap-half-name || return 1
+	done &&
+	cp half/.git/objects/pack/pack-*.pack half/.git/objects/pack/pack-*.idx \
+		.git/objects/pack/
+'
+
 run_all_modes () {
-	test_when_finished rm -rf .git/objects/info/commit-graph &&
+	test_when_finished rm -rf .git/objects/info/commit-graph \
+		.git/objects/pack/*.bitmap &&
 	"$@" <input >actual &&
 	test_cmp expect actual &&
 	cp commit-graph-full .git/objects/info/commit-graph &&
@@ -73,6 +96,14 @@ run_all_modes () {
 	test_cmp expect actual &&
 	cp commit-graph-no-gdat .git/objects/info/commit-graph &&
 	"$@" <input >actual &&
+	test_cmp expect actual &&
+	rm -f .git/objects/info/commit-graph &&
+	cp bitmap-full .git/objects/pack/$(cat bitmap-full-name) &&
+	"$@" <input >actual &&
+	test_cmp expect actual &&
+	rm -f .git/objects/pack/*.bitmap &&
+	cp bitmap-half .git/objects/pack/$(cat bitmap-half-name) &&
+	"$@" <input >actual &&
 	test_cmp expect actual
 }
 
@@ -529,6 +560,63 @@ test_expect_success 'for-each-ref ahead-behind:none' '
 		--format="%(refname) %(ahead-behind:commit-8-4)" --stdin
 '
 
+test_expect_success 'for-each-ref ahead-behind uses bitmaps' '
+	test_when_finished rm -f .git/objects/pack/*.bitmap &&
+	cp bitmap-half .git/objects/pack/$(cat bitmap-half-name) &&
+	cat >input <<-\EOF &&
+	refs/heads/commit-1-1
+	refs/heads/commit-4-8
+	refs/heads/commit-9-9
+	EOF
+	cat >expect <<-\EOF &&
+	refs/heads/commit-1-1 0 31
+	refs/heads/commit-4-8 16 16
+	refs/heads/commit-9-9 49 0
+	EOF
+	GIT_TRACE2_EVENT="$(pwd)/trace2.txt" git for-each-ref \
+		--format="%(refname) %(ahead-behind:commit-8-4)" --stdin \
+		<input >actual &&
+	test_cmp expect actual &&
+	grep "\"category\":\"pack-bitmap\",\"label\":\"ahead-behind\"" trace2.txt &&
+	grep "ahead-behind/walked" trace2.txt &&
+	! grep "ahead-behind/fallback" trace2.txt
+'
+
+test_expect_success 'for-each-ref --contains uses bitmaps' '
+	test_when_finished rm -f .git/objects/pack/*.bitmap \
+		.git/objects/info/commit-graph &&
+	cp bitmap-half .git/objects/pack/$(cat bitmap-half-name) &&
+	cp commit-graph-half .git/objects/info/commit-graph &&
+	cat >input <<-\EOF &&
+	refs/heads/commit-1-1
+	refs/heads/commit-2-9
+	refs/heads/commit-3-3
+	refs/heads/commit-4-8
+	refs/heads/commit-9-2
+	refs/heads/commit-9-9
+	EOF
+	cat >expect <<-\EOF &&
+	refs/heads/commit-3-3
+	refs/heads/commit-4-8
+	refs/heads/commit-9-9
+	EOF
+	GIT_TRACE2_EVENT="$(pwd)/trace2.txt" git for-each-ref \
+		--format="%(refname)" --contains commit-3-3 --stdin \
+		<input >actual &&
+	test_cmp expect actual &&
+	grep "tips-reach-any/walked" trace2.txt &&
+	! grep "tips-reach-any/fallback" trace2.txt &&
+
+	cat >expect <<-\EOF &&
+	refs/heads/commit-1-1
+	refs/heads/commit-2-9
+	refs/heads/commit-9-2
+	EOF
+	git for-each-ref --format="%(refname)" --no-contains commit-3-3 \
+		--stdin <input >actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'for-each-ref merged:linear' '
 	cat >input <<-\EOF &&
 	refs/heads/commit-1-1
@@ -1746,4 +1746,48 @@ test_expect_success 'slow status advice when core.untrackedCache true, and fsmon
 	)
 '
 
+test_expect_success 'status is the same with core.preloadIndexIOUring' '
+	git init preload-ring &&
+	(
+		cd preload-ring &&
+		mkdir dir &&
+		for i in 1 2 3 4 5 6 7 8
+		do
+			echo $i >file$i &&
+			echo $i >dir/file$i || return 1
+		done &&
+		git add . &&
+		git commit -m initial &&
+		echo changed >file3 &&
+		echo changed >dir/file5 &&
+		rm file7 &&
+		GIT_TEST_PRELOAD_INDEX=1 git -c core.preloadIndexIOUring=false \
+			status --porcelain -uno >expect &&
+		GIT_TEST_PRELOAD_INDEX=1 git -c core.preloadIndexIOUring=true \
+			status --porcelain -uno >actual &&
+		test_cmp expect actual
+	)
+'
+
+# Whether Git was built with HAVE_IO_URING and the kernel lets it set up
+# a ring; otherwise core.preloadIndexIOUring falls back to lstat().
+test_lazy_prereq IO_URING '
+	test -n "$HAVE_IO_URING" &&
+	git init ring-probe &&
+	test_commit -C ring-probe one &&
+	test_commit -C ring-probe two &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" GIT_TEST_PRELOAD_INDEX=1 \
+		git -C ring-probe -c core.preloadIndexIOUring=true status &&
+	grep "\"key\":\"preload/sum_ring_lstat\"" trace
+'
+
+test_expect_success IO_URING 'core.preloadIndexIOUring lstats the index in a ring' '
+	test_when_finished "rm -f trace-ring" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace-ring" GIT_TEST_PRELOAD_INDEX=1 \
+		git -C preload-ring -c core.preloadIndexIOUring=true \
+		status --porcelain -uno >actual &&
+	test_cmp preload-ring/expect actual &&
+	grep "\"key\":\"preload/sum_ring_lstat\",\"value\":\"16\"" trace-ring
+'
+
 test_done
@@ -551,6 +551,11 @@ enum trace2_counter_id {
 	TRACE2_COUNTER_ID_TEST1 = 0, /* emits summary event only */
 	TRACE2_COUNTER_ID_TEST2,     /* emits summary and thread events */
 
+	/* Delta base cache lookups and evictions.  See `packfile.c`. */
+	TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HIT,
+	TRACE2_COUNTER_ID_DELTA_BASE_CACHE_MISS,
+	TRACE2_COUNTER_ID_DELTA_BASE_CACHE_EVICT,
+
 	/* Add additional counter definitions before here. */
 	TRACE2_NUMBER_OF_COUNTERS
 };
@@ -27,6 +27,21 @@ static struct tr2_counter_metadata tr2_counter_metadata[TRACE2_NUMBER_OF_COUNTER
 		.name = "test2",
 		.want_per_thread_events = 1,
 	},
+	[TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HIT] = {
+		.category = "delta_base_cache",
+		.name = "hit",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_DELTA_BASE_CACHE_MISS] = {
+		.category = "delta_base_cache",
+		.name = "miss",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_DELTA_BASE_CACHE_EVICT] = {
+		.category = "delta_base_cache",
+		.name = "evict",
+		.want_per_thread_events = 0,
+	},
 
 	/* Add additional metadata before here. */
 };
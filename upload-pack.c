@@ -1,4 +1,5 @@
 #include "git-compat-util.h"
+#include "alloc.h"
 #include "config.h"
 #include "environment.h"
 #include "gettext.h"
@@ -34,6 +35,10 @@
 #include "shallow.h"
 #include "wrapper.h"
 #include "write-or-die.h"
+#include "object-file.h"
+#include "packfile.h"
+#include "path.h"
+#include "tempfile.h"
 
 /* Remember to update object flag allocation in object.h */
 #define THEY_HAVE	(1u << 11)
@@ -102,6 +107,8 @@ struct upload_pack_data {
 
 	const char *pack_objects_hook;
 
+	unsigned long response_cache_max_size;
+
 	unsigned stateless_rpc : 1;				/* v0 only */
 	unsigned no_done : 1;					/* v0 only */
 	unsigned daemon_mode : 1;				/* v0 only */
@@ -120,6 +127,7 @@ struct upload_pack_data {
 	unsigned allow_ref_in_want : 1;				/* v2 only */
 	unsigned allow_sideband_all : 1;			/* v2 only */
 	unsigned advertise_sid : 1;
+	unsigned use_response_cache : 1;
 };
 
 static void upload_pack_data_init(struct upload_pack_data *data)
@@ -155,6 +163,7 @@ static void upload_pack_data_init(struct upload_pack_data *data)
 
 	data->keepalive = 5;
 	data->advertise_sid = 0;
+	data->response_cache_max_size = 1024 * 1024 * 1024;
 }
 
 static void upload_pack_data_clear(struct upload_pack_data *data)
@@ -199,9 +208,9 @@ static void send_client_data(int fd, const char *data, ssize_t sz,
 
 static int write_one_shallow(const struct commit_graft *graft, void *cb_data)
 {
-	FILE *fp = cb_data;
+	struct strbuf *buf = cb_data;
 	if (graft->nr_parent == -1)
-		fprintf(fp, "--shallow %s\n", oid_to_hex(&graft->oid));
+		strbuf_addf(buf, "--shallow %s\n", oid_to_hex(&graft->oid));
 	return 0;
 }
 
@@ -216,6 +225,9 @@ struct output_state {
 	int used;
 	unsigned packfile_uris_started : 1;
 	unsigned packfile_started : 1;
+
+	/* If non-NULL, a copy of what pack-objects wrote is saved here. */
+	struct tempfile *response_cache;
 };
 
 static int relay_pack_data(int pack_objects_out, struct output_state *os,
@@ -238,6 +250,12 @@ static int relay_pack_data(int pack_objects_out, struct output_state *os,
 	if (readsz < 0) {
 		return readsz;
 	}
+	if (os->response_cache &&
+	    write_in_full(get_tempfile_fd(os->response_cache),
+			  os->buffer + os->used, readsz) < 0) {
+		warning_errno("unable to write upload-pack response cache");
+		delete_tempfile(&os->response_cache);
+	}
 	os->used += readsz;
 
 	while (!os->packfile_started) {
@@ -283,6 +301,232 @@ static int relay_pack_data(int pack_objects_out, struct output_state *os,
 	return readsz;
 }
 
+/*
+ * The response cache keeps the output of pack-objects in
+ * "$GIT_DIR/upload-pack-cache", so that identical requests (e.g. many
+ * clones of the same tip) can be answered by streaming a stored file.
+ *
+ * An entry is named after a hash of everything that determines what
+ * pack-objects produces: its command line and input (wants, haves,
+ * shallow boundary, filter and capabilities), the upload-pack
+ * configuration that decides which requests are served, the tags that
+ * --include-tag may add, and the state of the object store (the set of
+ * packs, and the mtime of each loose object directory), so that
+ * entries are not used after a repack, push or prune.
+ *
+ * Replace refs do not need to be part of it, as neither upload-pack nor
+ * pack-objects use them. Grafts and a shallow repository do change the
+ * history pack-objects walks; rather than trying to hash them, NULL is
+ * returned and the cache is not used when either is present.
+ */
+static int hash_ref(const char *refname, const struct object_id *oid,
+		    int flag UNUSED, void *cb_data)
+{
+	git_hash_ctx *ctx = cb_data;
+
+	the_hash_algo->update_fn(ctx, refname, strlen(refname) + 1);
+	the_hash_algo->update_fn(ctx, oid->hash, the_hash_algo->rawsz);
+	return 0;
+}
+
+/*
+ * Adding a loose object, or pruning one, changes the mtime of the
+ * directory it is in.
+ */
+static void hash_loose_object_dirs(git_hash_ctx *ctx)
+{
+	struct object_directory *odb;
+	struct strbuf path = STRBUF_INIT;
+	int i;
+
+	prepare_alt_odb(the_repository);
+	for (odb = the_repository->objects->odb; odb; odb = odb->next) {
+		size_t baselen;
+
+		strbuf_reset(&path);
+		strbuf_addstr(&path, odb->path);
+		the_hash_algo->update_fn(ctx, path.buf, path.len + 1);
+		baselen = path.len;
+
+		for (i = 0; i < 256; i++) {
+			struct stat st;
+			uint64_t mtime[2] = { 0, 0 };
+
+			strbuf_setlen(&path, baselen);
+			strbuf_addf(&path, "/%02x", i);
+			if (!stat(path.buf, &st)) {
+				mtime[0] = st.st_mtime;
+				mtime[1] = ST_MTIME_NSEC(st);
+			}
+			the_hash_algo->update_fn(ctx, mtime, sizeof(mtime));
+		}
+	}
+	strbuf_release(&path);
+}
+
+static void hash_config(git_hash_ctx *ctx, struct upload_pack_data *data)
+{
+	struct strbuf buf = STRBUF_INIT;
+	struct string_list_item *item;
+
+	strbuf_addf(&buf, "allow_uor=%d\n", (int)data->allow_uor);
+	strbuf_addf(&buf, "allow_filter=%d\n", (int)data->allow_filter);
+	strbuf_addf(&buf, "allow_filter_fallback=%d\n",
+		    (int)data->allow_filter_fallback);
+	strbuf_addf(&buf, "tree_filter_max_depth=%lu\n",
+		    data->tree_filter_max_depth);
+	for_each_string_list_item(item, &data->allowed_filters)
+		strbuf_addf(&buf, "allowed_filter=%s:%d\n", item->string,
+			    (int)(intptr_t)item->util);
+	for_each_string_list_item(item, &data->hidden_refs)
+		strbuf_addf(&buf, "hidden_ref=%s\n", item->string);
+	the_hash_algo->update_fn(ctx, buf.buf, buf.len + 1);
+	strbuf_release(&buf);
+}
+
+static char *response_cache_path(struct upload_pack_data *pack_data,
+				 const struct strvec *args,
+				 const struct strbuf *input)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	struct packed_git *p;
+	size_t i;
+
+	if (file_exists(get_graft_file(the_repository)) ||
+	    file_exists(git_path_shallow(the_repository)))
+		return NULL;
+
+	the_hash_algo->init_fn(&ctx);
+	for (i = 0; i < args->nr; i++) {
+		/* progress goes to stderr, and is not part of the response */
+		if (!strcmp(args->v[i], "--progress"))
+			continue;
+		the_hash_algo->update_fn(&ctx, args->v[i], strlen(args->v[i]) + 1);
+	}
+	the_hash_algo->update_fn(&ctx, input->buf, input->len);
+	hash_config(&ctx, pack_data);
+	if (pack_data->use_include_tag)
+		for_each_tag_ref(hash_ref, &ctx);
+	for (p = get_all_packs(the_repository); p; p = p->next) {
+		const char *name = pack_basename(p);
+		the_hash_algo->update_fn(&ctx, name, strlen(name) + 1);
+	}
+	hash_loose_object_dirs(&ctx);
+	the_hash_algo->final_fn(hash, &ctx);
+
+	return git_pathdup("upload-pack-cache/%s", hash_to_hex(hash));
+}
+
+struct response_cache_entry {
+	char *path;
+	off_t size;
+	timestamp_t mtime;
+};
+
+static int response_cache_entry_cmp(const void *va, const void *vb)
+{
+	const struct response_cache_entry *a = va, *b = vb;
+
+	if (a->mtime != b->mtime)
+		return a->mtime < b->mtime ? -1 : 1;
+	return strcmp(a->path, b->path);
+}
+
+/*
+ * Remove the least recently used entries until the cache fits in
+ * "max_size" bytes.  Entries are touched when they are used, so their
+ * mtime tells us how recently that was.
+ */
+static void prune_response_cache(unsigned long max_size)
+{
+	struct response_cache_entry *entries = NULL;
+	size_t nr = 0, alloc = 0, i;
+	struct strbuf path = STRBUF_INIT;
+	size_t dirlen;
+	uintmax_t total = 0;
+	int evicted = 0;
+	DIR *dir;
+	struct dirent *de;
+
+	strbuf_addstr(&path, git_path("upload-pack-cache"));
+	dir = opendir(path.buf);
+	if (!dir) {
+		strbuf_release(&path);
+		return;
+	}
+	strbuf_addch(&path, '/');
+	dirlen = path.len;
+
+	while ((de = readdir(dir))) {
+		struct stat st;
+
+		if (strlen(de->d_name) != the_hash_algo->hexsz)
+			continue;
+		strbuf_setlen(&path, dirlen);
+		strbuf_addstr(&path, de->d_name);
+		if (stat(path.buf, &st) || !S_ISREG(st.st_mode))
+			continue;
+
+		ALLOC_GROW(entries, nr + 1, alloc);
+		entries[nr].path = xstrdup(path.buf);
+		entries[nr].size = st.st_size;
+		entries[nr].mtime = st.st_mtime;
+		total += st.st_size;
+		nr++;
+	}
+	closedir(dir);
+
+	QSORT(entries, nr, response_cache_entry_cmp);
+	for (i = 0; i < nr; i++) {
+		if (total > max_size && !unlink(entries[i].path)) {
+			total -= entries[i].size;
+			evicted++;
+		}
+		free(entries[i].path);
+	}
+	free(entries);
+	strbuf_release(&path);
+
+	if (evicted)
+		trace2_data_intmax("upload-pack", the_repository,
+				   "response-cache/evicted", evicted);
+}
+
+/*
+ * Open a tempfile in the cache directory to save the response that
+ * we are about to generate, or return NULL if that is not possible.
+ */
+static struct tempfile *create_response_cache_tempfile(void)
+{
+	struct strbuf template = STRBUF_INIT;
+	struct tempfile *tmp;
+
+	strbuf_addstr(&template, git_path("upload-pack-cache/tmp_XXXXXX"));
+	if (safe_create_leading_directories(template.buf)) {
+		strbuf_release(&template);
+		return NULL;
+	}
+	tmp = mks_tempfile(template.buf);
+	strbuf_release(&template);
+	return tmp;
+}
+
+/*
+ * Relay a cached response to the client. Returns -1 if it could not
+ * be read completely.
+ */
+static int relay_cached_response(int fd, struct output_state *os,
+				 int use_sideband, int write_packfile_line)
+{
+	ssize_t ret;
+
+	while ((ret = relay_pack_data(fd, os, use_sideband,
+				      write_packfile_line)) > 0)
+		; /* nothing */
+	return ret < 0 ? -1 : 0;
+}
+
 static void create_pack_file(struct upload_pack_data *pack_data,
 			     const struct string_list *uri_protocols)
 {
@@ -293,7 +537,8 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 		"corruption on the remote side.";
 	ssize_t sz;
 	int i;
-	FILE *pipe_fd;
+	struct strbuf input = STRBUF_INIT;
+	char *cache_path = NULL;
 
 	if (!pack_data->pack_objects_hook)
 		pack_objects.git_cmd = 1;
@@ -332,6 +577,47 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 					 uri_protocols->items[i].string);
 	}
 
+	if (pack_data->shallow_nr)
+		for_each_commit_graft(write_one_shallow, &input);
+
+	for (i = 0; i < pack_data->want_obj.nr; i++)
+		strbuf_addf(&input, "%s\n",
+			    oid_to_hex(&pack_data->want_obj.objects[i].item->oid));
+	strbuf_addstr(&input, "--not\n");
+	for (i = 0; i < pack_data->have_obj.nr; i++)
+		strbuf_addf(&input, "%s\n",
+			    oid_to_hex(&pack_data->have_obj.objects[i].item->oid));
+	for (i = 0; i < pack_data->extra_edge_obj.nr; i++)
+		strbuf_addf(&input, "%s\n",
+			    oid_to_hex(&pack_data->extra_edge_obj.objects[i].item->oid));
+	strbuf_addch(&input, '\n');
+
+	if (pack_data->use_response_cache) {
+		int fd;
+
+		cache_path = response_cache_path(pack_data, &pack_objects.args,
+						 &input);
+		fd = cache_path ? open(cache_path, O_RDONLY) : -1;
+		if (fd >= 0) {
+			int ret;
+
+			trace2_data_string("upload-pack", the_repository,
+					   "response-cache", "hit");
+			/* mark it as recently used */
+			utime(cache_path, NULL);
+			ret = relay_cached_response(fd, output_state,
+						    pack_data->use_sideband,
+						    !!uri_protocols);
+			close(fd);
+			child_process_clear(&pack_objects);
+			if (ret < 0)
+				goto fail;
+			goto flush;
+		}
+		trace2_data_string("upload-pack", the_repository,
+				   "response-cache", cache_path ? "miss" : "skipped");
+	}
+
 	pack_objects.in = -1;
 	pack_objects.out = -1;
 	pack_objects.err = -1;
@@ -340,24 +626,12 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 	if (start_command(&pack_objects))
 		die("git upload-pack: unable to fork git-pack-objects");
 
-	pipe_fd = xfdopen(pack_objects.in, "w");
+	if (write_in_full(pack_objects.in, input.buf, input.len) < 0)
+		die_errno("git upload-pack: unable to write to git-pack-objects");
+	close(pack_objects.in);
 
-	if (pack_data->shallow_nr)
-		for_each_commit_graft(write_one_shallow, pipe_fd);
-
-	for (i = 0; i < pack_data->want_obj.nr; i++)
-		fprintf(pipe_fd, "%s\n",
-			oid_to_hex(&pack_data->want_obj.objects[i].item->oid));
-	fprintf(pipe_fd, "--not\n");
-	for (i = 0; i < pack_data->have_obj.nr; i++)
-		fprintf(pipe_fd, "%s\n",
-			oid_to_hex(&pack_data->have_obj.objects[i].item->oid));
-	for (i = 0; i < pack_data->extra_edge_obj.nr; i++)
-		fprintf(pipe_fd, "%s\n",
-			oid_to_hex(&pack_data->extra_edge_obj.objects[i].item->oid));
-	fprintf(pipe_fd, "\n");
-	fflush(pipe_fd);
-	fclose(pipe_fd);
+	if (cache_path)
+		output_state->response_cache = create_response_cache_tempfile();
 
 	/* We read from pack_objects.err to capture stderr output for
 	 * progress bar, and pack_objects.out to capture the pack data.
@@ -455,6 +729,14 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 		goto fail;
 	}
 
+	if (output_state->response_cache) {
+		if (rename_tempfile(&output_state->response_cache, cache_path))
+			warning_errno("unable to save upload-pack response cache");
+		else
+			prune_response_cache(pack_data->response_cache_max_size);
+	}
+
+ flush:
 	/* flush the data */
 	if (output_state->used > 0) {
 		send_client_data(1, output_state->buffer, output_state->used,
@@ -462,12 +744,17 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 		fprintf(stderr, "flushed.\n");
 	}
 	free(output_state);
+	free(cache_path);
+	strbuf_release(&input);
 	if (pack_data->use_sideband)
 		packet_flush(1);
 	return;
 
  fail:
+	delete_tempfile(&output_state->response_cache);
 	free(output_state);
+	free(cache_path);
+	strbuf_release(&input);
 	send_client_data(3, abort_msg, sizeof(abort_msg),
 			 pack_data->use_sideband);
 	die("git upload-pack: %s", abort_msg);
@@ -1334,6 +1621,10 @@ static int upload_pack_config(const char *var, const char *value, void *cb_data)
 		precomposed_unicode = git_config_bool(var, value);
 	} else if (!strcmp("transfer.advertisesid", var)) {
 		data->advertise_sid = git_config_bool(var, value);
+	} else if (!strcmp("uploadpack.responsecache", var)) {
+		data->use_response_cache = git_config_bool(var, value);
+	} else if (!strcmp("uploadpack.responsecachemaxsize", var)) {
+		data->response_cache_max_size = git_config_ulong(var, value);
 	}
 
 	if (parse_object_filter_config(var, value, data) < 0)